@@ -1,93 +1,318 @@
-#include <complex>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 #include <vector>
-#include <stdio.h>
 
+namespace
+{
+const size_t sdriqHeaderSize = 32;
 
-int main(int argc, char** argv)
+// I and Q values converted at a time in streaming mode
+const size_t streamingBlockValues = 1024 * 1024;
+
+struct SdriqHeader
+{
+	uint32_t sampleRate;
+	uint64_t centreFreqHz;
+	uint64_t timestamp;
+	uint32_t sampleSize;
+	uint32_t filler;
+	uint32_t crc;
+};
+}
+
+void usage(const char* argv0)
+{
+	fprintf(stderr, "Usage: %s filename.sdriq output.8t [--threads n] [--peak-estimate samples]\n", argv0);
+	fprintf(stderr, "\tscales the samples so the largest is 127, using --threads (default one per core) to find it and to convert\n");
+	fprintf(stderr, "\t--peak-estimate converts in one streaming pass instead, taking the peak from the first n samples and clipping\n");
+	fprintf(stderr, "\t\tany larger ones. filename.sdriq can then be - for stdin\n");
+	exit(1);
+}
+
+void parseHeader(const uint8_t* bytes, SdriqHeader& header)
+{
+	memcpy(&header.sampleRate, bytes, 4);
+	memcpy(&header.centreFreqHz, bytes + 4, 8);
+	memcpy(&header.timestamp, bytes + 12, 8);
+	memcpy(&header.sampleSize, bytes + 20, 4);
+	memcpy(&header.filler, bytes + 24, 4);
+	memcpy(&header.crc, bytes + 28, 4);
+
+	fprintf(stderr, "sampleRate = %u\n", header.sampleRate);
+	fprintf(stderr, "centreFreqHz = %" PRIu64 "\n", header.centreFreqHz);
+	fprintf(stderr, "timestamp = %" PRIu64 "\n", header.timestamp);
+	fprintf(stderr, "sampleSize = %u\n", header.sampleSize);
+	fprintf(stderr, "filler = %u\n", header.filler);
+	fprintf(stderr, "crc = %u\n", header.crc);
+}
+
+void writeMetadata(const char* outputFileName, const SdriqHeader& header)
 {
-	if(argc != 3)
+	// keep the capture metadata next to the output, the encoder stores it in its header
+	char metadataFileName[1024];
+	snprintf(metadataFileName, sizeof(metadataFileName), "%s.meta", outputFileName);
+	FILE* metadata = fopen(metadataFileName, "w");
+	if (metadata)
 	{
-		fprintf(stderr, "Usage: %s filename.sdriq [output.8t]\n", argv[0]);
-		exit(1);
+		fprintf(metadata, "sample_rate=%u\n", header.sampleRate);
+		fprintf(metadata, "centre_frequency=%" PRIu64 "\n", header.centreFreqHz);
+		fprintf(metadata, "timestamp=%" PRIu64 "\n", header.timestamp);
+		fclose(metadata);
+	}
+}
+
+// largest absolute value. Keeping the max and min in T rather than taking abs() in a wider type keeps the vector lanes narrow
+template<typename T>
+int64_t findPeak(const T* __restrict values, size_t numValues)
+{
+	T largest = 0;
+	T smallest = 0;
+	for (size_t i = 0; i < numValues; i++)
+	{
+		largest = std::max(largest, values[i]);
+		smallest = std::min(smallest, values[i]);
 	}
+	return std::max<int64_t>(largest, -(int64_t) smallest);
+}
 
-	FILE* fh = fopen(argv[1], "r");
-	if(!fh)
+// truncates towards zero like the original converter, clipping only matters when the peak was estimated
+template<typename T>
+void scaleAndPack(const T* __restrict values, size_t numValues, float scalingFactor, int8_t* __restrict destination)
+{
+	for (size_t i = 0; i < numValues; i++)
 	{
-		fprintf(stderr, "Cannot read: '%s'\n", argv[1]);
+		float scaled = values[i] * scalingFactor;
+		destination[i] = std::max(-127.0f, std::min(127.0f, scaled));
+	}
+}
+
+// a thread's share of numValues rounded up to whole cache lines of output, so there are never more ranges than threads
+size_t getRangeSize(size_t numValues, uint32_t numThreads)
+{
+	size_t share = (numValues + numThreads - 1) / numThreads;
+	return std::max<size_t>(64, (share + 63) & ~(size_t) 63);
+}
+
+size_t getNumRanges(size_t numValues, uint32_t numThreads)
+{
+	size_t rangeSize = getRangeSize(numValues, numThreads);
+	return (numValues + rangeSize - 1) / rangeSize;
+}
+
+// splits [0, numValues) into getNumRanges() ranges, calling function(begin, end, range) on each in a thread of its own
+template<typename Function>
+void parallelFor(size_t numValues, uint32_t numThreads, const Function& function)
+{
+	size_t rangeSize = getRangeSize(numValues, numThreads);
+	std::vector<std::thread> threads;
+
+	for (size_t begin = 0; begin < numValues; begin += rangeSize)
+	{
+		size_t end = std::min(numValues, begin + rangeSize);
+		threads.push_back(std::thread(function, begin, end, threads.size()));
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+// the whole file at once: a parallel pass to find the peak, then a parallel pass to scale and pack into the mapped output
+template<typename T>
+void convertMapped(const T* values, size_t numValues, const char* outputFileName, uint32_t numThreads)
+{
+	std::vector<int64_t> threadPeaks(std::max<size_t>(1, getNumRanges(numValues, numThreads)), 0);
+	parallelFor(numValues, numThreads, [&](size_t begin, size_t end, size_t thread)
+	{
+		threadPeaks[thread] = findPeak(values + begin, end - begin);
+	});
+	int64_t maxSample = *std::max_element(threadPeaks.begin(), threadPeaks.end());
+
+	printf("Max sample is: %" PRId64 ", numSamples = %zu\n", maxSample, numValues / 2);
+
+	int fd = open(outputFileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || ftruncate(fd, numValues) != 0)
+	{
+		fprintf(stderr, "Cannot write to: '%s'\n", outputFileName);
 		exit(1);
 	}
+	if (numValues == 0)
+	{
+		close(fd);
+		return;
+	}
 
-	FILE* output = fopen(argv[2], "w");
-	if(!output)
+	int8_t* output = (int8_t*) mmap(NULL, numValues, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (output == MAP_FAILED)
 	{
-		fprintf(stderr, "Cannot write to: '%s'\n", argv[2]);
+		fprintf(stderr, "Cannot map: '%s'\n", outputFileName);
 		exit(1);
 	}
 
+	float scalingFactor = maxSample != 0 ? 127.0f / (float) maxSample : 0.0f;
+	parallelFor(numValues, numThreads, [&](size_t begin, size_t end, size_t)
 	{
-		uint32_t sampleRate;
-		uint64_t centreFreqHz;
-		uint64_t timestamp;
-		uint32_t sampleSize;
-		uint32_t filler;
-		uint32_t crc;
+		scaleAndPack(values + begin, end - begin, scalingFactor, output + begin);
+	});
 
-		fread(&sampleRate, sizeof(sampleRate), 1, fh);
-		fread(&centreFreqHz, sizeof(centreFreqHz), 1, fh);
-		fread(&timestamp, sizeof(timestamp), 1, fh);
-		fread(&sampleSize, sizeof(sampleSize), 1, fh);
-		fread(&filler, sizeof(filler), 1, fh);
-		fread(&crc, sizeof(crc), 1, fh);
+	munmap(output, numValues);
+	close(fd);
+}
 
-		fprintf(stderr, "sampleRate = %u\n", sampleRate);
-		fprintf(stderr, "centreFreqHz = %lu\n", centreFreqHz);
-		fprintf(stderr, "timestamp = %lu\n", timestamp);
-		fprintf(stderr, "sampleSize = %u\n", sampleSize);
-		fprintf(stderr, "filler = %u\n", filler);
-		fprintf(stderr, "crc = %u\n", crc);
+// one pass for pipes or files too big to wait for twice: the peak comes from the first peakEstimateValues values
+template<typename T>
+void convertStreaming(FILE* fh, const char* outputFileName, size_t peakEstimateValues)
+{
+	FILE* output = fopen(outputFileName, "w");
+	if (!output)
+	{
+		fprintf(stderr, "Cannot write to: '%s'\n", outputFileName);
+		exit(1);
 	}
 
-	// pass 1 find max sample
+	std::vector<T> values(std::max(peakEstimateValues, streamingBlockValues));
+	std::vector<int8_t> packed(values.size());
 
-	int32_t maxSample = 0;
-	uint64_t numSamples = 0;
+	size_t numValues = fread(values.data(), sizeof(T), peakEstimateValues, fh) & ~(size_t) 1;
+	int64_t estimatedPeak = findPeak(values.data(), numValues);
+	float scalingFactor = estimatedPeak != 0 ? 127.0f / (float) estimatedPeak : 0.0f;
+	printf("Estimated max sample is: %" PRId64 " from %zu samples\n", estimatedPeak, numValues / 2);
 
-	while(!feof(fh))
+	uint64_t numSamples = 0;
+	uint64_t numClipped = 0;
+	while (numValues != 0)
 	{
-		int32_t sample[2];
-		fread(&sample, 2, 4, fh);
-		//printf("(%d, %d)\n", sample[0], sample[1]);
-		for(uint32_t i=0;i<2;i++)
+		if (findPeak(values.data(), numValues) > estimatedPeak)
 		{
-			if(abs(sample[i]) > maxSample)
+			for (size_t i = 0; i < numValues; i++)
 			{
-				maxSample = abs(sample[i]);
+				numClipped += std::abs((int64_t) values[i]) > estimatedPeak;
 			}
 		}
-		numSamples++;
+
+		scaleAndPack(values.data(), numValues, scalingFactor, packed.data());
+		fwrite(packed.data(), 1, numValues, output);
+		numSamples += numValues / 2;
+
+		numValues = fread(values.data(), sizeof(T), streamingBlockValues, fh) & ~(size_t) 1;
 	}
 
-	printf("Max sample is: %d, numSamples = %lu\n", maxSample, numSamples);
+	printf("numSamples = %" PRIu64 ", clipped values = %" PRIu64 "\n", numSamples, numClipped);
+	fclose(output);
+}
 
-	fclose(fh);
-	fh = fopen(argv[1], "r");
-	// skip header
-	fseek(fh, 32, SEEK_SET);
+int main(int argc, char** argv)
+{
+	if (argc < 3 || argc % 2 != 1)
+	{
+		usage(argv[0]);
+	}
+	const char* inputFileName = argv[1];
+	const char* outputFileName = argv[2];
+	uint32_t numThreads = std::max(1U, std::thread::hardware_concurrency());
+	size_t peakEstimateSamples = 0;
 
-	float scalingFactor = 127.0f / (float)maxSample;
+	for (int i = 3; i < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--threads") == 0)
+		{
+			numThreads = std::max(1UL, strtoul(argv[i + 1], NULL, 10));
+		}
+		else if (strcmp(argv[i], "--peak-estimate") == 0)
+		{
+			peakEstimateSamples = strtoull(argv[i + 1], NULL, 10);
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	bool isStdin = strcmp(inputFileName, "-") == 0;
+	if (isStdin && peakEstimateSamples == 0)
+	{
+		fprintf(stderr, "Reading stdin needs --peak-estimate\n");
+		exit(1);
+	}
 
-	for(uint64_t i=0;i<numSamples;i++)
+	SdriqHeader header;
+
+	if (peakEstimateSamples != 0)
 	{
-		int32_t sample[2];
-		fread(&sample, 2, 4, fh);
-		int8_t scaled[2];
-		scaled[0] = sample[0] * scalingFactor;
-		scaled[1] = sample[1] * scalingFactor;
+		FILE* fh = isStdin ? stdin : fopen(inputFileName, "r");
+		if (!fh)
+		{
+			fprintf(stderr, "Cannot read: '%s'\n", inputFileName);
+			exit(1);
+		}
 
-		fwrite(scaled, 1, 2, output);
+		uint8_t headerBytes[sdriqHeaderSize];
+		if (fread(headerBytes, 1, sizeof(headerBytes), fh) != sizeof(headerBytes))
+		{
+			fprintf(stderr, "Cannot read header: '%s'\n", inputFileName);
+			exit(1);
+		}
+		parseHeader(headerBytes, header);
+		writeMetadata(outputFileName, header);
+
+		// 16 bit captures are stored as int16 pairs, 24 bit ones as int32
+		if (header.sampleSize == 16)
+		{
+			convertStreaming<int16_t>(fh, outputFileName, 2 * peakEstimateSamples);
+		}
+		else
+		{
+			convertStreaming<int32_t>(fh, outputFileName, 2 * peakEstimateSamples);
+		}
+
+		if (!isStdin)
+		{
+			fclose(fh);
+		}
+		return 0;
 	}
 
-	fclose(output);
+	int fd = open(inputFileName, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < sdriqHeaderSize)
+	{
+		fprintf(stderr, "Cannot read: '%s'\n", inputFileName);
+		exit(1);
+	}
+
+	const uint8_t* input = (const uint8_t*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (input == MAP_FAILED)
+	{
+		fprintf(stderr, "Cannot map: '%s'\n", inputFileName);
+		exit(1);
+	}
+	madvise((void*) input, st.st_size, MADV_SEQUENTIAL);
+	madvise((void*) input, st.st_size, MADV_WILLNEED);
+
+	parseHeader(input, header);
+	writeMetadata(outputFileName, header);
+
+	// the payload starts 32 bytes in, so it is aligned for both sample sizes
+	const uint8_t* payload = input + sdriqHeaderSize;
+	size_t payloadBytes = st.st_size - sdriqHeaderSize;
+	if (header.sampleSize == 16)
+	{
+		convertMapped((const int16_t*) payload, payloadBytes / 4 * 2, outputFileName, numThreads);
+	}
+	else
+	{
+		convertMapped((const int32_t*) payload, payloadBytes / 8 * 2, outputFileName, numThreads);
+	}
 
+	munmap((void*) input, st.st_size);
+	close(fd);
 }
@@ -0,0 +1,141 @@
+#include "CSignalGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+const char* signalNames[CSignalGenerator::NUM_SIGNALS] = {"noise", "tones", "qpsk", "chirp"};
+
+const uint32_t samplesPerSymbol = 8;
+const uint32_t burstLength = 16384;
+const uint32_t chirpLength = 65536;
+}
+
+CSignalGenerator::CSignalGenerator(uint32_t seed)
+{
+	reset(seed);
+}
+
+CSignalGenerator::~CSignalGenerator()
+{
+}
+
+const char* CSignalGenerator::getSignalName(ESignal signal)
+{
+	return signal < NUM_SIGNALS ? signalNames[signal] : "unknown";
+}
+
+bool CSignalGenerator::getSignalFromName(const char* name, ESignal& signal)
+{
+	for (uint32_t i = 0; i < NUM_SIGNALS; i++)
+	{
+		if (strcmp(name, signalNames[i]) == 0)
+		{
+			signal = static_cast<ESignal>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void CSignalGenerator::reset(uint32_t seed)
+{
+	_random.seed(seed);
+	_hasSpareGaussian = false;
+	_spareGaussian = 0.0f;
+	_sampleNumber = 0;
+	_previousSymbol = 0.0f;
+	_currentSymbol = 0.0f;
+}
+
+void CSignalGenerator::generate(ESignal signal, std::complex<int8_t>* samples, size_t numSamples)
+{
+	for (size_t i = 0; i < numSamples; i++, _sampleNumber++)
+	{
+		std::complex<float> value;
+		const double t = _sampleNumber;
+
+		switch (signal)
+		{
+			case SIGNAL_NOISE:
+				value = std::complex<float>(gaussian(), gaussian()) * 20.0f;
+				break;
+			case SIGNAL_TONES:
+			{
+				static const float frequencies[4] = {0.01f, -0.07f, 0.123f, 0.31f};
+				static const float amplitudes[4] = {40.0f, 20.0f, 10.0f, 5.0f};
+
+				for (uint32_t tone = 0; tone < 4; tone++)
+				{
+					// fmod keeps the phase accurate however long the signal is
+					float phase = 2.0 * M_PI * fmod(frequencies[tone] * t, 1.0);
+					value += std::polar(amplitudes[tone], phase);
+				}
+				value += std::complex<float>(gaussian(), gaussian()) * 2.0f;
+				break;
+			}
+			case SIGNAL_QPSK:
+			{
+				uint32_t positionInSymbol = _sampleNumber % samplesPerSymbol;
+				if (positionInSymbol == 0)
+				{
+					_previousSymbol = _currentSymbol;
+					uint32_t bits = _random();
+					_currentSymbol = std::complex<float>(bits & 1 ? 1.0f : -1.0f, bits & 2 ? 1.0f : -1.0f);
+				}
+
+				// raised cosine transition between symbols, on a carrier offset from the centre
+				float mix = 0.5f - 0.5f * cosf(M_PI * positionInSymbol / samplesPerSymbol);
+				std::complex<float> symbol = _previousSymbol + (_currentSymbol - _previousSymbol) * mix;
+				bool isBurst = (_sampleNumber / burstLength) % 2 == 0;
+
+				if (isBurst)
+				{
+					value = symbol * std::polar(42.0f, (float) (2.0 * M_PI * fmod(0.05 * t, 1.0)));
+				}
+				value += std::complex<float>(gaussian(), gaussian()) * 2.0f;
+				break;
+			}
+			case SIGNAL_CHIRP:
+			{
+				// instantaneous frequency sweeps -0.4 to +0.4 cycles per sample
+				double position = (_sampleNumber % chirpLength);
+				double phase = -0.4 * position + 0.4 * position * position / chirpLength;
+				value = std::polar(80.0f, (float) (2.0 * M_PI * (phase - floor(phase))));
+				value += std::complex<float>(gaussian(), gaussian()) * 2.0f;
+				break;
+			}
+			default:
+				break;
+		}
+
+		samples[i] = toSample(value);
+	}
+}
+
+float CSignalGenerator::gaussian()
+{
+	// Box-Muller, the second value of each pair is kept for the next call
+	if (_hasSpareGaussian)
+	{
+		_hasSpareGaussian = false;
+		return _spareGaussian;
+	}
+
+	float u1 = (_random() + 1.0) / 4294967297.0;
+	float u2 = _random() / 4294967296.0;
+	float radius = sqrtf(-2.0f * logf(u1));
+
+	_spareGaussian = radius * sinf(2.0f * M_PI * u2);
+	_hasSpareGaussian = true;
+	return radius * cosf(2.0f * M_PI * u2);
+}
+
+std::complex<int8_t> CSignalGenerator::toSample(std::complex<float> value)
+{
+	float real = std::max(-127.0f, std::min(127.0f, roundf(value.real())));
+	float imag = std::max(-127.0f, std::min(127.0f, roundf(value.imag())));
+	return std::complex<int8_t>(real, imag);
+}
@@ -0,0 +1,46 @@
+#ifndef SRC_BENCH_CSIGNALGENERATOR_H_
+#define SRC_BENCH_CSIGNALGENERATOR_H_
+
+#include <complex>
+#include <cstdint>
+#include <random>
+
+// Reproducible synthetic 8 bit IQ test signals for benchmarking, the same seed gives the same samples. The gaussian
+// noise is generated here rather than with std::normal_distribution, whose output differs between standard libraries
+class CSignalGenerator
+{
+public:
+	enum ESignal
+	{
+		SIGNAL_NOISE,	// white gaussian noise
+		SIGNAL_TONES,	// a few carriers of different strengths over a low noise floor
+		SIGNAL_QPSK,	// bursts of pulse shaped QPSK with gaps of noise between them
+		SIGNAL_CHIRP,	// repeated linear sweeps across most of the band
+		NUM_SIGNALS
+	};
+
+	CSignalGenerator(uint32_t seed = 1);
+	virtual ~CSignalGenerator();
+
+	static const char* getSignalName(ESignal signal);
+	static bool getSignalFromName(const char* name, ESignal& signal);
+
+	// restarts every signal from the beginning
+	void reset(uint32_t seed = 1);
+
+	void generate(ESignal signal, std::complex<int8_t>* samples, size_t numSamples);
+
+private:
+	float gaussian();
+	std::complex<int8_t> toSample(std::complex<float> value);
+
+	std::mt19937 _random;
+	bool _hasSpareGaussian;
+	float _spareGaussian;
+
+	uint64_t _sampleNumber;
+	std::complex<float> _previousSymbol;
+	std::complex<float> _currentSymbol;
+};
+
+#endif /* SRC_BENCH_CSIGNALGENERATOR_H_ */
@@ -0,0 +1,568 @@
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CDiscreteCosineTransform.h"
+#include "CMemoryDataSource.h"
+#include "CSampleFormat.h"
+#include "CSignalGenerator.h"
+#include "CSnapDecoder.h"
+#include "CSnapEncoder.h"
+#include "CXZCompress.h"
+#include "CXZDecompress.h"
+#include "kiss_fft.h"
+#include "kiss_fft_batch.h"
+
+namespace
+{
+// one JSON object per line, so results can be diffed between builds or loaded by a script
+FILE* resultsFh = stdout;
+const char* filter = NULL;
+double minimumSeconds = 0.5;
+uint32_t numSignalSamples = 1024 * 1024;
+
+// end to end settings, the same as "encode x.8t block_size 25 80"
+const float quantisationFactor = 0.25f;
+const float binsToKeepFraction = 0.8f;
+const uint32_t chunkBytes = 1024 * 1024;
+}
+
+void usage(const char* argv0)
+{
+	fprintf(stderr, "Usage: %s [--quick] [--filter name] [--samples n] [--output results.json]\n", argv0);
+	fprintf(stderr, "Usage: %s --write-signal noise|tones|qpsk|chirp output.8t samples\n", argv0);
+	fprintf(stderr, "\tRuns the benchmarks on synthetic signals and writes one JSON object per result\n");
+	fprintf(stderr, "\t--quick shortens each timing loop, for a smoke test rather than stable numbers\n");
+	fprintf(stderr, "\t--filter only runs benchmarks whose name contains name: optDCT, optIDCT, DCT, IDCT, quantise, kiss_fft,\n");
+	fprintf(stderr, "\t\tkiss_fft_batch, to_float_8t|int16|float32, find_peak_8t|int16|float32, xz_compress, xz_decompress, encode, decode,\n");
+	fprintf(stderr, "\t\tencode_lossless, decode_lossless\n");
+	fprintf(stderr, "\t--samples sets the length of each synthetic signal\n");
+	fprintf(stderr, "\t--write-signal saves a signal for benchmarking the command line tools\n");
+	exit(1);
+}
+
+bool isSelected(const char* benchmark)
+{
+	return !filter || strstr(benchmark, filter);
+}
+
+double getSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// calls function until minimumSeconds have passed, best of 3 runs to filter out noise from the rest of the system
+double timePerCall(const std::function<void()>& function)
+{
+	double best = INFINITY;
+
+	for (uint32_t run = 0; run < 3; run++)
+	{
+		uint64_t calls = 0;
+		double start = getSeconds();
+		double elapsed;
+		do
+		{
+			function();
+			calls++;
+			elapsed = getSeconds() - start;
+		} while (elapsed < minimumSeconds / 3);
+
+		best = std::min(best, elapsed / calls);
+	}
+
+	return best;
+}
+
+// extra is appended to the object as is, e.g. ,"ratio":0.5
+void report(const char* benchmark, const char* signal, uint32_t size, double secondsPerSample, const char* extra = "")
+{
+	fprintf(resultsFh, "{\"benchmark\":\"%s\",\"signal\":\"%s\",\"size\":%u,\"ns_per_sample\":%.3f,\"msamples_per_s\":%.3f%s}\n", benchmark, signal, size, secondsPerSample * 1e9, 1e-6 / secondsPerSample, extra);
+	fflush(resultsFh);
+	// the extra fields as name=value for people, e.g. ratio=0.5
+	std::string fields;
+	for (const char* c = extra; *c; c++)
+	{
+		fields += *c == ',' ? ' ' : *c == ':' ? '=' : *c;
+	}
+	fields.erase(std::remove(fields.begin(), fields.end(), '"'), fields.end());
+	fprintf(stderr, "%-12s %-6s %6u: %10.3f ns/sample%s\n", benchmark, signal, size, secondsPerSample * 1e9, fields.c_str());
+}
+
+double getSnr(const std::complex<int8_t>* reference, const std::complex<int8_t>* decoded, size_t numSamples)
+{
+	double signalPower = 0.0;
+	double errorPower = 0.0;
+	for (size_t i = 0; i < numSamples; i++)
+	{
+		std::complex<double> value(reference[i].real(), reference[i].imag());
+		std::complex<double> error = value - std::complex<double>(decoded[i].real(), decoded[i].imag());
+		signalPower += std::norm(value);
+		errorPower += std::norm(error);
+	}
+	return errorPower == 0.0 ? INFINITY : 10.0 * log10(signalPower / errorPower);
+}
+
+void benchTransforms(const char* signalName, const std::vector<std::complex<int8_t>>& signal, uint32_t blockSize)
+{
+	// the signal is cycled through a block at a time so the caches see realistic data
+	const size_t numBlocks = signal.size() / blockSize;
+	size_t block = 0;
+
+	std::vector<std::complex<float>> floats(blockSize);
+	std::vector<std::complex<float>> transformed;
+	std::vector<std::complex<float>> inverseTransformed;
+	std::vector<std::complex<int8_t>> quantised(blockSize);
+
+	auto loadNextBlock = [&]()
+	{
+		const std::complex<int8_t>* samples = signal.data() + (block++ % numBlocks) * blockSize;
+		for (uint32_t i = 0; i < blockSize; i++)
+		{
+			floats[i] = std::complex<float>(samples[i].real(), samples[i].imag());
+		}
+	};
+
+	CDiscreteCosineTransform dct(blockSize);
+
+	if (isSelected("optDCT"))
+	{
+		double seconds = timePerCall([&]()
+		{
+			loadNextBlock();
+			dct.optDCT(floats, transformed);
+		});
+		report("optDCT", signalName, blockSize, seconds / blockSize);
+	}
+
+	loadNextBlock();
+	dct.optDCT(floats, transformed);
+
+	if (isSelected("optIDCT"))
+	{
+		double seconds = timePerCall([&]()
+		{
+			dct.optIDCT(transformed, inverseTransformed);
+		});
+		report("optIDCT", signalName, blockSize, seconds / blockSize);
+	}
+
+	// the reference versions recalculate every cosine, only worth timing at small sizes
+	if (blockSize <= 1024 && isSelected("DCT"))
+	{
+		double seconds = timePerCall([&]()
+		{
+			loadNextBlock();
+			CDiscreteCosineTransform::DCT(floats, transformed);
+		});
+		report("DCT", signalName, blockSize, seconds / blockSize);
+	}
+
+	if (blockSize <= 1024 && isSelected("IDCT"))
+	{
+		double seconds = timePerCall([&]()
+		{
+			CDiscreteCosineTransform::IDCT(transformed, inverseTransformed);
+		});
+		report("IDCT", signalName, blockSize, seconds / blockSize);
+	}
+
+	if (isSelected("quantise"))
+	{
+		std::vector<float> quantisationFactors;
+		CSnapEncoder::getBinQuantisationFactors(quantisationFactor, std::vector<float>(), blockSize, quantisationFactors);
+		float largestMagnitude = 0.0f;
+		double seconds = timePerCall([&]()
+		{
+			CSnapEncoder::quantise(transformed.data(), blockSize, quantisationFactors.data(), quantised.data(), largestMagnitude);
+		});
+		report("quantise", signalName, blockSize, seconds / blockSize);
+	}
+}
+
+void benchFft(const char* signalName, const std::vector<std::complex<int8_t>>& signal, uint32_t fftSize)
+{
+	if (!isSelected("kiss_fft"))
+	{
+		return;
+	}
+
+	std::vector<kiss_fft_cpx> input(fftSize);
+	std::vector<kiss_fft_cpx> output(fftSize);
+	for (uint32_t i = 0; i < fftSize; i++)
+	{
+		input[i].r = signal[i].real();
+		input[i].i = signal[i].imag();
+	}
+
+	kiss_fft_cfg cfg = kiss_fft_alloc(fftSize, 0, NULL, NULL);
+	double seconds = timePerCall([&]()
+	{
+		kiss_fft(cfg, input.data(), output.data());
+	});
+	KISS_FFT_FREE(cfg);
+
+	report("kiss_fft", signalName, fftSize, seconds / fftSize);
+
+	if (!isSelected("kiss_fft_batch"))
+	{
+		return;
+	}
+
+	// the same transform in every lane, per sample of each so it compares with kiss_fft
+	kiss_fft_batch_cpx* batchInput = kiss_fft_batch_buffer(fftSize);
+	kiss_fft_batch_cpx* batchOutput = kiss_fft_batch_buffer(fftSize);
+	for (uint32_t i = 0; i < fftSize; i++)
+	{
+		for (uint32_t lane = 0; lane < KISS_FFT_BATCH_WIDTH; lane++)
+		{
+			batchInput[i].r[lane] = input[i].r;
+			batchInput[i].i[lane] = input[i].i;
+		}
+	}
+
+	kiss_fft_batch_cfg batchCfg = kiss_fft_batch_alloc(fftSize, 0, NULL, NULL);
+	seconds = timePerCall([&]()
+	{
+		kiss_fft_batch(batchCfg, batchInput, batchOutput);
+	});
+	kiss_fft_free(batchCfg);
+	free(batchInput);
+	free(batchOutput);
+
+	report("kiss_fft_batch", signalName, fftSize, seconds / (fftSize * KISS_FFT_BATCH_WIDTH));
+}
+
+void benchConversion(const char* signalName, const std::vector<std::complex<int8_t>>& signal)
+{
+	// the input kernels of encode, over a 64K sample buffer per call like its reads
+	const size_t numSamples = 64 * 1024;
+	std::vector<int16_t> int16s(2 * numSamples);
+	std::vector<float> float32s(2 * numSamples);
+	for (size_t i = 0; i < numSamples; i++)
+	{
+		int16s[2 * i] = signal[i].real() * 256;
+		int16s[2 * i + 1] = signal[i].imag() * 256;
+		float32s[2 * i] = signal[i].real();
+		float32s[2 * i + 1] = signal[i].imag();
+	}
+	std::vector<std::complex<float>> floats(numSamples);
+
+	struct Input
+	{
+		const char* name;
+		CSampleFormat::EFormat format;
+		const void* data;
+	};
+	const Input inputs[] = {{"8t", CSampleFormat::FORMAT_INT8, signal.data()}, {"int16", CSampleFormat::FORMAT_INT16, int16s.data()}, {"float32", CSampleFormat::FORMAT_FLOAT32, float32s.data()}};
+
+	for (const Input& input : inputs)
+	{
+		char benchmark[64];
+		snprintf(benchmark, sizeof(benchmark), "to_float_%s", input.name);
+		if (isSelected(benchmark))
+		{
+			double seconds = timePerCall([&]()
+			{
+				CSampleFormat::toFloat(input.data, numSamples, input.format, 1.0f / 256, floats.data());
+			});
+			report(benchmark, signalName, numSamples, seconds / numSamples);
+		}
+
+		snprintf(benchmark, sizeof(benchmark), "find_peak_%s", input.name);
+		if (isSelected(benchmark))
+		{
+			volatile float peak = 0.0f;
+			double seconds = timePerCall([&]()
+			{
+				peak = CSampleFormat::findPeak(input.data, numSamples, input.format);
+			});
+			report(benchmark, signalName, numSamples, seconds / numSamples);
+		}
+	}
+}
+
+void benchXz(const char* signalName, const std::vector<std::complex<int8_t>>& signal, uint32_t blockSize)
+{
+	if (!isSelected("xz_compress") && !isSelected("xz_decompress"))
+	{
+		return;
+	}
+
+	// compress the quantised coefficients the encoder would produce, xz is far too slow to loop over
+	const uint32_t binsToKeep = ceilf(blockSize * binsToKeepFraction);
+	const size_t numBlocks = signal.size() / blockSize;
+	std::vector<uint8_t> coefficients(numBlocks * 2 * binsToKeep);
+	{
+		CDiscreteCosineTransform dct(blockSize);
+		std::vector<std::complex<float>> floats(blockSize);
+		std::vector<std::complex<float>> transformed;
+		std::vector<float> quantisationFactors;
+		CSnapEncoder::getBinQuantisationFactors(quantisationFactor, std::vector<float>(), binsToKeep, quantisationFactors);
+		float largestMagnitude = 0.0f;
+
+		for (size_t block = 0; block < numBlocks; block++)
+		{
+			for (uint32_t i = 0; i < blockSize; i++)
+			{
+				floats[i] = std::complex<float>(signal[block * blockSize + i].real(), signal[block * blockSize + i].imag());
+			}
+			dct.optDCT(floats, transformed);
+			CSnapEncoder::quantise(transformed.data(), binsToKeep, quantisationFactors.data(), reinterpret_cast<std::complex<int8_t>*>(coefficients.data() + block * 2 * binsToKeep), largestMagnitude);
+		}
+	}
+
+	std::vector<uint8_t> compressed;
+	double start = getSeconds();
+	{
+		CXZCompress compressor;
+		for (size_t offset = 0; offset < coefficients.size(); offset += 2 * binsToKeep)
+		{
+			compressor.addBytes(coefficients.data() + offset, 2 * binsToKeep);
+			compressor.writeAndEmptyBuffer(compressed);
+		}
+		while (!compressor.finish())
+		{
+			compressor.writeAndEmptyBuffer(compressed);
+		}
+		compressor.writeAndEmptyBuffer(compressed);
+	}
+	double compressSeconds = getSeconds() - start;
+
+	char extra[64];
+	snprintf(extra, sizeof(extra), ",\"ratio\":%.4f", compressed.size() / (double) coefficients.size());
+	if (isSelected("xz_compress"))
+	{
+		report("xz_compress", signalName, blockSize, compressSeconds / (numBlocks * blockSize), extra);
+	}
+
+	if (!isSelected("xz_decompress"))
+	{
+		return;
+	}
+
+	CMemoryDataSource source;
+	double seconds = timePerCall([&]()
+	{
+		source.clear();
+		source.append(compressed.data(), compressed.size());
+		source.setFinished();
+
+		CXZDecompress decompressor(&source);
+		while (decompressor.peekBytes(2 * binsToKeep))
+		{
+			decompressor.advance(2 * binsToKeep);
+		}
+	});
+	report("xz_decompress", signalName, blockSize, seconds / (numBlocks * blockSize), extra);
+}
+
+void benchEndToEnd(const char* signalName, const std::vector<std::complex<int8_t>>& signal, uint32_t blockSize, bool isLossless)
+{
+	const char* encodeName = isLossless ? "encode_lossless" : "encode";
+	const char* decodeName = isLossless ? "decode_lossless" : "decode";
+	if (!isSelected(encodeName) && !isSelected(decodeName))
+	{
+		return;
+	}
+
+	const uint32_t binsToKeep = isLossless ? blockSize : ceilf(blockSize * binsToKeepFraction);
+	const size_t numSamples = signal.size() / blockSize * blockSize;
+
+	CSnapEncoder encoder;
+	encoder.setLossless(isLossless);
+	std::vector<uint8_t> encoded;
+	double start = getSeconds();
+	{
+		CSnapHeader metadata;
+		if (encoder.start(blockSize, quantisationFactor, binsToKeep, std::max(1U, chunkBytes / (2 * binsToKeep)), metadata) != SNAP_OK)
+		{
+			fprintf(stderr, "Cannot start encoder\n");
+			exit(1);
+		}
+
+		// pushed in pieces which aren't a multiple of the block size, as a capture would arrive
+		const size_t pieceSize = 100000;
+		for (size_t offset = 0; offset < numSamples; offset += pieceSize)
+		{
+			encoder.pushSamples(signal.data() + offset, std::min(pieceSize, numSamples - offset));
+
+			size_t numBytes;
+			const uint8_t* output = encoder.getOutput(numBytes);
+			encoded.insert(encoded.end(), output, output + numBytes);
+			encoder.consumeOutput(numBytes);
+		}
+		encoder.finish();
+
+		size_t numBytes;
+		const uint8_t* output = encoder.getOutput(numBytes);
+		encoded.insert(encoded.end(), output, output + numBytes);
+	}
+	double encodeSeconds = getSeconds() - start;
+
+	std::vector<std::complex<int8_t>> decoded(numSamples);
+	start = getSeconds();
+	{
+		CSnapDecoder decoder;
+		decoder.pushBytes(encoded.data(), encoded.size());
+		decoder.endOfInput();
+
+		size_t numDecoded;
+		if (decoder.pullSamples(decoded.data(), decoded.size(), numDecoded) != SNAP_OK || numDecoded != numSamples)
+		{
+			fprintf(stderr, "Decoded %zu of %zu samples\n", numDecoded, numSamples);
+			exit(1);
+		}
+	}
+	double decodeSeconds = getSeconds() - start;
+
+	char extra[128];
+	if (isLossless)
+	{
+		// an infinite SNR isn't JSON, and anything else is a bug
+		if (memcmp(signal.data(), decoded.data(), numSamples * sizeof(decoded[0])) != 0)
+		{
+			fprintf(stderr, "Lossless round trip of %s at %u isn't exact\n", signalName, blockSize);
+			exit(1);
+		}
+		snprintf(extra, sizeof(extra), ",\"ratio\":%.4f", encoded.size() / (2.0 * numSamples));
+	}
+	else
+	{
+		snprintf(extra, sizeof(extra), ",\"ratio\":%.4f,\"snr_db\":%.2f,\"overflows\":%" PRIu64, encoded.size() / (2.0 * numSamples), getSnr(signal.data(), decoded.data(), numSamples), encoder.getOverflowCount());
+	}
+
+	if (isSelected(encodeName))
+	{
+		report(encodeName, signalName, blockSize, encodeSeconds / numSamples, extra);
+	}
+	if (isSelected(decodeName))
+	{
+		report(decodeName, signalName, blockSize, decodeSeconds / numSamples, extra);
+	}
+}
+
+void writeSignal(const char* signalName, const char* fileName, uint64_t numSamples)
+{
+	CSignalGenerator::ESignal signal;
+	if (!CSignalGenerator::getSignalFromName(signalName, signal))
+	{
+		fprintf(stderr, "Unknown signal '%s'\n", signalName);
+		exit(1);
+	}
+
+	FILE* fh = fopen(fileName, "w");
+	if (!fh)
+	{
+		fprintf(stderr, "Cannot write: '%s'\n", fileName);
+		exit(1);
+	}
+
+	CSignalGenerator generator;
+	std::vector<std::complex<int8_t>> samples(1024 * 1024);
+	while (numSamples != 0)
+	{
+		size_t samplesToWrite = std::min<uint64_t>(samples.size(), numSamples);
+		generator.generate(signal, samples.data(), samplesToWrite);
+		fwrite(samples.data(), 2, samplesToWrite, fh);
+		numSamples -= samplesToWrite;
+	}
+
+	fclose(fh);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 5 && strcmp(argv[1], "--write-signal") == 0)
+	{
+		writeSignal(argv[2], argv[3], strtoull(argv[4], NULL, 10));
+		return 0;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--quick") == 0)
+		{
+			minimumSeconds = 0.03;
+			numSignalSamples = 128 * 1024;
+		}
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+		{
+			filter = argv[++i];
+		}
+		else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+		{
+			numSignalSamples = strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+		{
+			resultsFh = fopen(argv[++i], "w");
+			if (!resultsFh)
+			{
+				fprintf(stderr, "Cannot write: '%s'\n", argv[i]);
+				exit(1);
+			}
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	static const uint32_t blockSizes[] = {64, 256, 1024, 4096};
+	static const uint32_t fftSizes[] = {256, 1024, 4096};
+
+	if (numSignalSamples < 4096)
+	{
+		fprintf(stderr, "--samples must be at least 4096\n");
+		exit(1);
+	}
+
+	CSignalGenerator generator;
+	std::vector<std::complex<int8_t>> signal(numSignalSamples);
+
+	for (uint32_t s = 0; s < CSignalGenerator::NUM_SIGNALS; s++)
+	{
+		CSignalGenerator::ESignal signalType = static_cast<CSignalGenerator::ESignal>(s);
+		const char* signalName = CSignalGenerator::getSignalName(signalType);
+
+		generator.reset();
+		generator.generate(signalType, signal.data(), signal.size());
+
+		// the transforms and the fft don't care what the data is, only time them on one signal
+		if (s == 0)
+		{
+			for (uint32_t blockSize : blockSizes)
+			{
+				benchTransforms(signalName, signal, blockSize);
+			}
+
+			for (uint32_t fftSize : fftSizes)
+			{
+				benchFft(signalName, signal, fftSize);
+			}
+
+			benchConversion(signalName, signal);
+		}
+
+		for (uint32_t blockSize : {256U, 1024U})
+		{
+			benchXz(signalName, signal, blockSize);
+			benchEndToEnd(signalName, signal, blockSize, false);
+			benchEndToEnd(signalName, signal, blockSize, true);
+		}
+	}
+
+	if (resultsFh != stdout)
+	{
+		fclose(resultsFh);
+	}
+}
@@ -0,0 +1,374 @@
+#include "CPixelBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+std::vector<uint32_t> makeCrcTable()
+{
+	std::vector<uint32_t> table(256);
+	for (uint32_t n = 0; n < 256; n++)
+	{
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++)
+		{
+			c = c & 1 ? 0xedb88320U ^ (c >> 1) : c >> 1;
+		}
+		table[n] = c;
+	}
+	return table;
+}
+
+// the CRC-32 PNG uses, not the CRC-32C of the snapshot format
+uint32_t crc32(const uint8_t* data, size_t numBytes)
+{
+	static const std::vector<uint32_t> table = makeCrcTable();
+
+	uint32_t crc = 0xffffffffU;
+	for (size_t i = 0; i < numBytes; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+void appendBigEndian(std::vector<uint8_t>& destination, uint32_t value)
+{
+	destination.push_back(value >> 24);
+	destination.push_back(value >> 16);
+	destination.push_back(value >> 8);
+	destination.push_back(value);
+}
+
+bool writePngChunk(FILE* fh, const char* type, const std::vector<uint8_t>& data)
+{
+	std::vector<uint8_t> chunk;
+	appendBigEndian(chunk, data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	appendBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+	return fwrite(chunk.data(), 1, chunk.size(), fh) == chunk.size();
+}
+}
+
+CPixelBuffer::CPixelBuffer(uint32_t width, uint32_t height) :
+		_windowWidth(width),
+		_windowHeight(height)
+{
+	_pixels = new uint8_t[_windowWidth * _windowHeight * 4];
+	memset(_pixels, 0, _windowWidth * _windowHeight * 4);
+}
+
+CPixelBuffer::~CPixelBuffer()
+{
+	delete[] _pixels;
+}
+
+uint32_t CPixelBuffer::getWidth() const
+{
+	return _windowWidth;
+}
+
+uint32_t CPixelBuffer::getHeight() const
+{
+	return _windowHeight;
+}
+
+void CPixelBuffer::setPixel(int x, int y, uint32_t pixel)
+{
+	if (isInside(x, y))
+	{
+		getRow(y)[x] = pixel;
+	}
+}
+
+uint32_t CPixelBuffer::setColour(uint8_t r, uint8_t g, uint8_t b)
+{
+	uint32_t pixel = b + (g << 8) + (r << 16);
+	return pixel;
+}
+
+uint32_t CPixelBuffer::setHeatColour(float level)
+{
+	static const uint8_t stops[5][3] = {{0, 0, 0}, {0, 0, 192}, {224, 0, 0}, {255, 224, 0}, {255, 255, 255}};
+
+	float position = std::min(1.0f, std::max(0.0f, level)) * 4;
+	uint32_t stop = std::min(3, (int) position);
+	float fraction = position - stop;
+
+	uint8_t rgb[3];
+	for (int i = 0; i < 3; i++)
+	{
+		rgb[i] = lroundf(stops[stop][i] + (stops[stop + 1][i] - stops[stop][i]) * fraction);
+	}
+	return setColour(rgb[0], rgb[1], rgb[2]);
+}
+
+// a vertical line if x1 == x2, otherwise a horizontal one along y1 from x1 up to but not including x2
+void CPixelBuffer::drawStraightLine(int x1, int y1, int x2, int y2, uint32_t pixel)
+{
+	if (y1 > y2)
+	{
+		std::swap(y1, y2);
+	}
+	if (x1 > x2)
+	{
+		std::swap(x1, x2);
+	}
+	if (x1 == x2)
+	{
+		if (x1 < 0 || x1 >= (int32_t) _windowWidth)
+		{
+			return;
+		}
+		y1 = std::max(0, y1);
+		y2 = std::min<int32_t>(_windowHeight - 1, y2);
+		for (int y = y1; y < y2 + 1; y++)
+		{
+			getRow(y)[x1] = pixel;
+		}
+	}
+	else
+	{
+		if (y1 < 0 || y1 >= (int32_t) _windowHeight)
+		{
+			return;
+		}
+		x1 = std::max(0, x1);
+		x2 = std::min<int32_t>(_windowWidth, x2);
+		if (x1 < x2)
+		{
+			std::fill_n(getRow(y1) + x1, x2 - x1, pixel);
+		}
+	}
+}
+
+void CPixelBuffer::drawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t pixel)
+{
+	if (isInside(x1, y1) && isInside(x2, y2))
+	{
+		drawLineUnclipped(x1, y1, x2, y2, pixel);
+		return;
+	}
+
+	// wholly off one side
+	if (std::max(x1, x2) < 0 || std::min(x1, x2) >= (int32_t) _windowWidth ||
+			std::max(y1, y2) < 0 || std::min(y1, y2) >= (int32_t) _windowHeight)
+	{
+		return;
+	}
+
+	int32_t dx = std::abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+	int32_t dy = std::abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+	int32_t err = (dx > dy ? dx : -dy) / 2, e2;
+
+	for (;;)
+	{
+		setPixel(x1, y1, pixel);
+		if (x1 == x2 && y1 == y2)
+			break;
+		e2 = err;
+		if (e2 > -dx)
+		{
+			err -= dy;
+			x1 += sx;
+		}
+		if (e2 < dy)
+		{
+			err += dx;
+			y1 += sy;
+		}
+	}
+}
+
+void CPixelBuffer::drawPolyline(const Point* points, uint32_t numPoints, uint32_t pixel)
+{
+	if (numPoints == 0)
+	{
+		return;
+	}
+
+	// checked once for the lot, a trace is nearly always all on screen
+	bool isAllInside = true;
+	for (uint32_t i = 0; i < numPoints && isAllInside; i++)
+	{
+		isAllInside = isInside(points[i].x, points[i].y);
+	}
+
+	for (uint32_t i = 1; i < numPoints; i++)
+	{
+		if (isAllInside)
+		{
+			drawLineUnclipped(points[i - 1].x, points[i - 1].y, points[i].x, points[i].y, pixel);
+		}
+		else
+		{
+			drawLine(points[i - 1].x, points[i - 1].y, points[i].x, points[i].y, pixel);
+		}
+	}
+	if (numPoints == 1)
+	{
+		setPixel(points[0].x, points[0].y, pixel);
+	}
+}
+
+void CPixelBuffer::drawPoints(const Point* points, uint32_t numPoints, uint32_t pixel)
+{
+	for (uint32_t i = 0; i < numPoints; i++)
+	{
+		setPixel(points[i].x, points[i].y, pixel);
+	}
+}
+
+void CPixelBuffer::clear(uint32_t pixel)
+{
+	std::fill_n(reinterpret_cast<uint32_t*>(_pixels), (size_t) _windowWidth * _windowHeight, pixel);
+}
+
+uint8_t* CPixelBuffer::getPixels() const
+{
+	return _pixels;
+}
+
+bool CPixelBuffer::isInside(int32_t x, int32_t y) const
+{
+	return (uint32_t) x < _windowWidth && (uint32_t) y < _windowHeight;
+}
+
+uint32_t* CPixelBuffer::getRow(int32_t y) const
+{
+	return reinterpret_cast<uint32_t*>(_pixels) + (size_t) y * _windowWidth;
+}
+
+// Bresenham as drawLine, stepping a pointer through the buffer rather than working out where each pixel is
+void CPixelBuffer::drawLineUnclipped(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t pixel)
+{
+	int32_t dx = std::abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+	int32_t dy = std::abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+	int32_t err = (dx > dy ? dx : -dy) / 2, e2;
+
+	uint32_t* target = getRow(y1) + x1;
+	ptrdiff_t stepY = sy * (ptrdiff_t) _windowWidth;
+	int32_t numSteps = std::max(dx, dy);
+
+	for (int32_t i = 0; i < numSteps; i++)
+	{
+		*target = pixel;
+		e2 = err;
+		if (e2 > -dx)
+		{
+			err -= dy;
+			target += sx;
+		}
+		if (e2 < dy)
+		{
+			err += dx;
+			target += stepY;
+		}
+	}
+	*target = pixel;
+}
+
+bool CPixelBuffer::writeImage(const char* fileName) const
+{
+	FILE* fh = fopen(fileName, "wb");
+	if (!fh)
+	{
+		return false;
+	}
+
+	size_t length = strlen(fileName);
+	bool isPng = length > 4 && strcmp(fileName + length - 4, ".png") == 0;
+	bool isWritten = isPng ? writePng(fh) : writePpm(fh);
+
+	if (fclose(fh) != 0)
+	{
+		isWritten = false;
+	}
+	return isWritten;
+}
+
+bool CPixelBuffer::writePng(FILE* fh) const
+{
+	const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+	std::vector<uint8_t> header;
+	appendBigEndian(header, _windowWidth);
+	appendBigEndian(header, _windowHeight);
+	header.push_back(8);	// bits per channel
+	header.push_back(2);	// RGB
+	header.push_back(0);	// deflate
+	header.push_back(0);	// no filtering
+	header.push_back(0);	// not interlaced
+
+	// each row is a filter type of none then RGB
+	std::vector<uint8_t> rows;
+	rows.reserve(_windowHeight * (1 + 3 * _windowWidth));
+	for (uint32_t y = 0; y < _windowHeight; y++)
+	{
+		rows.push_back(0);
+		const uint8_t* pixel = _pixels + y * _windowWidth * 4;
+		for (uint32_t x = 0; x < _windowWidth; x++, pixel += 4)
+		{
+			rows.push_back(pixel[2]);
+			rows.push_back(pixel[1]);
+			rows.push_back(pixel[0]);
+		}
+	}
+
+	// a zlib stream of stored deflate blocks, the image data as it is
+	std::vector<uint8_t> data = {0x78, 0x01};
+	uint32_t a = 1, b = 0;
+	size_t position = 0;
+	do
+	{
+		uint16_t blockSize = std::min<size_t>(65535, rows.size() - position);
+		data.push_back(position + blockSize == rows.size() ? 1 : 0);
+		data.push_back(blockSize);
+		data.push_back(blockSize >> 8);
+		data.push_back(~blockSize);
+		data.push_back(~blockSize >> 8);
+		data.insert(data.end(), rows.begin() + position, rows.begin() + position + blockSize);
+
+		for (size_t i = position; i < position + blockSize; i++)
+		{
+			a = (a + rows[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		position += blockSize;
+	}
+	while (position < rows.size());
+	appendBigEndian(data, (b << 16) | a);
+
+	return fwrite(signature, 1, sizeof(signature), fh) == sizeof(signature) &&
+			writePngChunk(fh, "IHDR", header) &&
+			writePngChunk(fh, "IDAT", data) &&
+			writePngChunk(fh, "IEND", std::vector<uint8_t>());
+}
+
+bool CPixelBuffer::writePpm(FILE* fh) const
+{
+	fprintf(fh, "P6\n%u %u\n255\n", _windowWidth, _windowHeight);
+
+	std::vector<uint8_t> row(3 * _windowWidth);
+	for (uint32_t y = 0; y < _windowHeight; y++)
+	{
+		const uint8_t* pixel = _pixels + y * _windowWidth * 4;
+		for (uint32_t x = 0; x < _windowWidth; x++, pixel += 4)
+		{
+			row[3 * x] = pixel[2];
+			row[3 * x + 1] = pixel[1];
+			row[3 * x + 2] = pixel[0];
+		}
+		if (fwrite(row.data(), 1, row.size(), fh) != row.size())
+		{
+			return false;
+		}
+	}
+	return true;
+}
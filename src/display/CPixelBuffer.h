@@ -0,0 +1,59 @@
+#ifndef SRC_DISPLAY_CPIXELBUFFER_H_
+#define SRC_DISPLAY_CPIXELBUFFER_H_
+
+#include <cstdint>
+#include <stdio.h>
+
+// An ARGB8888 image in memory and the drawing on it. CSdlDisplay shows one in a window, on its own it renders without a
+// display and saves as PNG or PPM.
+class CPixelBuffer
+{
+public:
+	struct Point
+	{
+		int32_t x;
+		int32_t y;
+	};
+
+	CPixelBuffer(uint32_t width, uint32_t height);
+	virtual ~CPixelBuffer();
+
+	uint32_t    getWidth             () const;
+	uint32_t    getHeight            () const;
+
+	void        setPixel             (int32_t x, int32_t y, uint32_t pixel);
+	void        drawStraightLine     (int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t pixel);
+	void        drawLine             (int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t pixel);
+	uint32_t    setColour            (uint8_t r, uint8_t g, uint8_t b);
+	// black through blue, red and yellow to white as level goes from 0 to 1
+	uint32_t    setHeatColour        (float level);
+
+	// anything outside the buffer is left out, so none of these need their coordinates checking first
+	void        drawPolyline         (const Point* points, uint32_t numPoints, uint32_t pixel);
+	void        drawPoints           (const Point* points, uint32_t numPoints, uint32_t pixel);
+	void        clear                (uint32_t pixel);
+
+	uint8_t*    getPixels            () const;
+
+	// .png (uncompressed deflate, so it needs nothing but itself) or otherwise binary .ppm
+	bool        writeImage           (const char* fileName) const;
+
+protected:
+	uint32_t      _windowWidth;
+	uint32_t      _windowHeight;
+	uint8_t*      _pixels;
+
+private:
+	CPixelBuffer(const CPixelBuffer&);
+	CPixelBuffer& operator=(const CPixelBuffer&);
+
+	bool        isInside             (int32_t x, int32_t y) const;
+	uint32_t*   getRow               (int32_t y) const;
+	// both ends must be inside
+	void        drawLineUnclipped    (int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t pixel);
+
+	bool        writePng             (FILE* fh) const;
+	bool        writePpm             (FILE* fh) const;
+};
+
+#endif /* SRC_DISPLAY_CPIXELBUFFER_H_ */
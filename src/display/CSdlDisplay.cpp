@@ -2,6 +2,8 @@
 
 #include <stdio.h>
 #include <X11/Xlib.h>
+#include <chrono>
+#include <cstring>
 #include <mutex>
 #include <math.h>
 #include <unistd.h>
@@ -10,121 +12,43 @@
 #include "ASdlKeyPressHandler.h"
 
 CSdlDisplay::CSdlDisplay(uint32_t width, uint32_t height) :
+		CPixelBuffer(width, height),
 		_screen(NULL),
-		_windowWidth(width),
-		_windowHeight(height)
+		_renderer(NULL),
+		_texture(NULL),
+		_frontPixels(new uint8_t[width * height * 4]),
+		_isFramePending(false),
+		_isStopping(false)
 {
 	XInitThreads();
 
-	if (SDL_Init( SDL_INIT_VIDEO) != 0)
-	{
-		fprintf(stderr, "Could not initialise SDL: %s\n", SDL_GetError());
-	}
-
-	_screen = SDL_CreateWindow("wave_cmp", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, _windowWidth, _windowHeight, 0);
-	_renderer = SDL_CreateRenderer(_screen, -1, 0);
-	_texture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, _windowWidth, _windowHeight);
-
-	_pixels = new uint8_t[_windowWidth * _windowHeight * 4];
+	memset(_frontPixels, 0, width * height * 4);
+	_renderThread = std::thread(&CSdlDisplay::render, this);
 }
 
 CSdlDisplay::~CSdlDisplay()
 {
-	delete[] _pixels;
-	SDL_DestroyTexture(_texture);
-	SDL_DestroyRenderer(_renderer);
-	SDL_DestroyWindow(_screen);
-}
-
-uint32_t CSdlDisplay::getWidth() const
-{
-	return _windowWidth;
-}
-
-uint32_t CSdlDisplay::getHeight() const
-{
-	return _windowHeight;
-}
-
-void CSdlDisplay::setPixel(int x, int y, uint32_t pixel)
-{
-	uint8_t* target_pixel = (uint8_t*) _pixels + y * _windowWidth * 4 + x * 4;
-	*(uint32_t*) target_pixel = pixel;
-}
-
-uint32_t CSdlDisplay::setColour(uint8_t r, uint8_t g, uint8_t b)
-{
-	uint32_t pixel = b + (g << 8) + (r << 16);
-	return pixel;
-}
-
-void CSdlDisplay::drawStraightLine(int x1, int y1, int x2, int y2, uint32_t pixel)
-{
-	if (y1 > y2)
 	{
-		int temp = y2;
-		y2 = y1;
-		y1 = temp;
-	}
-	if (x1 > x2)
-	{
-		int temp = x2;
-		x2 = x1;
-		x1 = temp;
-	}
-	if (x1 == x2)
-	{
-		for (int y = y1; y < y2 + 1; y++)
-		{
-			setPixel(x1, y, pixel);
-		}
+		std::lock_guard<std::mutex> lock(_renderMutex);
+		_isStopping = true;
 	}
-	else
-	{
-		for (int x = x1; x < x2; x++)
-		{
-			setPixel(x, y1, pixel);
-		}
-	}
-}
+	_renderChanged.notify_all();
+	_renderThread.join();
 
-void CSdlDisplay::drawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t pixel)
-{
-	int32_t dx = std::abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
-	int32_t dy = std::abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
-	int32_t err = (dx > dy ? dx : -dy) / 2, e2;
-
-	for (;;)
-	{
-		setPixel(x1, y1, pixel);
-		if (x1 == x2 && y1 == y2)
-			break;
-		e2 = err;
-		if (e2 > -dx)
-		{
-			err -= dy;
-			x1 += sx;
-		}
-		if (e2 < dy)
-		{
-			err += dx;
-			y1 += sy;
-		}
-	}
+	delete[] _frontPixels;
 }
 
 void CSdlDisplay::swapBuffers()
 {
-	SDL_UpdateTexture(_texture, NULL, _pixels, _windowWidth * 4);
-
-	SDL_RenderClear(_renderer);
-	SDL_RenderCopy(_renderer, _texture, NULL, NULL);
-	SDL_RenderPresent(_renderer);
-}
+	std::unique_lock<std::mutex> lock(_renderMutex);
+	while (_isFramePending)
+	{
+		_renderChanged.wait(lock);
+	}
 
-uint8_t* CSdlDisplay::getPixels() const
-{
-	return _pixels;
+	std::swap(_pixels, _frontPixels);
+	_isFramePending = true;
+	_renderChanged.notify_all();
 }
 
 void CSdlDisplay::addKeyHandler(ASdlKeyPressHandler* handler)
@@ -141,26 +65,22 @@ void CSdlDisplay::removeKeyHandler(ASdlKeyPressHandler* handler)
 
 void CSdlDisplay::handleEvents()
 {
-	while (SDL_PollEvent(&_event))
+	std::deque<SDL_Event> events;
+	{
+		std::lock_guard<std::mutex> lock(_renderMutex);
+		events.swap(_events);
+	}
+
+	for (const SDL_Event& event : events)
 	{
-		switch (_event.type)
+		switch (event.type)
 		{
-			case SDL_MOUSEMOTION:
-			{
-				//printf("Mouse moved by %d,%d to (%d,%d)\n", _event.motion.xrel, _event.motion.yrel,	_event.motion.x, _event.motion.y);
-				break;
-			}
-			case SDL_MOUSEBUTTONDOWN:
-			{
-				//printf("Mouse button %d pressed at (%d,%d)\n", _event.button.button, _event.button.x, _event.button.y);
-				break;
-			}
 			case SDL_KEYDOWN:
 			{
 				std::lock_guard<std::mutex> am(_keyHandlersMutex);
 				for (ASdlKeyPressHandler* handler : _keyHandlers)
 				{
-					handler->handleKeyPress(_event.key.keysym.sym);
+					handler->handleKeyPress(event.key.keysym.sym);
 				}
 				break;
 			}
@@ -172,3 +92,53 @@ void CSdlDisplay::handleEvents()
 	}
 }
 
+// SDL wants its window, renderer and event loop on the one thread, so they're all here
+void CSdlDisplay::render()
+{
+	if (SDL_Init( SDL_INIT_VIDEO) != 0)
+	{
+		fprintf(stderr, "Could not initialise SDL: %s\n", SDL_GetError());
+	}
+
+	_screen = SDL_CreateWindow("wave_cmp", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, _windowWidth, _windowHeight, 0);
+	_renderer = SDL_CreateRenderer(_screen, -1, 0);
+	_texture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, _windowWidth, _windowHeight);
+
+	std::unique_lock<std::mutex> lock(_renderMutex);
+	while (!_isStopping)
+	{
+		if (_isFramePending)
+		{
+			// _frontPixels is ours until _isFramePending is cleared
+			lock.unlock();
+			SDL_UpdateTexture(_texture, NULL, _frontPixels, _windowWidth * 4);
+			SDL_RenderClear(_renderer);
+			SDL_RenderCopy(_renderer, _texture, NULL, NULL);
+			SDL_RenderPresent(_renderer);
+			lock.lock();
+
+			_isFramePending = false;
+			_renderChanged.notify_all();
+		}
+
+		SDL_Event event;
+		lock.unlock();
+		while (SDL_PollEvent(&event))
+		{
+			if (event.type == SDL_KEYDOWN || event.type == SDL_QUIT)
+			{
+				lock.lock();
+				_events.push_back(event);
+				lock.unlock();
+			}
+		}
+		lock.lock();
+
+		_renderChanged.wait_for(lock, std::chrono::milliseconds(10));
+	}
+	lock.unlock();
+
+	SDL_DestroyTexture(_texture);
+	SDL_DestroyRenderer(_renderer);
+	SDL_DestroyWindow(_screen);
+}
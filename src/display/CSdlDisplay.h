@@ -2,45 +2,48 @@
 #define CSDLDISPLAY_H_
 
 #include <SDL2/SDL.h>
+#include <condition_variable>
+#include <deque>
 #include <thread>
 #include <mutex>
 #include <vector>
 
+#include "CPixelBuffer.h"
+
 class ASdlKeyPressHandler;
 
-class CSdlDisplay
+// A window showing a CPixelBuffer. All the SDL calls are made on a render thread, which copies each frame to the screen
+// while the next one is drawn, and collects the window's events for handleEvents.
+class CSdlDisplay: public CPixelBuffer
 {
 public:
 	CSdlDisplay(uint32_t width, uint32_t height);
 	virtual ~CSdlDisplay();
 
-	uint32_t    getWidth             () const;
-	uint32_t    getHeight            () const;
-
-	void        setPixel             (int32_t x, int32_t y, uint32_t pixel);
-	void        drawStraightLine     (int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t pixel);
-	void        drawLine             (int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint32_t pixel);
-	uint32_t    setColour            (uint8_t r, uint8_t g, uint8_t b);
-
+	// hands the frame drawn to the render thread, waiting for it to finish with the one before. Carry on drawing into
+	// getPixels(), which now holds the frame before last
 	void        swapBuffers          ();
 
-	uint8_t*    getPixels            () const;
-
 	void        addKeyHandler        (ASdlKeyPressHandler* handler);
 	void        removeKeyHandler     (ASdlKeyPressHandler* handler);
 
+	// passes key presses since last time to the handlers, on the calling thread
 	void        handleEvents         ();
 
 private:
+	void        render               ();
 
 	SDL_Window*   _screen;
 	SDL_Renderer* _renderer;
 	SDL_Texture*  _texture;
-	uint8_t*      _pixels;
 
-	SDL_Event     _event;
-	uint32_t      _windowWidth;
-	uint32_t      _windowHeight;
+	uint8_t*                _frontPixels;	// the frame being shown, only the render thread touches it while _isFramePending
+	bool                    _isFramePending;
+	bool                    _isStopping;
+	std::deque<SDL_Event>   _events;
+	std::mutex              _renderMutex;
+	std::condition_variable _renderChanged;
+	std::thread             _renderThread;
 
 	std::vector<ASdlKeyPressHandler*> _keyHandlers;
 	std::mutex                        _keyHandlersMutex;
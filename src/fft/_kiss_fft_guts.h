@@ -128,6 +128,10 @@ struct kiss_fft_state{
 #  define KISS_FFT_COS(phase)  floor(.5+SAMP_MAX * cos (phase))
 #  define KISS_FFT_SIN(phase)  floor(.5+SAMP_MAX * sin (phase))
 #  define HALF_OF(x) ((x)>>1)
+#elif defined(USE_SIMD) && USE_SIMD == 8
+#  define KISS_FFT_COS(phase) ((kiss_fft_v8sf){} + (float) cos(phase))
+#  define KISS_FFT_SIN(phase) ((kiss_fft_v8sf){} + (float) sin(phase))
+#  define HALF_OF(x) ((x)*.5f)
 #elif defined(USE_SIMD)
 #  define KISS_FFT_COS(phase) _mm_set1_ps( cos(phase) )
 #  define KISS_FFT_SIN(phase) _mm_set1_ps( sin(phase) )
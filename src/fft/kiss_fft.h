@@ -23,7 +23,19 @@ extern "C" {
   in the tools/ directory.
 */
 
-#ifdef USE_SIMD
+#if defined(USE_SIMD) && USE_SIMD == 8
+/* 8 transforms at once, one per lane (see kiss_fft_batch.h). GCC vector extensions rather than AVX intrinsics, so without
+   -mavx it still builds, as pairs of SSE operations. posix_memalign()ed memory can be free()d like the scalar version's */
+typedef float kiss_fft_v8sf __attribute__((vector_size(32)));
+static inline void * kiss_fft_aligned_malloc(size_t nbytes)
+{
+    void * mem;
+    return posix_memalign(&mem, 32, nbytes) == 0 ? mem : NULL;
+}
+# define kiss_fft_scalar kiss_fft_v8sf
+#define KISS_FFT_MALLOC kiss_fft_aligned_malloc
+#define KISS_FFT_FREE free
+#elif defined(USE_SIMD)
 # include <xmmintrin.h>
 # define kiss_fft_scalar __m128
 #define KISS_FFT_MALLOC(nbytes) _mm_malloc(nbytes,16)
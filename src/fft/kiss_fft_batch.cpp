@@ -0,0 +1,22 @@
+/*
+ kiss_fft compiled a second time with each scalar an 8 lane vector, see kiss_fft_batch.h. Everything kiss_fft.cpp
+ exports is renamed so both versions link into the same program.
+ */
+
+#define USE_SIMD 8
+
+#define kiss_fft_cpx kiss_fft_batch_cpx
+#define kiss_fft_state kiss_fft_batch_state
+#define kiss_fft_cfg kiss_fft_batch_cfg
+#define kiss_fft_alloc kiss_fft_batch_alloc
+#define kiss_fft_stride kiss_fft_batch_stride
+#define kiss_fft kiss_fft_batch
+#define kiss_fft_cleanup kiss_fft_batch_cleanup
+#define kiss_fft_next_fast_size kiss_fft_batch_next_fast_size
+
+#include "kiss_fft.cpp"
+
+extern "C" kiss_fft_batch_cpx * kiss_fft_batch_buffer(int n)
+{
+    return (kiss_fft_batch_cpx*)KISS_FFT_MALLOC(sizeof(kiss_fft_batch_cpx)*n);
+}
@@ -0,0 +1,40 @@
+#ifndef KISS_FFT_BATCH_H
+#define KISS_FFT_BATCH_H
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ kiss_fft built with USE_SIMD == 8, which does KISS_FFT_BATCH_WIDTH transforms of the same size at once. Lane n of every
+ element is transform n, so fin[k].r[n] is sample k of the n'th input. Unused lanes can be left zero.
+
+ The arithmetic of each lane is the same as kiss_fft()'s, so the results match it. Configs are free()d with kiss_fft_free
+ like the scalar ones.
+ */
+
+#define KISS_FFT_BATCH_WIDTH 8
+
+typedef float kiss_fft_batch_scalar __attribute__((vector_size(32)));
+
+typedef struct {
+    kiss_fft_batch_scalar r;
+    kiss_fft_batch_scalar i;
+}kiss_fft_batch_cpx;
+
+typedef struct kiss_fft_batch_state* kiss_fft_batch_cfg;
+
+kiss_fft_batch_cfg kiss_fft_batch_alloc(int nfft,int inverse_fft,void * mem,size_t * lenmem);
+
+void kiss_fft_batch(kiss_fft_batch_cfg cfg,const kiss_fft_batch_cpx *fin,kiss_fft_batch_cpx *fout);
+
+/* n elements, aligned for the vectors which new and std::vector don't do before C++17. free() it when done */
+kiss_fft_batch_cpx * kiss_fft_batch_buffer(int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
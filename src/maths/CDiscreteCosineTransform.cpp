@@ -1,12 +1,29 @@
 #include "CDiscreteCosineTransform.h"
 
-CDiscreteCosineTransform::CDiscreteCosineTransform(uint32_t blockSize) :
+CDiscreteCosineTransform::CDiscreteCosineTransform(uint32_t blockSize, EStrategy strategy) :
 		_blockSize(blockSize),
+		_strategy(strategy),
 		_cosLookup(nullptr),
-		_cosLookupInv(nullptr)
+		_cosLookupInv(nullptr),
+		_fft(nullptr),
+		_inverseFft(nullptr)
 {
 	const float scaledPi = M_PI / (float) blockSize;
 
+	if (_strategy == STRATEGY_FFT)
+	{
+		_fft = kiss_fft_alloc(_blockSize, 0, nullptr, nullptr);
+		_inverseFft = kiss_fft_alloc(_blockSize, 1, nullptr, nullptr);
+
+		// e^(-i pi k / 2n), rotates the FFT of the reordered block onto the DCT
+		_twiddles.resize(_blockSize);
+		for (uint32_t k = 0; k < _blockSize; k++)
+		{
+			_twiddles[k] = std::polar(1.0f, (float) (-M_PI * k / (2.0 * _blockSize)));
+		}
+		return;
+	}
+
 	// the cos lookup is the slowest part of this O(n^2) algorithm, so create a lookup table instead.
 	_cosLookup = new float*[_blockSize];
 	_cosLookupInv = new float*[_blockSize];
@@ -30,6 +47,13 @@ CDiscreteCosineTransform::CDiscreteCosineTransform(uint32_t blockSize) :
 
 CDiscreteCosineTransform::~CDiscreteCosineTransform()
 {
+	if (_strategy == STRATEGY_FFT)
+	{
+		kiss_fft_free(_fft);
+		kiss_fft_free(_inverseFft);
+		return;
+	}
+
 	for (uint32_t i = 0; i < _blockSize; i++)
 	{
 		delete[] _cosLookup[i];
@@ -39,6 +63,26 @@ CDiscreteCosineTransform::~CDiscreteCosineTransform()
 	delete[] _cosLookupInv;
 }
 
+uint64_t CDiscreteCosineTransform::getMemoryUsage(uint32_t blockSize, EStrategy strategy)
+{
+	if (strategy == STRATEGY_FFT)
+	{
+		// two kiss_fft configs (twiddles + factors), the DCT twiddles and two scratch blocks (per thread)
+		return 2 * (blockSize * sizeof(kiss_fft_cpx) + 512) + 3 * blockSize * sizeof(std::complex<float>);
+	}
+	return 2 * (uint64_t) blockSize * (blockSize * sizeof(float) + sizeof(float*));
+}
+
+uint32_t CDiscreteCosineTransform::getBlockSize() const
+{
+	return _blockSize;
+}
+
+CDiscreteCosineTransform::EStrategy CDiscreteCosineTransform::getStrategy() const
+{
+	return _strategy;
+}
+
 void CDiscreteCosineTransform::DCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination)
 {
 	destination.resize(data.size());
@@ -74,8 +118,14 @@ void CDiscreteCosineTransform::IDCT(const std::vector<std::complex<float>>& data
 	}
 }
 
-void CDiscreteCosineTransform::optDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination)
+void CDiscreteCosineTransform::optDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination) const
 {
+	if (_strategy == STRATEGY_FFT)
+	{
+		fftDCT(data, destination);
+		return;
+	}
+
 	destination.resize(data.size());
 
 	const float scalingFactor = sqrtf(2.0f / data.size());
@@ -92,8 +142,14 @@ void CDiscreteCosineTransform::optDCT(const std::vector<std::complex<float>>& da
 	destination[0] *= 1.0f / sqrtf(2);
 }
 
-void CDiscreteCosineTransform::optIDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination)
+void CDiscreteCosineTransform::optIDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination) const
 {
+	if (_strategy == STRATEGY_FFT)
+	{
+		fftIDCT(data, destination);
+		return;
+	}
+
 	destination.resize(data.size());
 
 	const float scalingFactor = sqrtf(2.0f / data.size());
@@ -109,3 +165,67 @@ void CDiscreteCosineTransform::optIDCT(const std::vector<std::complex<float>>& d
 	}
 }
 
+void CDiscreteCosineTransform::fftDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination) const
+{
+	destination.resize(_blockSize);
+
+	// scratch space is per thread, the transform itself is shared
+	thread_local std::vector<std::complex<float>> fftInput;
+	thread_local std::vector<std::complex<float>> fftOutput;
+	fftInput.resize(_blockSize);
+	fftOutput.resize(_blockSize);
+
+	// even samples forwards then odd samples backwards, the DCT is then the real part of the rotated FFT of that
+	for (uint32_t n = 0; n < _blockSize; n++)
+	{
+		uint32_t position = n % 2 == 0 ? n / 2 : _blockSize - 1 - n / 2;
+		fftInput[position] = data[n];
+	}
+
+	kiss_fft(_fft, reinterpret_cast<const kiss_fft_cpx*>(fftInput.data()), reinterpret_cast<kiss_fft_cpx*>(fftOutput.data()));
+
+	// the input is complex, so the FFTs of its real and imaginary parts are separated using their conjugate symmetry
+	const float scalingFactor = sqrtf(2.0f / _blockSize);
+	for (uint32_t k = 0; k < _blockSize; k++)
+	{
+		std::complex<float> value = fftOutput[k];
+		std::complex<float> mirror = std::conj(fftOutput[(_blockSize - k) % _blockSize]);
+		std::complex<float> realPart = (value + mirror) * 0.5f;
+		std::complex<float> imagPart = (value - mirror) * std::complex<float>(0.0f, -0.5f);
+
+		destination[k] = std::complex<float>((realPart * _twiddles[k]).real(), (imagPart * _twiddles[k]).real()) * scalingFactor;
+	}
+	destination[0] *= 1.0f / sqrtf(2);
+}
+
+void CDiscreteCosineTransform::fftIDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination) const
+{
+	destination.resize(_blockSize);
+
+	// scratch space is per thread, the transform itself is shared
+	thread_local std::vector<std::complex<float>> fftInput;
+	thread_local std::vector<std::complex<float>> fftOutput;
+	fftInput.resize(_blockSize);
+	fftOutput.resize(_blockSize);
+
+	// the same as optIDCT (including its half weighted DC term): each of the real and imaginary coefficients becomes the
+	// spectrum (c[k] - i c[n - k]) e^(i pi k / 2n) of a real signal, both go through one inverse FFT as its real and imaginary parts
+	for (uint32_t k = 0; k < _blockSize; k++)
+	{
+		std::complex<float> mirror = k == 0 ? std::complex<float>(0.0f, 0.0f) : data[_blockSize - k];
+		std::complex<float> rotation = std::conj(_twiddles[k]);
+
+		std::complex<float> realSpectrum = std::complex<float>(data[k].real(), -mirror.real()) * rotation;
+		std::complex<float> imagSpectrum = std::complex<float>(data[k].imag(), -mirror.imag()) * rotation;
+		fftInput[k] = realSpectrum + imagSpectrum * std::complex<float>(0.0f, 1.0f);
+	}
+
+	kiss_fft(_inverseFft, reinterpret_cast<const kiss_fft_cpx*>(fftInput.data()), reinterpret_cast<kiss_fft_cpx*>(fftOutput.data()));
+
+	const float scalingFactor = 0.5f * sqrtf(2.0f / _blockSize);
+	for (uint32_t n = 0; n < _blockSize; n++)
+	{
+		uint32_t position = n % 2 == 0 ? n / 2 : _blockSize - 1 - n / 2;
+		destination[n] = fftOutput[position] * scalingFactor;
+	}
+}
@@ -4,22 +4,46 @@
 #include <complex>
 #include <vector>
 
+#include "kiss_fft.h"
+
 class CDiscreteCosineTransform
 {
 public:
-	CDiscreteCosineTransform(uint32_t blockSize);
+	// tables are O(n^2) memory (2 * n^2 floats) and time, the FFT (Makhoul's reordering) is O(n log n) in both
+	enum EStrategy
+	{
+		STRATEGY_TABLE,
+		STRATEGY_FFT
+	};
+
+	CDiscreteCosineTransform(uint32_t blockSize, EStrategy strategy = STRATEGY_TABLE);
 	~CDiscreteCosineTransform();
 
+	// approximate bytes allocated by an instance
+	static uint64_t getMemoryUsage(uint32_t blockSize, EStrategy strategy);
+
 	static void DCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination);
 	static void IDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination);
 
-	void optDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination);
-	void optIDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination);
+	// const, so one instance can be shared by any number of threads
+	void optDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination) const;
+	void optIDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination) const;
+
+	uint32_t getBlockSize() const;
+	EStrategy getStrategy() const;
 
 private:
+	void fftDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination) const;
+	void fftIDCT(const std::vector<std::complex<float>>& data, std::vector<std::complex<float>>& destination) const;
+
 	uint32_t _blockSize;
+	EStrategy _strategy;
 	float** _cosLookup;
 	float** _cosLookupInv;
+
+	kiss_fft_cfg _fft;
+	kiss_fft_cfg _inverseFft;
+	std::vector<std::complex<float>> _twiddles;
 };
 
 #endif /* SRC_MATHS_CDISCRETECOSINETRANSFORM_H_ */
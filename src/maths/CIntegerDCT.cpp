@@ -0,0 +1,216 @@
+#include "CIntegerDCT.h"
+
+#include <cmath>
+
+CIntegerDCT::CIntegerDCT(uint32_t blockSize) :
+		_blockSize(blockSize)
+{
+	_minus45 = makeLift(-M_PI / 4);
+	_plus45 = makeLift(M_PI / 4);
+
+	for (uint32_t n = 1; n <= _blockSize; n *= 2)
+	{
+		_rotations.push_back(std::vector<Lift>(n / 2));
+		for (uint32_t k = 0; k < n / 2; k++)
+		{
+			_rotations.back()[k] = makeLift(-(2.0 * k + 1) * M_PI / (4.0 * n));
+		}
+	}
+}
+
+CIntegerDCT::~CIntegerDCT()
+{
+}
+
+bool CIntegerDCT::isValidBlockSize(uint32_t blockSize)
+{
+	return blockSize != 0 && (blockSize & (blockSize - 1)) == 0;
+}
+
+uint32_t CIntegerDCT::getBlockSize() const
+{
+	return _blockSize;
+}
+
+uint32_t CIntegerDCT::getScratchSize() const
+{
+	// a block at each level of the recursion, n + n / 2 + ... + 1
+	return 2 * _blockSize;
+}
+
+void CIntegerDCT::forward(int32_t* data, int32_t* scratch) const
+{
+	forwardII(data, _blockSize, scratch);
+}
+
+void CIntegerDCT::inverse(int32_t* data, int32_t* scratch) const
+{
+	inverseII(data, _blockSize, scratch);
+}
+
+CIntegerDCT::Lift CIntegerDCT::makeLift(double theta)
+{
+	const double one = (double) (1 << fractionBits);
+
+	Lift lift;
+	lift.p = llround((cos(theta) - 1) / sin(theta) * one);
+	lift.s = llround(sin(theta) * one);
+	return lift;
+}
+
+// [x, y] to [x cos - y sin, x sin + y cos]
+void CIntegerDCT::rotate(int32_t& x, int32_t& y, const Lift& lift)
+{
+	const int64_t half = 1LL << (fractionBits - 1);
+
+	x += (lift.p * y + half) >> fractionBits;
+	y += (lift.s * x + half) >> fractionBits;
+	x += (lift.p * y + half) >> fractionBits;
+}
+
+void CIntegerDCT::unrotate(int32_t& x, int32_t& y, const Lift& lift)
+{
+	const int64_t half = 1LL << (fractionBits - 1);
+
+	x -= (lift.p * y + half) >> fractionBits;
+	y -= (lift.s * x + half) >> fractionBits;
+	x -= (lift.p * y + half) >> fractionBits;
+}
+
+const std::vector<CIntegerDCT::Lift>& CIntegerDCT::getRotations(uint32_t n) const
+{
+	uint32_t level = 0;
+	while ((1U << level) < n)
+	{
+		level++;
+	}
+	return _rotations[level];
+}
+
+// butterflies x[i] +/- x[n - 1 - i] (as a rotation, so they stay orthonormal) into a DCT-II of the sums, whose outputs
+// are the even coefficients, and a DCT-IV of the differences, the odd ones
+void CIntegerDCT::forwardII(int32_t* data, uint32_t n, int32_t* scratch) const
+{
+	if (n == 1)
+	{
+		return;
+	}
+	const uint32_t m = n / 2;
+
+	for (uint32_t i = 0; i < m; i++)
+	{
+		int32_t sum = data[i];
+		int32_t difference = data[n - 1 - i];
+		rotate(sum, difference, _minus45);
+		scratch[i] = sum;
+		scratch[m + i] = -difference;
+	}
+
+	forwardII(scratch, m, scratch + n);
+	forwardIV(scratch + m, m, scratch + n);
+
+	for (uint32_t k = 0; k < m; k++)
+	{
+		data[2 * k] = scratch[k];
+		data[2 * k + 1] = scratch[m + k];
+	}
+}
+
+// Wang's factorisation: rotate the pairs x[k], x[n - 1 - k] into two half size DCT-IIs, then recombine their outputs
+// with 45 degree rotations. w[k] for k < n / 2 lands on output 2k, the rest on the odd outputs
+void CIntegerDCT::forwardIV(int32_t* data, uint32_t n, int32_t* scratch) const
+{
+	if (n == 1)
+	{
+		return;
+	}
+	const uint32_t m = n / 2;
+	const std::vector<Lift>& rotations = getRotations(n);
+
+	for (uint32_t k = 0; k < m; k++)
+	{
+		int32_t x = data[k];
+		int32_t y = data[n - 1 - k];
+		rotate(x, y, rotations[k]);
+		scratch[k] = x;
+		scratch[m + k] = k % 2 == 0 ? -y : y;
+	}
+
+	int32_t* u = scratch;
+	int32_t* v = scratch + m;
+	forwardII(u, m, scratch + n);
+	forwardII(v, m, scratch + n);
+
+	data[0] = u[0];
+	data[n - 1] = v[0];
+	for (uint32_t j = 1; j < m; j++)
+	{
+		int32_t x = u[j];
+		int32_t y = v[m - j];
+		rotate(x, y, _plus45);
+		data[2 * j] = x;
+		data[2 * (j - 1) + 1] = y;
+	}
+}
+
+void CIntegerDCT::inverseII(int32_t* data, uint32_t n, int32_t* scratch) const
+{
+	if (n == 1)
+	{
+		return;
+	}
+	const uint32_t m = n / 2;
+
+	for (uint32_t k = 0; k < m; k++)
+	{
+		scratch[k] = data[2 * k];
+		scratch[m + k] = data[2 * k + 1];
+	}
+
+	inverseII(scratch, m, scratch + n);
+	inverseIV(scratch + m, m, scratch + n);
+
+	for (uint32_t i = 0; i < m; i++)
+	{
+		int32_t sum = scratch[i];
+		int32_t difference = -scratch[m + i];
+		unrotate(sum, difference, _minus45);
+		data[i] = sum;
+		data[n - 1 - i] = difference;
+	}
+}
+
+void CIntegerDCT::inverseIV(int32_t* data, uint32_t n, int32_t* scratch) const
+{
+	if (n == 1)
+	{
+		return;
+	}
+	const uint32_t m = n / 2;
+	const std::vector<Lift>& rotations = getRotations(n);
+
+	int32_t* u = scratch;
+	int32_t* v = scratch + m;
+	u[0] = data[0];
+	v[0] = data[n - 1];
+	for (uint32_t j = 1; j < m; j++)
+	{
+		int32_t x = data[2 * j];
+		int32_t y = data[2 * (j - 1) + 1];
+		unrotate(x, y, _plus45);
+		u[j] = x;
+		v[m - j] = y;
+	}
+
+	inverseII(u, m, scratch + n);
+	inverseII(v, m, scratch + n);
+
+	for (uint32_t k = 0; k < m; k++)
+	{
+		int32_t x = scratch[k];
+		int32_t y = k % 2 == 0 ? -scratch[m + k] : scratch[m + k];
+		unrotate(x, y, rotations[k]);
+		data[k] = x;
+		data[n - 1 - k] = y;
+	}
+}
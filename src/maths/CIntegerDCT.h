@@ -0,0 +1,58 @@
+#ifndef SRC_MATHS_CINTEGERDCT_H_
+#define SRC_MATHS_CINTEGERDCT_H_
+
+#include <cstdint>
+#include <vector>
+
+// A DCT-II from integers to integers which inverse() undoes exactly, for lossless coding. It is the usual split into a
+// half size DCT-II and DCT-IV, recursively, with every rotation done as three lifting steps (x += p * y, y += s * x,
+// x += p * y) rounded to integers, so each step can be taken back by subtracting the same rounded amount. The multipliers
+// are fixed point and the arithmetic all integer, so the rounding is the same on every machine and under -ffast-math.
+// Output is the same orthonormal DCT-II as CDiscreteCosineTransform's, give or take the rounding, a few units at most.
+class CIntegerDCT
+{
+public:
+	// blockSize must be a power of two
+	CIntegerDCT(uint32_t blockSize);
+	~CIntegerDCT();
+
+	static bool isValidBlockSize(uint32_t blockSize);
+
+	// in place on blockSize values, each within +/-2^23. scratch must hold getScratchSize() values. const, so one instance
+	// can be shared by any number of threads with a scratch each
+	void forward(int32_t* data, int32_t* scratch) const;
+	void inverse(int32_t* data, int32_t* scratch) const;
+
+	uint32_t getBlockSize() const;
+	uint32_t getScratchSize() const;
+
+private:
+	// a rotation by theta as lifting steps, p = (cos - 1) / sin and s = sin scaled by 2^fractionBits
+	struct Lift
+	{
+		int64_t p;
+		int64_t s;
+	};
+
+	static const uint32_t fractionBits = 24;
+
+	static Lift makeLift(double theta);
+	static void rotate(int32_t& x, int32_t& y, const Lift& lift);
+	static void unrotate(int32_t& x, int32_t& y, const Lift& lift);
+
+	void forwardII(int32_t* data, uint32_t n, int32_t* scratch) const;
+	void forwardIV(int32_t* data, uint32_t n, int32_t* scratch) const;
+	void inverseII(int32_t* data, uint32_t n, int32_t* scratch) const;
+	void inverseIV(int32_t* data, uint32_t n, int32_t* scratch) const;
+
+	const std::vector<Lift>& getRotations(uint32_t n) const;
+
+	uint32_t _blockSize;
+	Lift _minus45;
+	Lift _plus45;
+
+	// _rotations[log2(n)][k] turns by -(2k + 1) pi / 4n, the first step of a DCT-IV of size n
+	std::vector<std::vector<Lift>> _rotations;
+};
+
+#endif /* SRC_MATHS_CINTEGERDCT_H_ */
@@ -0,0 +1,12 @@
+#include "ADataSource.h"
+
+ADataSource::ADataSource()
+{
+
+}
+
+ADataSource::~ADataSource()
+{
+
+}
+
@@ -0,0 +1,21 @@
+#ifndef SRC_SNAP_COMPRESSOR_ADATASOURCE_H_
+#define SRC_SNAP_COMPRESSOR_ADATASOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// where CXZDecompress gets its compressed bytes from, a file or data pushed in by the user of the library
+class ADataSource
+{
+public:
+	ADataSource();
+	virtual ~ADataSource();
+
+	// returns the number of bytes copied to data, 0 if nothing is available right now
+	virtual size_t read(uint8_t* data, size_t maxBytes) = 0;
+
+	// true once read() will never return any more data
+	virtual bool isFinished() const = 0;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_ADATASOURCE_H_ */
@@ -0,0 +1,400 @@
+#include "CBatchEncoder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "CDiscreteCosineTransform.h"
+#include "CStatistics.h"
+
+namespace
+{
+// how far ahead of the chunk being written out a file's chunks are handed out, enough to keep every worker busy
+const uint32_t chunksAheadPerThread = 2;
+
+bool readFully(int fd, void* data, size_t numBytes, uint64_t offset)
+{
+	uint8_t* destination = static_cast<uint8_t*>(data);
+	while (numBytes != 0)
+	{
+		ssize_t bytesRead = pread(fd, destination, numBytes, offset);
+		if (bytesRead <= 0)
+		{
+			return false;
+		}
+		destination += bytesRead;
+		numBytes -= bytesRead;
+		offset += bytesRead;
+	}
+	return true;
+}
+}
+
+CBatchEncoder::CBatchEncoder(uint32_t blockSize, float quantisationFactor, uint32_t binsToKeep, uint32_t blocksPerChunk, uint32_t numThreads) :
+		_blockSize(blockSize),
+		_quantisationFactor(quantisationFactor),
+		_binsToKeep(binsToKeep),
+		_blocksPerChunk(blocksPerChunk),
+		_numThreads(numThreads),
+		_isLossless(false),
+		_maxError(CSnapEncoder::noMaxError),
+		_baseBins(0),
+		_silenceThreshold(0.0f),
+		_nextFile(0),
+		_nextChunk(0),
+		_elapsedSeconds(0.0)
+{
+	if (_numThreads == 0)
+	{
+		_numThreads = std::max(1U, std::thread::hardware_concurrency());
+	}
+
+	CMemoryPlanner::planEncoder(0, blockSize, binsToKeep, blocksPerChunk, _plan);
+}
+
+CBatchEncoder::~CBatchEncoder()
+{
+}
+
+void CBatchEncoder::setMemoryPlan(const CMemoryPlanner::Plan& plan)
+{
+	_plan = plan;
+}
+
+void CBatchEncoder::setLossless(bool isLossless)
+{
+	_isLossless = isLossless;
+}
+
+void CBatchEncoder::setMaxError(uint32_t maxError)
+{
+	_maxError = maxError;
+}
+
+void CBatchEncoder::setBaseBins(uint32_t baseBins)
+{
+	_baseBins = baseBins;
+}
+
+void CBatchEncoder::setSilenceThreshold(float threshold)
+{
+	_silenceThreshold = threshold;
+}
+
+void CBatchEncoder::setQuantisationTable(const std::vector<float>& weights)
+{
+	_quantisationTable = weights;
+}
+
+void CBatchEncoder::addFile(const std::string& inputFileName, const CSnapHeader& metadata)
+{
+	std::unique_ptr<File> file(new File);
+	file->metadata = metadata;
+	file->numSamples = 0;
+	file->numChunks = 0;
+	file->startTime = 0;
+	file->inputFd = -1;
+	file->outputFh = NULL;
+	file->nextChunkToWrite = 0;
+	file->chunksDone = 0;
+	file->chunksRetired = 0;
+
+	Result result;
+	result.inputFileName = inputFileName;
+	result.outputFileName = inputFileName + ".roundedQuantisedDCT";
+	result.bytesIn = 0;
+	result.bytesOut = 0;
+	result.blocks = 0;
+	result.overflowCount = 0;
+	result.suggestedQuantisationFactor = _quantisationFactor;
+	result.seconds = 0.0;
+	result.error = SNAP_OK;
+
+	// like encode, a partial block at the end is padded by the encoder
+	struct stat st;
+	if (stat(inputFileName.c_str(), &st) == 0)
+	{
+		const uint64_t samplesPerChunk = (uint64_t) _blocksPerChunk * _blockSize;
+		result.bytesIn = st.st_size;
+		file->numSamples = st.st_size / 2;
+		file->numChunks = (file->numSamples + samplesPerChunk - 1) / samplesPerChunk;
+	}
+
+	_files.push_back(std::move(file));
+	_results.push_back(result);
+}
+
+void CBatchEncoder::run()
+{
+	uint64_t start = CStatistics::getNanoseconds();
+
+	// Rice backend encoders have an integer transform each, it's only O(n log n)
+	if (!_isLossless && _maxError == CSnapEncoder::noMaxError)
+	{
+		_dct.reset(new CDiscreteCosineTransform(_blockSize, _plan.dctStrategy));
+	}
+	_nextFile = 0;
+	_nextChunk = 0;
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 0; i < _numThreads; i++)
+	{
+		threads.push_back(std::thread(&CBatchEncoder::work, this));
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	_dct.reset();
+	_elapsedSeconds = (CStatistics::getNanoseconds() - start) / 1e9;
+}
+
+const std::vector<CBatchEncoder::Result>& CBatchEncoder::getResults() const
+{
+	return _results;
+}
+
+uint32_t CBatchEncoder::getNumThreads() const
+{
+	return _numThreads;
+}
+
+double CBatchEncoder::getElapsedSeconds() const
+{
+	return _elapsedSeconds;
+}
+
+void CBatchEncoder::work()
+{
+	// only used for encodeChunk(), the header start() produces is thrown away
+	CSnapEncoder encoder;
+	encoder.setMemoryPlan(_plan);
+	encoder.setTransform(_dct);
+	encoder.setLossless(_isLossless);
+	encoder.setMaxError(_maxError);
+	encoder.setBaseBins(_baseBins);
+	encoder.setSilenceThreshold(_silenceThreshold);
+	encoder.setQuantisationTable(_quantisationTable);
+
+	auto startEncoder = [&]()
+	{
+		ESnapError error = encoder.start(_blockSize, _quantisationFactor, _binsToKeep, _blocksPerChunk, CSnapHeader());
+		size_t numBytes;
+		encoder.getOutput(numBytes);
+		encoder.consumeOutput(numBytes);
+		return error;
+	};
+	ESnapError startError = startEncoder();
+
+	std::vector<std::complex<int8_t>> samples((size_t) _blocksPerChunk * _blockSize);
+
+	uint32_t fileIndex;
+	uint32_t chunkIndex;
+	while (takeJob(fileIndex, chunkIndex))
+	{
+		File& file = *_files[fileIndex];
+		uint64_t firstSample = (uint64_t) chunkIndex * samples.size();
+		size_t numSamples = std::min<uint64_t>(samples.size(), file.numSamples - firstSample);
+		std::unique_ptr<CSnapEncoder::Chunk> chunk(new CSnapEncoder::Chunk);
+
+		ESnapError error = startError;
+		if (error == SNAP_OK && !readFully(file.inputFd, samples.data(), numSamples * 2, firstSample * 2))
+		{
+			error = SNAP_ERROR_IO;
+		}
+		if (error == SNAP_OK)
+		{
+			error = encoder.encodeChunk(samples.data(), numSamples, *chunk);
+			if (error != SNAP_OK)
+			{
+				// the encoder stops after a backend error, the next chunk gets a fresh stream
+				encoder.finish();
+				startError = startEncoder();
+			}
+		}
+
+		addChunk(fileIndex, chunkIndex, std::move(chunk), error);
+	}
+}
+
+bool CBatchEncoder::takeJob(uint32_t& fileIndex, uint32_t& chunkIndex)
+{
+	std::unique_lock<std::mutex> lock(_jobMutex);
+
+	while (_nextFile < _files.size())
+	{
+		// files are opened as their first chunk is handed out, so only those being worked on are open
+		if (_nextChunk == 0 && !openFile(_nextFile))
+		{
+			_nextFile++;
+			continue;
+		}
+
+		if (_nextChunk < _files[_nextFile]->numChunks)
+		{
+			// the chunks before it are all being worked on, so addChunk() will move chunksRetired on
+			if (_nextChunk >= _files[_nextFile]->chunksRetired + chunksAheadPerThread * _numThreads)
+			{
+				_jobCondition.wait(lock);
+				continue;
+			}
+
+			fileIndex = _nextFile;
+			chunkIndex = _nextChunk++;
+			return true;
+		}
+
+		_nextFile++;
+		_nextChunk = 0;
+	}
+
+	return false;
+}
+
+bool CBatchEncoder::openFile(uint32_t fileIndex)
+{
+	File& file = *_files[fileIndex];
+	Result& result = _results[fileIndex];
+
+	file.startTime = CStatistics::getNanoseconds();
+	file.pendingChunks.resize(file.numChunks);
+
+	file.inputFd = open(result.inputFileName.c_str(), O_RDONLY);
+	if (file.inputFd < 0)
+	{
+		result.error = SNAP_ERROR_IO;
+		closeFile(fileIndex);
+		return false;
+	}
+
+	file.outputFh = fopen(result.outputFileName.c_str(), "w");
+	if (!file.outputFh)
+	{
+		result.error = SNAP_ERROR_IO;
+		closeFile(fileIndex);
+		return false;
+	}
+
+	// the writer only assembles chunks, so it needs neither xz nor a DCT of its own
+	file.writer.setTransform(_dct);
+	file.writer.setLossless(_isLossless);
+	file.writer.setMaxError(_maxError);
+	file.writer.setBaseBins(_baseBins);
+	file.writer.setSilenceThreshold(_silenceThreshold);
+	file.writer.setQuantisationTable(_quantisationTable);
+	result.error = file.writer.start(_blockSize, _quantisationFactor, _binsToKeep, _blocksPerChunk, file.metadata);
+	if (result.error == SNAP_OK)
+	{
+		result.error = writeOutput(file, result);
+	}
+
+	if (result.error != SNAP_OK || file.numChunks == 0)
+	{
+		closeFile(fileIndex);
+		return false;
+	}
+
+	return true;
+}
+
+void CBatchEncoder::addChunk(uint32_t fileIndex, uint32_t chunkIndex, std::unique_ptr<CSnapEncoder::Chunk> chunk, ESnapError error)
+{
+	File& file = *_files[fileIndex];
+	Result& result = _results[fileIndex];
+
+	std::lock_guard<std::mutex> lock(file.mutex);
+
+	if (result.error == SNAP_OK)
+	{
+		result.error = error;
+	}
+
+	if (result.error == SNAP_OK)
+	{
+		file.pendingChunks[chunkIndex] = std::move(chunk);
+
+		while (result.error == SNAP_OK && file.nextChunkToWrite < file.numChunks && file.pendingChunks[file.nextChunkToWrite])
+		{
+			std::unique_ptr<CSnapEncoder::Chunk> next = std::move(file.pendingChunks[file.nextChunkToWrite++]);
+			result.error = file.writer.pushChunk(*next);
+			if (result.error == SNAP_OK)
+			{
+				result.error = writeOutput(file, result);
+			}
+		}
+	}
+
+	file.chunksDone++;
+	if (file.chunksDone == file.numChunks)
+	{
+		closeFile(fileIndex);
+	}
+
+	{
+		std::lock_guard<std::mutex> jobLock(_jobMutex);
+		file.chunksRetired = result.error == SNAP_OK ? file.nextChunkToWrite : file.numChunks;
+	}
+	_jobCondition.notify_all();
+}
+
+ESnapError CBatchEncoder::writeOutput(File& file, Result& result)
+{
+	size_t numBytes;
+	const uint8_t* output = file.writer.getOutput(numBytes);
+	if (fwrite(output, 1, numBytes, file.outputFh) != numBytes)
+	{
+		return SNAP_ERROR_IO;
+	}
+	file.writer.consumeOutput(numBytes);
+	result.bytesOut += numBytes;
+
+	return SNAP_OK;
+}
+
+void CBatchEncoder::closeFile(uint32_t fileIndex)
+{
+	File& file = *_files[fileIndex];
+	Result& result = _results[fileIndex];
+
+	if (file.outputFh)
+	{
+		if (result.error == SNAP_OK)
+		{
+			result.error = file.writer.finish();
+		}
+		if (result.error == SNAP_OK)
+		{
+			result.error = writeOutput(file, result);
+		}
+		if (fclose(file.outputFh) != 0 && result.error == SNAP_OK)
+		{
+			result.error = SNAP_ERROR_IO;
+		}
+		file.outputFh = NULL;
+
+		// don't leave half a file behind to be mistaken for a good one
+		if (result.error != SNAP_OK)
+		{
+			remove(result.outputFileName.c_str());
+		}
+
+		result.blocks = file.writer.getBlocksEncoded();
+		result.overflowCount = file.writer.getOverflowCount();
+		result.suggestedQuantisationFactor = file.writer.getSuggestedQuantisationFactor();
+	}
+
+	if (file.inputFd >= 0)
+	{
+		close(file.inputFd);
+		file.inputFd = -1;
+	}
+
+	file.pendingChunks.clear();
+	file.pendingChunks.shrink_to_fit();
+
+	result.seconds = (CStatistics::getNanoseconds() - file.startTime) / 1e9;
+}
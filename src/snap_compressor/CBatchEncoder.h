@@ -0,0 +1,121 @@
+#ifndef SRC_SNAP_COMPRESSOR_CBATCHENCODER_H_
+#define SRC_SNAP_COMPRESSOR_CBATCHENCODER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "CMemoryPlanner.h"
+#include "CSnapEncoder.h"
+#include "CSnapHeader.h"
+#include "SnapError.h"
+
+class CDiscreteCosineTransform;
+
+// Encodes many snapshots with the same parameters on a pool of worker threads, writing snapshot.roundedQuantisedDCT next
+// to each. Work is handed out a chunk at a time in file order, so a worker which runs out moves on to the next file, or
+// helps with the current one when there are fewer files than threads. All the workers share one DCT. Chunks finished out
+// of order wait in memory for the ones before them, so a file is never handed out more than a few chunks per thread ahead
+// of what has been written.
+class CBatchEncoder
+{
+public:
+	struct Result
+	{
+		std::string inputFileName;
+		std::string outputFileName;
+		uint64_t bytesIn;
+		uint64_t bytesOut;
+		uint64_t blocks;
+		uint64_t overflowCount;
+		float suggestedQuantisationFactor;
+		double seconds;	// from its first chunk being handed out to its output being closed
+		ESnapError error;
+	};
+
+	// numThreads of 0 is one per core
+	CBatchEncoder(uint32_t blockSize, float quantisationFactor, uint32_t binsToKeep, uint32_t blocksPerChunk, uint32_t numThreads);
+	virtual ~CBatchEncoder();
+
+	// xz dictionary, DCT strategy and buffer sizes of each worker (see CMemoryPlanner), call before run()
+	void setMemoryPlan(const CMemoryPlanner::Plan& plan);
+
+	// see CSnapEncoder::setLossless(), call before run()
+	void setLossless(bool isLossless);
+	// see CSnapEncoder::setMaxError(), call before run()
+	void setMaxError(uint32_t maxError);
+	// see CSnapEncoder::setBaseBins(), call before run()
+	void setBaseBins(uint32_t baseBins);
+	// see CSnapEncoder::setSilenceThreshold(), call before run()
+	void setSilenceThreshold(float threshold);
+	// see CSnapEncoder::setQuantisationTable(), call before run()
+	void setQuantisationTable(const std::vector<float>& weights);
+
+	void addFile(const std::string& inputFileName, const CSnapHeader& metadata);
+
+	// encodes every file added, returns once they are all done. A file which fails doesn't stop the others
+	void run();
+
+	// in the order the files were added
+	const std::vector<Result>& getResults() const;
+	uint32_t getNumThreads() const;
+	double getElapsedSeconds() const;
+
+private:
+	struct File
+	{
+		CSnapHeader metadata;
+		uint64_t numSamples;
+		uint32_t numChunks;
+		uint64_t startTime;
+
+		int inputFd;
+		FILE* outputFh;
+		CSnapEncoder writer;
+
+		// encoded chunks waiting for the ones before them, written out in order by whichever worker finishes the next one
+		std::mutex mutex;
+		std::vector<std::unique_ptr<CSnapEncoder::Chunk>> pendingChunks;
+		uint32_t nextChunkToWrite;
+		uint32_t chunksDone;
+
+		// chunks written out (all of them once the file has failed), guarded by _jobMutex rather than mutex for takeJob()
+		uint32_t chunksRetired;
+	};
+
+	void work();
+	bool takeJob(uint32_t& fileIndex, uint32_t& chunkIndex);
+	bool openFile(uint32_t fileIndex);
+	void addChunk(uint32_t fileIndex, uint32_t chunkIndex, std::unique_ptr<CSnapEncoder::Chunk> chunk, ESnapError error);
+	ESnapError writeOutput(File& file, Result& result);
+	void closeFile(uint32_t fileIndex);
+
+	uint32_t _blockSize;
+	float _quantisationFactor;
+	uint32_t _binsToKeep;
+	uint32_t _blocksPerChunk;
+	uint32_t _numThreads;
+	bool _isLossless;
+	uint32_t _maxError;
+	uint32_t _baseBins;
+	float _silenceThreshold;
+	std::vector<float> _quantisationTable;
+
+	CMemoryPlanner::Plan _plan;
+	std::shared_ptr<const CDiscreteCosineTransform> _dct;
+	std::vector<std::unique_ptr<File>> _files;
+	std::vector<Result> _results;
+
+	// the next job to hand out, takeJob() waits on _jobCondition while the file is too far ahead
+	std::mutex _jobMutex;
+	std::condition_variable _jobCondition;
+	uint32_t _nextFile;
+	uint32_t _nextChunk;
+
+	double _elapsedSeconds;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CBATCHENCODER_H_ */
@@ -0,0 +1,62 @@
+#include "CCrc32c.h"
+
+#include <cstring>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#ifndef __SSE4_2__
+namespace
+{
+struct SCrcTable
+{
+	uint32_t entries[256];
+
+	SCrcTable()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+			}
+			entries[i] = crc;
+		}
+	}
+};
+
+const SCrcTable crcTable;
+}
+#endif
+
+uint32_t CCrc32c::calculate(const uint8_t* data, size_t length, uint32_t crc)
+{
+	crc = ~crc;
+
+#ifdef __SSE4_2__
+	uint64_t crc64 = crc;
+	while (length >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, data, 8);
+		crc64 = _mm_crc32_u64(crc64, word);
+		data += 8;
+		length -= 8;
+	}
+	crc = crc64;
+
+	while (length--)
+	{
+		crc = _mm_crc32_u8(crc, *data++);
+	}
+#else
+	while (length--)
+	{
+		crc = crcTable.entries[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	}
+#endif
+
+	return ~crc;
+}
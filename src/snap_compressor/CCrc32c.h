@@ -0,0 +1,15 @@
+#ifndef SRC_SNAP_COMPRESSOR_CCRC32C_H_
+#define SRC_SNAP_COMPRESSOR_CCRC32C_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli), uses the SSE4.2 crc32 instruction when the build targets it.
+// Pass the previous result as crc to checksum data in pieces
+class CCrc32c
+{
+public:
+	static uint32_t calculate(const uint8_t* data, size_t length, uint32_t crc = 0);
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CCRC32C_H_ */
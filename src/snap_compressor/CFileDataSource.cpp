@@ -0,0 +1,33 @@
+#include "CFileDataSource.h"
+
+#include <algorithm>
+
+CFileDataSource::CFileDataSource(FILE* fh) :
+		_fh(fh),
+		_end(noEnd)
+{
+}
+
+CFileDataSource::~CFileDataSource()
+{
+}
+
+size_t CFileDataSource::read(uint8_t* data, size_t maxBytes)
+{
+	if (_end != noEnd)
+	{
+		long position = ftell(_fh);
+		maxBytes = position < 0 || (uint64_t) position >= _end ? 0 : std::min<uint64_t>(maxBytes, _end - position);
+	}
+	return fread(data, 1, maxBytes, _fh);
+}
+
+bool CFileDataSource::isFinished() const
+{
+	return feof(_fh) || ferror(_fh) || (_end != noEnd && (uint64_t) ftell(_fh) >= _end);
+}
+
+void CFileDataSource::setEnd(uint64_t end)
+{
+	_end = end;
+}
@@ -0,0 +1,28 @@
+#ifndef SRC_SNAP_COMPRESSOR_CFILEDATASOURCE_H_
+#define SRC_SNAP_COMPRESSOR_CFILEDATASOURCE_H_
+
+#include <cstdint>
+#include <stdio.h>
+
+#include "ADataSource.h"
+
+class CFileDataSource: public ADataSource
+{
+public:
+	CFileDataSource(FILE* fh);
+	virtual ~CFileDataSource();
+
+	size_t read(uint8_t* data, size_t maxBytes);
+	bool isFinished() const;
+
+	// stops reading at file offset end as if the file ended there, noEnd to read to the real end
+	void setEnd(uint64_t end);
+
+	static const uint64_t noEnd = UINT64_MAX;
+
+private:
+	FILE* _fh;
+	uint64_t _end;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CFILEDATASOURCE_H_ */
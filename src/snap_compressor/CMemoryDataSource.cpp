@@ -0,0 +1,72 @@
+#include "CMemoryDataSource.h"
+
+#include <algorithm>
+#include <cstring>
+
+CMemoryDataSource::CMemoryDataSource() :
+		_readPosition(0),
+		_isFinished(false)
+{
+}
+
+CMemoryDataSource::~CMemoryDataSource()
+{
+}
+
+void CMemoryDataSource::append(const uint8_t* data, size_t numBytes)
+{
+	// drop what has already been read before growing the buffer
+	if (_readPosition != 0 && _data.size() + numBytes > _data.capacity())
+	{
+		_data.erase(_data.begin(), _data.begin() + _readPosition);
+		_readPosition = 0;
+	}
+
+	_data.insert(_data.end(), data, data + numBytes);
+}
+
+void CMemoryDataSource::setFinished()
+{
+	_isFinished = true;
+}
+
+void CMemoryDataSource::clear()
+{
+	_data.clear();
+	_readPosition = 0;
+	_isFinished = false;
+}
+
+const uint8_t* CMemoryDataSource::getData() const
+{
+	return _data.data() + _readPosition;
+}
+
+size_t CMemoryDataSource::getNumBytesAvailable() const
+{
+	return _data.size() - _readPosition;
+}
+
+void CMemoryDataSource::skip(size_t numBytes)
+{
+	_readPosition += std::min(numBytes, getNumBytesAvailable());
+
+	if (_readPosition == _data.size())
+	{
+		_data.clear();
+		_readPosition = 0;
+	}
+}
+
+size_t CMemoryDataSource::read(uint8_t* data, size_t maxBytes)
+{
+	size_t bytesRead = std::min(maxBytes, getNumBytesAvailable());
+	memcpy(data, getData(), bytesRead);
+	skip(bytesRead);
+	return bytesRead;
+}
+
+bool CMemoryDataSource::isFinished() const
+{
+	return _isFinished && getNumBytesAvailable() == 0;
+}
@@ -0,0 +1,33 @@
+#ifndef SRC_SNAP_COMPRESSOR_CMEMORYDATASOURCE_H_
+#define SRC_SNAP_COMPRESSOR_CMEMORYDATASOURCE_H_
+
+#include <vector>
+
+#include "ADataSource.h"
+
+// a queue of bytes pushed in by the user of the library, the storage is reused as it drains
+class CMemoryDataSource: public ADataSource
+{
+public:
+	CMemoryDataSource();
+	virtual ~CMemoryDataSource();
+
+	void append(const uint8_t* data, size_t numBytes);
+	void setFinished();
+	void clear();
+
+	// unread bytes, at the front of the queue
+	const uint8_t* getData() const;
+	size_t getNumBytesAvailable() const;
+	void skip(size_t numBytes);
+
+	size_t read(uint8_t* data, size_t maxBytes);
+	bool isFinished() const;
+
+private:
+	std::vector<uint8_t> _data;
+	size_t _readPosition;
+	bool _isFinished;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CMEMORYDATASOURCE_H_ */
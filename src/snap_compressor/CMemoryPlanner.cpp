@@ -0,0 +1,200 @@
+#include "CMemoryPlanner.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#include <lzma.h>
+
+#include "CXZCompress.h"
+
+namespace
+{
+const uint32_t defaultXzBufferSize = 512 * 1024;
+const uint32_t minimumXzBufferSize = 64 * 1024;
+const uint32_t defaultIoBufferSamples = 256 * 1024;
+const uint32_t minimumIoBufferSamples = 16 * 1024;
+const uint32_t defaultDecoderBufferSize = 1024 * 1024;
+const uint64_t defaultDecoderMemoryLimit = 1e9;
+
+// preset 9's dictionary
+const uint32_t maximumDictionarySize = 64 * 1024 * 1024;
+
+// the per block vectors in the encoder/decoder: int8 input, float copy, transform output and int8 result
+uint64_t getBlockBufferBytes(uint32_t blockSize)
+{
+	return 20 * (uint64_t) blockSize;
+}
+
+// what liblzma's stream decoder allocates, which is what its memory limit is checked against
+uint64_t getDecoderXzBytes(uint32_t dictionarySize)
+{
+	lzma_options_lzma options;
+	lzma_lzma_preset(&options, 9);
+	options.dict_size = dictionarySize;
+	lzma_filter filters[2] = {{LZMA_FILTER_LZMA2, &options}, {LZMA_VLI_UNKNOWN, NULL}};
+	return lzma_raw_decoder_memusage(filters);
+}
+}
+
+ESnapError CMemoryPlanner::planEncoder(uint64_t memoryBudget, uint32_t blockSize, uint32_t binsToKeep, uint32_t blocksPerChunk, Plan& plan)
+{
+	plan.dctStrategy = CDiscreteCosineTransform::STRATEGY_TABLE;
+	plan.dictionarySize = 0;
+	plan.decoderMemoryLimit = defaultDecoderMemoryLimit;
+	plan.xzBufferSize = defaultXzBufferSize;
+	plan.ioBufferSamples = defaultIoBufferSamples;
+
+	auto estimate = [&]()
+	{
+		plan.xzBytes = CXZCompress::getMemoryUsage(plan.dictionarySize, plan.xzBufferSize);
+		plan.dctBytes = CDiscreteCosineTransform::getMemoryUsage(blockSize, plan.dctStrategy);
+		plan.bufferBytes = getBlockBufferBytes(blockSize) + 2 * (uint64_t) std::max(plan.ioBufferSamples, blockSize) + plan.xzBufferSize;
+		return getTotalBytes(plan);
+	};
+
+	// the xz buffer gathers blocks' coefficients, one which can't hold two of them is no use
+	const uint32_t smallestXzBufferSize = std::max<uint64_t>(minimumXzBufferSize, 4 * (uint64_t) binsToKeep);
+	if (plan.xzBufferSize < smallestXzBufferSize)
+	{
+		plan.xzBufferSize = smallestXzBufferSize;
+	}
+
+	// a dictionary bigger than a chunk is never filled
+	plan.dictionarySize = getDictionarySize((uint64_t) blocksPerChunk * 2 * binsToKeep);
+
+	if (memoryBudget == 0)
+	{
+		estimate();
+		return SNAP_OK;
+	}
+
+	if (estimate() > memoryBudget)
+	{
+		plan.dctStrategy = CDiscreteCosineTransform::STRATEGY_FFT;
+	}
+	if (estimate() > memoryBudget)
+	{
+		plan.xzBufferSize = smallestXzBufferSize;
+		plan.ioBufferSamples = minimumIoBufferSamples;
+	}
+	while (estimate() > memoryBudget && plan.dictionarySize > LZMA_DICT_SIZE_MIN)
+	{
+		plan.dictionarySize /= 2;
+	}
+
+	return getTotalBytes(plan) > memoryBudget ? SNAP_ERROR_OUT_OF_MEMORY : SNAP_OK;
+}
+
+ESnapError CMemoryPlanner::planDecoder(uint64_t memoryBudget, uint32_t blockSize, uint32_t binsToKeep, uint32_t decimation, uint32_t dictionarySize, Plan& plan)
+{
+	const uint32_t outputBlockSize = blockSize / std::max(decimation, 1U);
+	// an unknown dictionary could be as big as any preset's
+	const uint64_t xzBytes = getDecoderXzBytes(dictionarySize != 0 ? dictionarySize : maximumDictionarySize);
+
+	plan.dctStrategy = CDiscreteCosineTransform::STRATEGY_TABLE;
+	plan.dictionarySize = dictionarySize;
+	plan.decoderMemoryLimit = defaultDecoderMemoryLimit;
+	plan.xzBufferSize = defaultDecoderBufferSize;
+	plan.ioBufferSamples = 0;
+
+	// the ring buffer grows to hold at least one block of coefficients
+	auto estimate = [&]()
+	{
+		plan.dctBytes = CDiscreteCosineTransform::getMemoryUsage(outputBlockSize, plan.dctStrategy);
+		plan.bufferBytes = getBlockBufferBytes(outputBlockSize) + plan.xzBufferSize + std::max(plan.xzBufferSize, 2 * binsToKeep);
+		plan.xzBytes = 0;
+		return getTotalBytes(plan);
+	};
+
+	if (memoryBudget == 0)
+	{
+		estimate();
+		plan.xzBytes = xzBytes;
+		return SNAP_OK;
+	}
+
+	if (estimate() + xzBytes > memoryBudget)
+	{
+		plan.dctStrategy = CDiscreteCosineTransform::STRATEGY_FFT;
+	}
+	if (estimate() + xzBytes > memoryBudget)
+	{
+		plan.xzBufferSize = minimumXzBufferSize;
+	}
+
+	// whatever is left is for liblzma. With the dictionary known it either fits or the file can't be decoded in the
+	// budget, otherwise the stream's dictionary decides whether it is enough
+	uint64_t fixedBytes = estimate();
+	plan.xzBytes = dictionarySize != 0 ? xzBytes : getDecoderXzBytes(LZMA_DICT_SIZE_MIN);
+	if (fixedBytes + plan.xzBytes > memoryBudget)
+	{
+		return SNAP_ERROR_OUT_OF_MEMORY;
+	}
+	plan.decoderMemoryLimit = memoryBudget - fixedBytes;
+	plan.xzBytes = std::min(plan.decoderMemoryLimit, xzBytes);
+
+	return SNAP_OK;
+}
+
+uint32_t CMemoryPlanner::getDictionarySize(uint64_t chunkBytes)
+{
+	uint32_t dictionarySize = LZMA_DICT_SIZE_MIN;
+	while (dictionarySize < chunkBytes && dictionarySize < maximumDictionarySize)
+	{
+		dictionarySize *= 2;
+	}
+	return dictionarySize;
+}
+
+uint64_t CMemoryPlanner::getTotalBytes(const Plan& plan)
+{
+	return plan.xzBytes + plan.dctBytes + plan.bufferBytes;
+}
+
+void CMemoryPlanner::print(const Plan& plan, uint64_t memoryBudget, FILE* fh)
+{
+	const float mebibyte = 1024.0f * 1024.0f;
+
+	fprintf(fh, "Memory plan: %.1f MiB", getTotalBytes(plan) / mebibyte);
+	if (memoryBudget != 0)
+	{
+		fprintf(fh, " of %.1f MiB", memoryBudget / mebibyte);
+	}
+	fprintf(fh, ": xz %.1f MiB", plan.xzBytes / mebibyte);
+	if (plan.dictionarySize != 0)
+	{
+		fprintf(fh, " (dictionary %u KiB)", plan.dictionarySize / 1024);
+	}
+	fprintf(fh, ", DCT %.2f MiB (%s), buffers %.2f MiB\n", plan.dctBytes / mebibyte, plan.dctStrategy == CDiscreteCosineTransform::STRATEGY_FFT ? "fft" : "table", plan.bufferBytes / mebibyte);
+}
+
+bool CMemoryPlanner::parseSize(const char* text, uint64_t& bytes)
+{
+	char* end;
+	bytes = strtoull(text, &end, 10);
+	if (end == text)
+	{
+		return false;
+	}
+
+	switch (*end)
+	{
+		case 'G':
+		case 'g':
+			bytes *= 1024;
+			// fall through
+		case 'M':
+		case 'm':
+			bytes *= 1024;
+			// fall through
+		case 'K':
+		case 'k':
+			bytes *= 1024;
+			end++;
+			break;
+		default:
+			break;
+	}
+
+	return *end == 0;
+}
@@ -0,0 +1,47 @@
+#ifndef SRC_SNAP_COMPRESSOR_CMEMORYPLANNER_H_
+#define SRC_SNAP_COMPRESSOR_CMEMORYPLANNER_H_
+
+#include <cstdint>
+#include <stdio.h>
+
+#include "CDiscreteCosineTransform.h"
+#include "SnapError.h"
+
+// Chooses the xz dictionary, DCT strategy and buffer sizes so an encoder or decoder fits in a memory budget.
+// Giving things up in order of how little they cost: dictionary space beyond a chunk (never used), the DCT tables
+// (the FFT gives the same results), big buffers (a little speed), and finally dictionary space within a chunk (ratio).
+class CMemoryPlanner
+{
+public:
+	struct Plan
+	{
+		CDiscreteCosineTransform::EStrategy dctStrategy;
+		uint32_t dictionarySize;	// 0 is xz preset 9's, or for a decoder not known
+		uint64_t decoderMemoryLimit;	// the most liblzma may use to decode a stream
+		uint32_t xzBufferSize;
+		uint32_t ioBufferSamples;
+
+		// estimated footprint
+		uint64_t xzBytes;
+		uint64_t dctBytes;
+		uint64_t bufferBytes;
+	};
+
+	// a memoryBudget of 0 is unlimited, which gives the defaults. SNAP_ERROR_OUT_OF_MEMORY if even the smallest plan is too big
+	static ESnapError planEncoder(uint64_t memoryBudget, uint32_t blockSize, uint32_t binsToKeep, uint32_t blocksPerChunk, Plan& plan);
+	// dictionarySize is the one the file was compressed with (CSnapDecoder::getDictionarySize()), a budget which can't hold
+	// it is SNAP_ERROR_OUT_OF_MEMORY up front. 0 if it isn't known, liblzma then gets whatever is left
+	static ESnapError planDecoder(uint64_t memoryBudget, uint32_t blockSize, uint32_t binsToKeep, uint32_t decimation, uint32_t dictionarySize, Plan& plan);
+
+	// the smallest power of two dictionary which holds a chunk of chunkBytes, up to xz preset 9's. Each chunk is a separate
+	// stream, so anything bigger is never used but still allocated by the encoder and the decoder
+	static uint32_t getDictionarySize(uint64_t chunkBytes);
+
+	static uint64_t getTotalBytes(const Plan& plan);
+	static void print(const Plan& plan, uint64_t memoryBudget, FILE* fh);
+
+	// bytes, or with a K, M or G suffix (powers of 1024)
+	static bool parseSize(const char* text, uint64_t& bytes);
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CMEMORYPLANNER_H_ */
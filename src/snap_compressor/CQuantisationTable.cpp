@@ -0,0 +1,217 @@
+#include "CQuantisationTable.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// magnitudes are histogrammed on a log scale, 16 buckets an octave up to 2^20 (beyond any DCT coefficient of 8 bit samples)
+const uint32_t bucketsPerOctave = 16;
+const uint32_t numBuckets = 20 * bucketsPerOctave;
+
+// the factors tried, 8 an octave from 2^-16 to 2
+const int32_t factorsPerOctave = 8;
+const int32_t firstFactor = -16 * factorsPerOctave;
+const uint32_t numFactors = 17 * factorsPerOctave + 1;
+
+// the decoder rounds I and Q to 8 bits, which is uniform noise of 1/12 each
+const double roundingErrorPower = 2.0 / 12.0;
+
+uint32_t getBucket(float magnitude)
+{
+	return std::min<uint32_t>(numBuckets - 1, log2f(1.0f + magnitude) * bucketsPerOctave);
+}
+
+float getBucketMagnitude(uint32_t bucket)
+{
+	return exp2f((bucket + 0.5f) / bucketsPerOctave) - 1.0f;
+}
+
+float getFactor(uint32_t factor)
+{
+	return exp2f((firstFactor + (int32_t) factor) / (float) factorsPerOctave);
+}
+}
+
+CQuantisationTable::CQuantisationTable(uint32_t blockSize, uint32_t binsToKeep, uint32_t numBands) :
+		_blockSize(blockSize),
+		_binsToKeep(binsToKeep),
+		_numBands(std::max(1U, std::min(numBands, binsToKeep))),
+		_histograms(_numBands * numBuckets, 0),
+		_signalEnergy(0.0),
+		_droppedEnergy(0.0),
+		_numBlocks(0)
+{
+}
+
+CQuantisationTable::~CQuantisationTable()
+{
+}
+
+void CQuantisationTable::addBlock(const std::complex<float>* coefficients)
+{
+	// the DCT is orthonormal, so the coefficients' energy is the block's
+	for (uint32_t i = 0; i < _binsToKeep; i++)
+	{
+		uint64_t* histogram = _histograms.data() + (uint64_t) i * _numBands / _binsToKeep * numBuckets;
+		histogram[getBucket(std::abs(coefficients[i].real()))]++;
+		histogram[getBucket(std::abs(coefficients[i].imag()))]++;
+		_signalEnergy += std::norm(coefficients[i]);
+	}
+	for (uint32_t i = _binsToKeep; i < _blockSize; i++)
+	{
+		_droppedEnergy += std::norm(coefficients[i]);
+		_signalEnergy += std::norm(coefficients[i]);
+	}
+	_numBlocks++;
+}
+
+uint64_t CQuantisationTable::getNumBlocks() const
+{
+	return _numBlocks;
+}
+
+ESnapError CQuantisationTable::derive(float snr, Result& result) const
+{
+	if (_numBlocks == 0)
+	{
+		return SNAP_ERROR_INVALID_STATE;
+	}
+
+	// everything as energy or bits per block
+	const double signalEnergy = _signalEnergy / _numBlocks;
+	const double fixedError = _droppedEnergy / _numBlocks + roundingErrorPower * _blockSize;
+	const double allowedError = signalEnergy / pow(10.0, snr / 10.0) - fixedError;
+	if (!(allowedError > 0.0))
+	{
+		return SNAP_ERROR_OUT_OF_RANGE;
+	}
+
+	// what quantising each band with each factor costs, the error from clipping at 127 included
+	std::vector<double> errors(_numBands * numFactors);
+	std::vector<double> bits(_numBands * numFactors);
+	for (uint32_t band = 0; band < _numBands; band++)
+	{
+		const uint64_t* histogram = _histograms.data() + band * numBuckets;
+		uint64_t numValues = 0;
+		for (uint32_t bucket = 0; bucket < numBuckets; bucket++)
+		{
+			numValues += histogram[bucket];
+		}
+
+		for (uint32_t factor = 0; factor < numFactors; factor++)
+		{
+			const float quantisationFactor = getFactor(factor);
+			uint64_t counts[128] = {};
+			double error = 0.0;
+			for (uint32_t bucket = 0; bucket < numBuckets; bucket++)
+			{
+				if (histogram[bucket] == 0)
+				{
+					continue;
+				}
+				float magnitude = getBucketMagnitude(bucket);
+				float quantised = std::min(127.0f, roundf(magnitude * quantisationFactor));
+				float difference = magnitude - quantised / quantisationFactor;
+				error += (double) difference * difference * histogram[bucket];
+				counts[(uint32_t) quantised] += histogram[bucket];
+			}
+
+			// the entropy of the magnitudes, and a bit for the sign of those that aren't 0
+			double entropy = 0.0;
+			for (uint32_t value = 0; value < 128; value++)
+			{
+				if (counts[value] != 0)
+				{
+					double probability = (double) counts[value] / numValues;
+					entropy -= counts[value] * log2(probability);
+					entropy += value != 0 ? counts[value] : 0;
+				}
+			}
+
+			errors[band * numFactors + factor] = error / _numBlocks;
+			bits[band * numFactors + factor] = entropy / _numBlocks;
+		}
+	}
+
+	// for a slope lambda (bits per unit of error) each band takes the factor with the fewest bits + lambda * error. The error
+	// only falls as lambda rises, so search for the smallest lambda which is good enough
+	std::vector<uint32_t> choices(_numBands);
+	double totalError = 0.0;
+	double totalBits = 0.0;
+	auto choose = [&](double lambda)
+	{
+		totalError = 0.0;
+		totalBits = 0.0;
+		for (uint32_t band = 0; band < _numBands; band++)
+		{
+			const double* bandErrors = errors.data() + band * numFactors;
+			const double* bandBits = bits.data() + band * numFactors;
+			uint32_t best = 0;
+			for (uint32_t factor = 1; factor < numFactors; factor++)
+			{
+				if (bandBits[factor] + lambda * bandErrors[factor] < bandBits[best] + lambda * bandErrors[best])
+				{
+					best = factor;
+				}
+			}
+			choices[band] = best;
+			totalError += bandErrors[best];
+			totalBits += bandBits[best];
+		}
+	};
+
+	double lowLog = -60.0;
+	double highLog = 60.0;
+	choose(exp2(highLog));
+	if (totalError > allowedError)
+	{
+		return SNAP_ERROR_OUT_OF_RANGE;
+	}
+	for (int i = 0; i < 64; i++)
+	{
+		double middleLog = 0.5 * (lowLog + highLog);
+		choose(exp2(middleLog));
+		if (totalError > allowedError)
+		{
+			lowLog = middleLog;
+		}
+		else
+		{
+			highLog = middleLog;
+		}
+	}
+	choose(exp2(highLog));
+
+	uint32_t finest = *std::max_element(choices.begin(), choices.end());
+	result.quantisationFactor = getFactor(finest);
+	result.weights.resize(_numBands);
+	for (uint32_t band = 0; band < _numBands; band++)
+	{
+		result.weights[band] = getFactor(choices[band]) / result.quantisationFactor;
+	}
+	result.snr = 10.0 * log10(signalEnergy / (totalError + fixedError));
+	result.bitsPerSample = totalBits / _blockSize;
+
+	// the coarsest single factor that is good enough, for comparison
+	result.uniformQuantisationFactor = 0.0f;
+	result.uniformBitsPerSample = 0.0f;
+	for (uint32_t factor = 0; factor < numFactors; factor++)
+	{
+		double uniformError = 0.0;
+		double uniformBits = 0.0;
+		for (uint32_t band = 0; band < _numBands; band++)
+		{
+			uniformError += errors[band * numFactors + factor];
+			uniformBits += bits[band * numFactors + factor];
+		}
+		if (uniformError <= allowedError)
+		{
+			result.uniformQuantisationFactor = getFactor(factor);
+			result.uniformBitsPerSample = uniformBits / _blockSize;
+			break;
+		}
+	}
+
+	return SNAP_OK;
+}
@@ -0,0 +1,52 @@
+#ifndef SRC_SNAP_COMPRESSOR_CQUANTISATIONTABLE_H_
+#define SRC_SNAP_COMPRESSOR_CQUANTISATIONTABLE_H_
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "SnapError.h"
+
+// Derives the per band weights for CSnapEncoder::setQuantisationTable() from the signal itself. Sample blocks' DCT
+// coefficients go into a histogram of magnitudes per band, from which the squared error and the entropy of the quantised
+// values can be estimated for any factor. derive() then gives each band the factor where one more bit saves the same
+// error everywhere (so bands of mostly noise are quantised coarsely), just reaching a target SNR for the whole signal,
+// the bins above binsToKeep and the decoder's rounding to 8 bits included.
+class CQuantisationTable
+{
+public:
+	struct Result
+	{
+		float quantisationFactor;	// the finest band's, so the weights are at most 1
+		std::vector<float> weights;
+		float snr;	// dB, estimated
+		float bitsPerSample;	// entropy of the quantised coefficients, xz gets somewhere near it
+		// the coarsest single factor that reaches the SNR and its bits per sample, 0 if none does (which clipping can cause)
+		float uniformQuantisationFactor;
+		float uniformBitsPerSample;
+	};
+
+	// the kept bins are shared out between numBands the way CSnapEncoder does, numBands can't be more than binsToKeep
+	CQuantisationTable(uint32_t blockSize, uint32_t binsToKeep, uint32_t numBands);
+	virtual ~CQuantisationTable();
+
+	// all blockSize of a block's DCT coefficients, on the 8 bit scale the encoder transforms
+	void addBlock(const std::complex<float>* coefficients);
+	uint64_t getNumBlocks() const;
+
+	// snr in dB. SNAP_ERROR_OUT_OF_RANGE if even the finest factor tried (2) can't reach it, e.g. because too much is cut off
+	ESnapError derive(float snr, Result& result) const;
+
+private:
+	uint32_t _blockSize;
+	uint32_t _binsToKeep;
+	uint32_t _numBands;
+
+	// count of real and imaginary parts in each magnitude bucket, numBuckets per band
+	std::vector<uint64_t> _histograms;
+	double _signalEnergy;
+	double _droppedEnergy;
+	uint64_t _numBlocks;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CQUANTISATIONTABLE_H_ */
@@ -0,0 +1,120 @@
+#include "CRiceBlockReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ADataSource.h"
+#include "CRiceCoder.h"
+
+CRiceBlockReader::CRiceBlockReader(ADataSource* dataSource, uint32_t bufferSize) :
+		_dataSource(dataSource),
+		_buffer(std::max(bufferSize, CRiceCoder::prefixSize)),
+		_readPosition(0),
+		_bytesAvailable(0),
+		_blockSize(0),
+		_isEnd(false),
+		_bytesConsumed(0),
+		_blocksRead(0)
+{
+}
+
+CRiceBlockReader::~CRiceBlockReader()
+{
+}
+
+const uint8_t* CRiceBlockReader::peekBlock(uint32_t& numBytes)
+{
+	numBytes = 0;
+	_blockSize = 0;
+
+	if (_isEnd || !readMore(CRiceCoder::prefixSize))
+	{
+		return NULL;
+	}
+
+	uint32_t blockSize = CRiceCoder::getEncodedSize(_buffer.data() + _readPosition);
+	if (blockSize == 0)
+	{
+		_isEnd = true;
+		return NULL;
+	}
+	if (!readMore(blockSize))
+	{
+		return NULL;
+	}
+
+	_blockSize = blockSize;
+	numBytes = blockSize;
+	return _buffer.data() + _readPosition;
+}
+
+void CRiceBlockReader::advance()
+{
+	_readPosition += _blockSize;
+	_bytesAvailable -= _blockSize;
+	_bytesConsumed += _blockSize;
+	_blocksRead += _blockSize != 0;
+	_blockSize = 0;
+}
+
+bool CRiceBlockReader::isFinished() const
+{
+	if (_isEnd)
+	{
+		return true;
+	}
+	if (!_dataSource->isFinished())
+	{
+		return false;
+	}
+
+	// whatever is left has to be the end of the blocks rather than one cut short
+	return _bytesAvailable >= CRiceCoder::prefixSize && CRiceCoder::getEncodedSize(_buffer.data() + _readPosition) == 0;
+}
+
+bool CRiceBlockReader::isTruncated() const
+{
+	return !_isEnd && _dataSource->isFinished();
+}
+
+void CRiceBlockReader::reset()
+{
+	_readPosition = 0;
+	_bytesAvailable = 0;
+	_blockSize = 0;
+	_isEnd = false;
+	_bytesConsumed = 0;
+	_blocksRead = 0;
+}
+
+size_t CRiceBlockReader::getInputByteCount() const
+{
+	return _bytesConsumed;
+}
+
+uint64_t CRiceBlockReader::getBlocksRead() const
+{
+	return _blocksRead;
+}
+
+bool CRiceBlockReader::readMore(size_t minimumBytes)
+{
+	while (_bytesAvailable < minimumBytes)
+	{
+		// move what's left back to the front of the buffer, growing it if the block won't fit
+		memmove(_buffer.data(), _buffer.data() + _readPosition, _bytesAvailable);
+		_readPosition = 0;
+		if (_buffer.size() < minimumBytes)
+		{
+			_buffer.resize(minimumBytes);
+		}
+
+		size_t bytesRead = _dataSource->read(_buffer.data() + _bytesAvailable, _buffer.size() - _bytesAvailable);
+		if (bytesRead == 0)
+		{
+			return false;
+		}
+		_bytesAvailable += bytesRead;
+	}
+	return true;
+}
@@ -0,0 +1,48 @@
+#ifndef SRC_SNAP_COMPRESSOR_CRICEBLOCKREADER_H_
+#define SRC_SNAP_COMPRESSOR_CRICEBLOCKREADER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ADataSource;
+
+// Splits the lossless backend's payload into its CRiceCoder blocks, the counterpart of CXZDecompress. The blocks end at
+// anything which isn't one (the seek index), a data source which ends first has been cut short
+class CRiceBlockReader
+{
+public:
+	CRiceBlockReader(ADataSource* dataSource, uint32_t bufferSize = 1024 * 1024);
+	virtual ~CRiceBlockReader();
+
+	// a view of the next whole block, valid until the next call, or NULL if it hasn't all arrived or the blocks have ended
+	const uint8_t* peekBlock(uint32_t& numBytes);
+	// past the block peekBlock() returned
+	void advance();
+
+	// true once the blocks have ended, rather than the data source just running dry for now
+	bool isFinished() const;
+	// after peekBlock() returned NULL, whether it was because the data source ended part way through a block
+	bool isTruncated() const;
+
+	// throws away all buffered data, e.g. after the data source has been moved to another chunk
+	void reset();
+
+	size_t getInputByteCount() const;
+	uint64_t getBlocksRead() const;
+
+private:
+	bool readMore(size_t minimumBytes);
+
+	ADataSource* _dataSource;
+
+	std::vector<uint8_t> _buffer;
+	size_t _readPosition;
+	size_t _bytesAvailable;
+	uint32_t _blockSize;
+	bool _isEnd;
+	size_t _bytesConsumed;
+	uint64_t _blocksRead;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CRICEBLOCKREADER_H_ */
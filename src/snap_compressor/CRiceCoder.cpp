@@ -0,0 +1,257 @@
+#include "CRiceCoder.h"
+
+#include <algorithm>
+
+namespace
+{
+uint32_t zigzag(int32_t value)
+{
+	return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+int32_t unzigzag(uint32_t value)
+{
+	return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+// bits go in from the bottom of the word and out as whole bytes
+class CBitWriter
+{
+public:
+	CBitWriter(std::vector<uint8_t>& destination) :
+			_destination(destination),
+			_bits(0),
+			_numBits(0)
+	{
+	}
+
+	// count is at most 32
+	void put(uint32_t value, uint32_t count)
+	{
+		_bits |= (uint64_t) value << _numBits;
+		_numBits += count;
+		if (_numBits >= 32)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				_destination.push_back(_bits >> (8 * i));
+			}
+			_bits >>= 32;
+			_numBits -= 32;
+		}
+	}
+
+	// pads the last byte with zeros
+	void flush()
+	{
+		for (; _numBits > 0; _numBits -= std::min(8U, _numBits))
+		{
+			_destination.push_back(_bits);
+			_bits >>= 8;
+		}
+	}
+
+private:
+	std::vector<uint8_t>& _destination;
+	uint64_t _bits;
+	uint32_t _numBits;
+};
+
+class CBitReader
+{
+public:
+	CBitReader(const uint8_t* data, uint32_t numBytes) :
+			_data(data),
+			_end(data + numBytes),
+			_bits(0),
+			_numBits(0)
+	{
+	}
+
+	// false if the data runs out first
+	bool get(uint32_t count, uint32_t& value)
+	{
+		refill();
+		if (_numBits < count)
+		{
+			return false;
+		}
+		value = _bits & ((1ULL << count) - 1);
+		_bits >>= count;
+		_numBits -= count;
+		return true;
+	}
+
+	// the run of ones up to the zero ending it, which is consumed too. At most maxOnes are counted, a run that long has no
+	// zero consumed after it
+	bool getUnary(uint32_t maxOnes, uint32_t& ones)
+	{
+		refill();
+		uint64_t zeros = ~_bits;
+		ones = zeros == 0 ? 64 : __builtin_ctzll(zeros);
+		if (ones >= maxOnes)
+		{
+			ones = maxOnes;
+			return skip(maxOnes);
+		}
+		return skip(ones + 1);
+	}
+
+private:
+	void refill()
+	{
+		while (_numBits <= 56 && _data != _end)
+		{
+			_bits |= (uint64_t) *_data++ << _numBits;
+			_numBits += 8;
+		}
+	}
+
+	bool skip(uint32_t count)
+	{
+		if (_numBits < count)
+		{
+			return false;
+		}
+		_bits >>= count;
+		_numBits -= count;
+		return true;
+	}
+
+	const uint8_t* _data;
+	const uint8_t* _end;
+	uint64_t _bits;
+	uint32_t _numBits;
+};
+
+// bits to code the band with k, ignoring escapes
+uint64_t getCost(const uint32_t* values, uint32_t numValues, uint32_t k)
+{
+	uint64_t cost = (uint64_t) numValues * (k + 1);
+	for (uint32_t i = 0; i < numValues; i++)
+	{
+		cost += values[i] >> k;
+	}
+	return cost;
+}
+}
+
+void CRiceCoder::encode(const int32_t* values, uint32_t numValues, std::vector<uint8_t>& destination)
+{
+	size_t prefixPosition = destination.size();
+	destination.resize(prefixPosition + prefixSize);
+
+	CBitWriter writer(destination);
+	uint32_t zigzagged[bandSize];
+
+	for (uint32_t first = 0; first < numValues; first += bandSize)
+	{
+		uint32_t count = std::min(bandSize, numValues - first);
+
+		uint64_t sum = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			zigzagged[i] = zigzag(values[first + i]);
+			sum += zigzagged[i];
+		}
+
+		if (sum == 0)
+		{
+			writer.put(zeroBand, 5);
+			continue;
+		}
+
+		// 2^k at or just below the mean, or the next k up if that codes the band in fewer bits
+		uint32_t k = 0;
+		while (k + 1 < zeroBand && ((uint64_t) count << (k + 1)) <= sum)
+		{
+			k++;
+		}
+		if (k + 1 < zeroBand && getCost(zigzagged, count, k + 1) < getCost(zigzagged, count, k))
+		{
+			k++;
+		}
+		writer.put(k, 5);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t quotient = zigzagged[i] >> k;
+			if (quotient < escapeLength)
+			{
+				writer.put((1U << quotient) - 1, quotient + 1);
+				writer.put(zigzagged[i] & ((1ULL << k) - 1), k);
+			}
+			else
+			{
+				writer.put((1U << escapeLength) - 1, escapeLength);
+				writer.put(zigzagged[i], 32);
+			}
+		}
+	}
+	writer.flush();
+
+	uint32_t length = destination.size() - prefixPosition - prefixSize;
+	for (uint32_t i = 0; i < prefixSize; i++)
+	{
+		destination[prefixPosition + i] = length >> (8 * i);
+	}
+}
+
+uint32_t CRiceCoder::getEncodedSize(const uint8_t* prefix)
+{
+	uint32_t length = prefix[0] | (prefix[1] << 8) | (prefix[2] << 16) | ((uint32_t) prefix[3] << 24);
+	return length <= maxEncodedSize ? prefixSize + length : 0;
+}
+
+ESnapError CRiceCoder::decode(const uint8_t* data, uint32_t numBytes, int32_t* values, uint32_t numValues)
+{
+	if (numBytes < prefixSize || getEncodedSize(data) != numBytes)
+	{
+		return SNAP_ERROR_CORRUPT_DATA;
+	}
+
+	CBitReader reader(data + prefixSize, numBytes - prefixSize);
+
+	for (uint32_t first = 0; first < numValues; first += bandSize)
+	{
+		uint32_t count = std::min(bandSize, numValues - first);
+
+		uint32_t k;
+		if (!reader.get(5, k))
+		{
+			return SNAP_ERROR_CORRUPT_DATA;
+		}
+		if (k == zeroBand)
+		{
+			std::fill(values + first, values + first + count, 0);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t quotient, value;
+			if (!reader.getUnary(escapeLength, quotient))
+			{
+				return SNAP_ERROR_CORRUPT_DATA;
+			}
+
+			if (quotient < escapeLength)
+			{
+				uint32_t remainder;
+				if (!reader.get(k, remainder))
+				{
+					return SNAP_ERROR_CORRUPT_DATA;
+				}
+				value = (quotient << k) | remainder;
+			}
+			else if (!reader.get(32, value))
+			{
+				return SNAP_ERROR_CORRUPT_DATA;
+			}
+
+			values[first + i] = unzigzag(value);
+		}
+	}
+
+	return SNAP_OK;
+}
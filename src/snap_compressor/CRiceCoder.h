@@ -0,0 +1,37 @@
+#ifndef SRC_SNAP_COMPRESSOR_CRICECODER_H_
+#define SRC_SNAP_COMPRESSOR_CRICECODER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "SnapError.h"
+
+// Entropy coder for the lossless backend, each block's integers are coded on their own:
+//   length (4, LE), length bytes of LSB first bitstream
+// The values go in bands of bandSize, each band starting with its Rice parameter k (5 bits) picked from the band's mean.
+// A value is zigzagged (0, -1, 1, -2, ... to 0, 1, 2, 3, ...) then written as z >> k in unary (ones ended by a zero) and the
+// low k bits of z. Quotients of escapeLength or more are escapeLength ones followed by z in 32 bits instead. A band which
+// is all zeros is just k = zeroBand.
+// Lengths are always below 2^24, so 4 bytes whose last isn't 0 (e.g. the seek index's magic) can't be a block.
+class CRiceCoder
+{
+public:
+	static const uint32_t prefixSize = 4;
+	static const uint32_t maxEncodedSize = (1 << 24) - 1;
+
+	// appends the encoded block to destination. numValues must be small enough to stay under maxEncodedSize, which any
+	// count up to 2^18 is
+	static void encode(const int32_t* values, uint32_t numValues, std::vector<uint8_t>& destination);
+
+	// bytes in the block starting with prefix (prefixSize bytes), 0 if it isn't the start of a block
+	static uint32_t getEncodedSize(const uint8_t* prefix);
+
+	// data holds the whole block, see getEncodedSize()
+	static ESnapError decode(const uint8_t* data, uint32_t numBytes, int32_t* values, uint32_t numValues);
+
+	static const uint32_t bandSize = 64;
+	static const uint32_t escapeLength = 24;
+	static const uint32_t zeroBand = 31;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CRICECODER_H_ */
@@ -0,0 +1,184 @@
+#include "CSampleFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+// integer max of abs() vectorises where a float one over converted values wouldn't. Accumulator is the narrowest type which
+// holds abs() of every T, narrower lanes go faster
+template<typename T, typename Accumulator>
+float findIntegerPeak(const T* __restrict values, size_t numValues)
+{
+	Accumulator peak = 0;
+	for (size_t i = 0; i < numValues; i++)
+	{
+		peak = std::max(peak, (Accumulator) std::abs((Accumulator) values[i]));
+	}
+	return peak;
+}
+
+float findFloatPeak(const float* __restrict values, size_t numValues)
+{
+	float peak = 0.0f;
+	for (size_t i = 0; i < numValues; i++)
+	{
+		peak = std::max(peak, std::abs(values[i]));
+	}
+	return peak;
+}
+
+template<typename T>
+void scaleToFloat(const T* __restrict values, size_t numValues, float scale, float* __restrict destination)
+{
+	for (size_t i = 0; i < numValues; i++)
+	{
+		destination[i] = values[i] * scale;
+	}
+}
+}
+
+bool CSampleFormat::parse(const char* name, EFormat& format)
+{
+	const EFormat formats[] = {FORMAT_INT8, FORMAT_INT16, FORMAT_INT32, FORMAT_FLOAT32, FORMAT_SDRIQ};
+	for (EFormat candidate : formats)
+	{
+		if (strcmp(name, getName(candidate)) == 0)
+		{
+			format = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* CSampleFormat::getName(EFormat format)
+{
+	switch (format)
+	{
+		case FORMAT_INT8:
+			return "8t";
+		case FORMAT_INT16:
+			return "int16";
+		case FORMAT_INT32:
+			return "int32";
+		case FORMAT_FLOAT32:
+			return "float32";
+		case FORMAT_SDRIQ:
+			return "sdriq";
+	}
+	return "unknown";
+}
+
+CSampleFormat::EFormat CSampleFormat::getFormatFromFileName(const char* fileName)
+{
+	const char* extension = strrchr(fileName, '.');
+	return extension && strcmp(extension, ".sdriq") == 0 ? FORMAT_SDRIQ : FORMAT_INT8;
+}
+
+uint32_t CSampleFormat::getBytesPerSample(EFormat format)
+{
+	switch (format)
+	{
+		case FORMAT_INT8:
+			return 2;
+		case FORMAT_INT16:
+			return 4;
+		case FORMAT_INT32:
+		case FORMAT_FLOAT32:
+			return 8;
+		case FORMAT_SDRIQ:
+			return 0;
+	}
+	return 0;
+}
+
+ESnapError CSampleFormat::readSdriqHeader(FILE* fh, CSnapHeader& header, EFormat& sampleFormat)
+{
+	uint8_t bytes[sdriqHeaderSize];
+	if (fread(bytes, 1, sizeof(bytes), fh) != sizeof(bytes))
+	{
+		return SNAP_ERROR_INVALID_HEADER;
+	}
+
+	uint32_t sampleRate;
+	uint64_t centreFrequency;
+	uint64_t timestamp;
+	uint32_t sampleSize;
+	memcpy(&sampleRate, bytes, 4);
+	memcpy(&centreFrequency, bytes + 4, 8);
+	memcpy(&timestamp, bytes + 12, 8);
+	memcpy(&sampleSize, bytes + 20, 4);
+
+	// 16 bit captures are stored as int16, 24 bit ones in int32
+	if (sampleSize == 16)
+	{
+		sampleFormat = FORMAT_INT16;
+	}
+	else if (sampleSize == 24 || sampleSize == 32)
+	{
+		sampleFormat = FORMAT_INT32;
+	}
+	else
+	{
+		return SNAP_ERROR_UNSUPPORTED;
+	}
+
+	if (!header.has(CSnapHeader::TAG_SAMPLE_RATE))
+	{
+		header.setUint32(CSnapHeader::TAG_SAMPLE_RATE, sampleRate);
+	}
+	if (!header.has(CSnapHeader::TAG_CENTRE_FREQUENCY))
+	{
+		header.setUint64(CSnapHeader::TAG_CENTRE_FREQUENCY, centreFrequency);
+	}
+	if (!header.has(CSnapHeader::TAG_TIMESTAMP))
+	{
+		header.setUint64(CSnapHeader::TAG_TIMESTAMP, timestamp);
+	}
+
+	return SNAP_OK;
+}
+
+float CSampleFormat::findPeak(const void* data, size_t numSamples, EFormat format)
+{
+	switch (format)
+	{
+		case FORMAT_INT8:
+			return findIntegerPeak<int8_t, int32_t>(static_cast<const int8_t*>(data), 2 * numSamples);
+		case FORMAT_INT16:
+			return findIntegerPeak<int16_t, int32_t>(static_cast<const int16_t*>(data), 2 * numSamples);
+		case FORMAT_INT32:
+			return findIntegerPeak<int32_t, int64_t>(static_cast<const int32_t*>(data), 2 * numSamples);
+		case FORMAT_FLOAT32:
+			return findFloatPeak(static_cast<const float*>(data), 2 * numSamples);
+		case FORMAT_SDRIQ:
+			break;
+	}
+	return 0.0f;
+}
+
+void CSampleFormat::toFloat(const void* data, size_t numSamples, EFormat format, float scale, std::complex<float>* destination)
+{
+	float* values = reinterpret_cast<float*>(destination);
+
+	switch (format)
+	{
+		case FORMAT_INT8:
+			scaleToFloat(static_cast<const int8_t*>(data), 2 * numSamples, scale, values);
+			break;
+		case FORMAT_INT16:
+			scaleToFloat(static_cast<const int16_t*>(data), 2 * numSamples, scale, values);
+			break;
+		case FORMAT_INT32:
+			scaleToFloat(static_cast<const int32_t*>(data), 2 * numSamples, scale, values);
+			break;
+		case FORMAT_FLOAT32:
+			scaleToFloat(static_cast<const float*>(data), 2 * numSamples, scale, values);
+			break;
+		case FORMAT_SDRIQ:
+			break;
+	}
+}
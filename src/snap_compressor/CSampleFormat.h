@@ -0,0 +1,48 @@
+#ifndef SRC_SNAP_COMPRESSOR_CSAMPLEFORMAT_H_
+#define SRC_SNAP_COMPRESSOR_CSAMPLEFORMAT_H_
+
+#include <complex>
+#include <cstdint>
+#include <stdio.h>
+
+#include "CSnapHeader.h"
+#include "SnapError.h"
+
+// Raw IQ layouts the encoder can read without converting them to .8t first, and the kernels that turn them into the floats
+// the DCT works on. The kernels are plain loops over the interleaved I and Q values which the compiler vectorises.
+class CSampleFormat
+{
+public:
+	enum EFormat
+	{
+		FORMAT_INT8,	// .8t
+		FORMAT_INT16,
+		FORMAT_INT32,
+		FORMAT_FLOAT32,
+		FORMAT_SDRIQ	// sdriq header, then int16 or int32 pairs depending on its sample size
+	};
+
+	// 8t, int16, int32, float32 or sdriq
+	static bool parse(const char* name, EFormat& format);
+	static const char* getName(EFormat format);
+
+	// sdriq for .sdriq files, otherwise 8t
+	static EFormat getFormatFromFileName(const char* fileName);
+
+	// bytes per complex sample, sdriq's depend on its header
+	static uint32_t getBytesPerSample(EFormat format);
+
+	// reads the 32 byte sdriq header, leaving fh at the first sample. Fills in the capture metadata tags header doesn't have
+	// already (so the command line wins) and sets sampleFormat to the layout of the samples
+	static ESnapError readSdriqHeader(FILE* fh, CSnapHeader& header, EFormat& sampleFormat);
+
+	// the largest absolute I or Q value
+	static float findPeak(const void* data, size_t numSamples, EFormat format);
+
+	// destination[i] = data[i] * scale
+	static void toFloat(const void* data, size_t numSamples, EFormat format, float scale, std::complex<float>* destination);
+
+	static const uint32_t sdriqHeaderSize = 32;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CSAMPLEFORMAT_H_ */
@@ -0,0 +1,225 @@
+#include "CSeekIndex.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "CCrc32c.h"
+
+namespace
+{
+const uint8_t indexMagic[4] = {'S', 'N', 'I', 'X'};
+const long trailerSize = 8 + sizeof(indexMagic);
+// indexMagic, numEntries and totalBlocks, followed from version 3 by totalSamples
+const uint64_t indexHeaderSize = 4 + 4 + 8;
+}
+
+CSeekIndex::CSeekIndex() :
+		_totalBlocks(0),
+		_totalSamples(0),
+		_indexOffset(0),
+		_isLayered(false)
+{
+}
+
+CSeekIndex::~CSeekIndex()
+{
+}
+
+void CSeekIndex::addEntry(uint64_t firstBlock, uint64_t offset, uint32_t checksum, uint64_t enhancementOffset)
+{
+	_entries.push_back({firstBlock, offset, checksum, enhancementOffset});
+}
+
+void CSeekIndex::setTotalBlocks(uint64_t totalBlocks)
+{
+	_totalBlocks = totalBlocks;
+}
+
+void CSeekIndex::setTotalSamples(uint64_t totalSamples)
+{
+	_totalSamples = totalSamples;
+}
+
+void CSeekIndex::setLayered(bool isLayered)
+{
+	_isLayered = isLayered;
+}
+
+void CSeekIndex::write(std::vector<uint8_t>& destination, uint64_t indexOffset) const
+{
+	uint32_t numEntries = _entries.size();
+
+	auto append = [&destination](const void* data, size_t numBytes)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+		destination.insert(destination.end(), bytes, bytes + numBytes);
+	};
+
+	const size_t indexStart = destination.size();
+	append(indexMagic, 4);
+	append(&numEntries, 4);
+	append(&_totalBlocks, 8);
+	append(&_totalSamples, 8);
+
+	for (const Entry& entry : _entries)
+	{
+		append(&entry.firstBlock, 8);
+		append(&entry.offset, 8);
+		append(&entry.checksum, 4);
+		if (_isLayered)
+		{
+			append(&entry.enhancementOffset, 8);
+		}
+	}
+
+	uint32_t checksum = CCrc32c::calculate(destination.data() + indexStart, destination.size() - indexStart);
+	append(&checksum, 4);
+
+	append(&indexOffset, 8);
+	append(indexMagic, 4);
+}
+
+bool CSeekIndex::read(FILE* fh, uint8_t fileVersion, uint64_t payloadOffset)
+{
+	_entries.clear();
+
+	if (fseek(fh, 0, SEEK_END) != 0)
+	{
+		return false;
+	}
+	long fileSize = ftell(fh);
+	if (fileSize < trailerSize || fseek(fh, -trailerSize, SEEK_END) != 0)
+	{
+		return false;
+	}
+	const uint64_t trailerOffset = fileSize - trailerSize;
+
+	uint64_t indexOffset;
+	uint8_t magic[4];
+	if (fread(&indexOffset, 8, 1, fh) != 1 || fread(magic, 1, 4, fh) != 4 || memcmp(magic, indexMagic, 4) != 0)
+	{
+		return false;
+	}
+
+	const bool hasChecksums = fileVersion >= 3;
+	const bool hasTotalSamples = fileVersion >= 3;
+	const uint64_t checksumSize = hasChecksums ? 4 : 0;
+	const uint64_t headerSize = indexHeaderSize + (hasTotalSamples ? 8 : 0);
+	const uint64_t entrySize = 8 + 8 + checksumSize + (_isLayered ? 8 : 0);
+
+	// the index runs from indexOffset right up to the trailer
+	if (indexOffset < payloadOffset || indexOffset > trailerOffset || trailerOffset - indexOffset < headerSize + checksumSize)
+	{
+		return false;
+	}
+	std::vector<uint8_t> bytes(trailerOffset - indexOffset);
+	if (fseek(fh, indexOffset, SEEK_SET) != 0 || fread(bytes.data(), 1, bytes.size(), fh) != bytes.size() || memcmp(bytes.data(), indexMagic, 4) != 0)
+	{
+		return false;
+	}
+
+	uint32_t numEntries;
+	memcpy(&numEntries, bytes.data() + 4, 4);
+	memcpy(&_totalBlocks, bytes.data() + 8, 8);
+	_totalSamples = 0;
+	if (hasTotalSamples)
+	{
+		memcpy(&_totalSamples, bytes.data() + indexHeaderSize, 8);
+	}
+	if (bytes.size() != headerSize + numEntries * entrySize + checksumSize)
+	{
+		return false;
+	}
+
+	if (hasChecksums)
+	{
+		uint32_t checksum;
+		memcpy(&checksum, bytes.data() + bytes.size() - 4, 4);
+		if (checksum != CCrc32c::calculate(bytes.data(), bytes.size() - 4))
+		{
+			return false;
+		}
+	}
+
+	_entries.resize(numEntries);
+	const uint8_t* read = bytes.data() + headerSize;
+	for (Entry& entry : _entries)
+	{
+		entry.checksum = 0;
+		entry.enhancementOffset = 0;
+		memcpy(&entry.firstBlock, read, 8);
+		memcpy(&entry.offset, read + 8, 8);
+		read += 16;
+		if (hasChecksums)
+		{
+			memcpy(&entry.checksum, read, 4);
+			read += 4;
+		}
+		if (_isLayered)
+		{
+			memcpy(&entry.enhancementOffset, read, 8);
+			read += 8;
+		}
+	}
+
+	// chunks cover the blocks from 0 in order and lie end to end between the header and the index, an enhancement layer
+	// (if there is one) inside its chunk
+	bool isValid = _entries.empty() ? _totalBlocks == 0 : _entries[0].firstBlock == 0 && _entries[0].offset >= payloadOffset;
+	for (size_t i = 0; isValid && i < _entries.size(); i++)
+	{
+		const Entry& entry = _entries[i];
+		const bool isLast = i + 1 == _entries.size();
+		const uint64_t nextFirstBlock = isLast ? _totalBlocks : _entries[i + 1].firstBlock;
+		const uint64_t chunkEnd = isLast ? indexOffset : _entries[i + 1].offset;
+		isValid = entry.firstBlock < nextFirstBlock && entry.offset < chunkEnd
+				&& (entry.enhancementOffset == 0 || (entry.enhancementOffset > entry.offset && entry.enhancementOffset < chunkEnd));
+	}
+	if (!isValid)
+	{
+		_entries.clear();
+		return false;
+	}
+
+	_indexOffset = indexOffset;
+	return true;
+}
+
+const CSeekIndex::Entry* CSeekIndex::findEntry(uint64_t block) const
+{
+	if (block >= _totalBlocks || _entries.empty())
+	{
+		return NULL;
+	}
+
+	// last entry whose first block is <= block
+	auto it = std::upper_bound(_entries.begin(), _entries.end(), block, [](uint64_t b, const Entry& entry)
+	{
+		return b < entry.firstBlock;
+	});
+
+	if (it == _entries.begin())
+	{
+		return NULL;
+	}
+	return &*(it - 1);
+}
+
+const std::vector<CSeekIndex::Entry>& CSeekIndex::getEntries() const
+{
+	return _entries;
+}
+
+uint64_t CSeekIndex::getTotalBlocks() const
+{
+	return _totalBlocks;
+}
+
+uint64_t CSeekIndex::getTotalSamples() const
+{
+	return _totalSamples;
+}
+
+uint64_t CSeekIndex::getPayloadEnd() const
+{
+	return _indexOffset;
+}
@@ -0,0 +1,62 @@
+#ifndef SRC_SNAP_COMPRESSOR_CSEEKINDEX_H_
+#define SRC_SNAP_COMPRESSOR_CSEEKINDEX_H_
+
+#include <cstdint>
+#include <stdio.h>
+#include <vector>
+
+// Maps block numbers to the file offset of the independently decodable xz stream (chunk) containing them.
+// Written after the last chunk, followed by a fixed size trailer so it can be found from the end of the file:
+//   indexMagic, numEntries (4), totalBlocks (8), [totalSamples (8)], numEntries * (firstBlock (8), offset (8), [checksum (4)], [enhancementOffset (8)]), [indexChecksum (4)], indexOffset (8), indexMagic
+// the crc32c of each chunk's compressed bytes is present from file version 3, so chunks can be checked without decompressing them,
+// as is the crc32c of the index itself (from its indexMagic to the last entry), and the number of samples encoded, the last
+// block being padded with zeros when it is partial.
+// Layered files (see CSnapHeader::TAG_BASE_BINS) also have where each chunk's enhancement layer starts
+class CSeekIndex
+{
+public:
+	struct Entry
+	{
+		uint64_t firstBlock;
+		uint64_t offset;
+		uint32_t checksum;
+		uint64_t enhancementOffset;
+	};
+
+	CSeekIndex();
+	virtual ~CSeekIndex();
+
+	void addEntry(uint64_t firstBlock, uint64_t offset, uint32_t checksum, uint64_t enhancementOffset = 0);
+	void setTotalBlocks(uint64_t totalBlocks);
+	void setTotalSamples(uint64_t totalSamples);
+
+	// whether entries have an enhancementOffset, which the file's header says. Set before read() or write()
+	void setLayered(bool isLayered);
+
+	// indexOffset is where in the file the index is being written
+	void write(std::vector<uint8_t>& destination, uint64_t indexOffset) const;
+
+	// returns false if the file has no (intact) index, the file position is undefined afterwards. payloadOffset is where the
+	// first chunk can start (CSnapHeader::getPayloadOffset()), entries must be in order and between it and the index
+	bool read(FILE* fh, uint8_t fileVersion, uint64_t payloadOffset);
+
+	// the chunk containing block, or NULL if block is past the end
+	const Entry* findEntry(uint64_t block) const;
+
+	const std::vector<Entry>& getEntries() const;
+	uint64_t getTotalBlocks() const;
+	// 0 after reading a file before version 3, which only held whole blocks
+	uint64_t getTotalSamples() const;
+
+	// end of the last chunk, where the index starts
+	uint64_t getPayloadEnd() const;
+
+private:
+	std::vector<Entry> _entries;
+	uint64_t _totalBlocks;
+	uint64_t _totalSamples;
+	uint64_t _indexOffset;
+	bool _isLayered;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CSEEKINDEX_H_ */
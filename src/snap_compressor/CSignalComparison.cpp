@@ -0,0 +1,214 @@
+#include "CSignalComparison.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+// int8 values per pass of the error kernel, small enough that its int32 sums can't overflow (254^2 * 16384 < 2^31)
+const size_t kernelValues = 16384;
+}
+
+CSignalComparison::CSignalComparison(uint32_t numBands, uint32_t fftSize) :
+		_numSamples(0),
+		_signalSum(0),
+		_errorSum(0),
+		_maxError(0),
+		_numBands(numBands),
+		_fftSize(fftSize),
+		_fftConfig(NULL),
+		_windowPower(0.0),
+		_numWindows(0)
+{
+	if (_numBands == 0)
+	{
+		return;
+	}
+
+	// a band can't be narrower than one bin
+	_numBands = std::min(_numBands, _fftSize);
+
+	_fftConfig = kiss_fft_alloc(_fftSize, 0, NULL, NULL);
+	_fftInput.resize(_fftSize);
+	_fftOutput.resize(_fftSize);
+	_binSignalPower.resize(_fftSize, 0.0);
+	_binErrorPower.resize(_fftSize, 0.0);
+
+	// hann window, so strong signals don't leak across the bands
+	_window.resize(_fftSize);
+	for (uint32_t i = 0; i < _fftSize; i++)
+	{
+		_window[i] = 0.5f - 0.5f * cosf(2.0f * M_PI * i / _fftSize);
+		_windowPower += _window[i] * _window[i] / _fftSize;
+	}
+
+	_pendingReference.reserve(_fftSize);
+	_pendingTest.reserve(_fftSize);
+}
+
+CSignalComparison::~CSignalComparison()
+{
+	if (_fftConfig)
+	{
+		kiss_fft_free(_fftConfig);
+	}
+}
+
+void CSignalComparison::addSamples(const std::complex<int8_t>* reference, const std::complex<int8_t>* test, size_t numSamples)
+{
+	accumulateErrors(reinterpret_cast<const int8_t*>(reference), reinterpret_cast<const int8_t*>(test), 2 * numSamples);
+	_numSamples += numSamples;
+
+	if (_numBands == 0)
+	{
+		return;
+	}
+
+	// finish off a window started by the last call
+	if (!_pendingReference.empty())
+	{
+		size_t samplesToCopy = std::min<size_t>(numSamples, _fftSize - _pendingReference.size());
+		_pendingReference.insert(_pendingReference.end(), reference, reference + samplesToCopy);
+		_pendingTest.insert(_pendingTest.end(), test, test + samplesToCopy);
+		reference += samplesToCopy;
+		test += samplesToCopy;
+		numSamples -= samplesToCopy;
+
+		if (_pendingReference.size() == _fftSize)
+		{
+			accumulateSpectrum(_pendingReference.data(), _pendingTest.data());
+			_pendingReference.clear();
+			_pendingTest.clear();
+		}
+	}
+
+	while (numSamples >= _fftSize)
+	{
+		accumulateSpectrum(reference, test);
+		reference += _fftSize;
+		test += _fftSize;
+		numSamples -= _fftSize;
+	}
+
+	_pendingReference.insert(_pendingReference.end(), reference, reference + numSamples);
+	_pendingTest.insert(_pendingTest.end(), test, test + numSamples);
+}
+
+uint64_t CSignalComparison::getNumSamples() const
+{
+	return _numSamples;
+}
+
+double CSignalComparison::getSignalPower() const
+{
+	return _numSamples ? _signalSum / (double) _numSamples : 0.0;
+}
+
+double CSignalComparison::getErrorPower() const
+{
+	return _numSamples ? _errorSum / (double) _numSamples : 0.0;
+}
+
+float CSignalComparison::getSnr() const
+{
+	return 10.0 * log10(getSignalPower() / getErrorPower());
+}
+
+float CSignalComparison::getEvm() const
+{
+	return 100.0 * sqrt(getErrorPower() / getSignalPower());
+}
+
+uint32_t CSignalComparison::getMaxError() const
+{
+	return _maxError;
+}
+
+std::vector<CSignalComparison::Band> CSignalComparison::getBands() const
+{
+	std::vector<Band> bands(_numBands);
+	if (_numBands == 0)
+	{
+		return bands;
+	}
+
+	// scaled so the bands add up to the mean power per sample (parseval, undoing the window's loss).
+	// Bins are reordered from FFT order (0 to fs/2 then -fs/2 to 0) to run from -fs/2 upwards
+	const double scale = _numWindows ? 1.0 / (_numWindows * (double) _fftSize * _fftSize * _windowPower) : 0.0;
+	for (uint32_t band = 0; band < _numBands; band++)
+	{
+		uint32_t firstBin = band * (uint64_t) _fftSize / _numBands;
+		uint32_t lastBin = (band + 1) * (uint64_t) _fftSize / _numBands;
+
+		bands[band].startFrequency = firstBin / (float) _fftSize - 0.5f;
+		bands[band].endFrequency = lastBin / (float) _fftSize - 0.5f;
+		bands[band].signalPower = 0.0;
+		bands[band].errorPower = 0.0;
+
+		for (uint32_t i = firstBin; i < lastBin; i++)
+		{
+			uint32_t bin = (i + _fftSize / 2) % _fftSize;
+			bands[band].signalPower += _binSignalPower[bin] * scale;
+			bands[band].errorPower += _binErrorPower[bin] * scale;
+		}
+	}
+
+	return bands;
+}
+
+void CSignalComparison::accumulateErrors(const int8_t* reference, const int8_t* test, size_t numValues)
+{
+	// plain int32 loops over the interleaved I/Q values, which the compiler vectorises
+	while (numValues != 0)
+	{
+		const size_t values = std::min(numValues, kernelValues);
+		int32_t signalSum = 0;
+		int32_t errorSum = 0;
+		int32_t maxError = 0;
+
+		for (size_t i = 0; i < values; i++)
+		{
+			int32_t value = reference[i];
+			int32_t error = test[i] - value;
+			signalSum += value * value;
+			errorSum += error * error;
+			maxError = std::max(maxError, std::abs(error));
+		}
+
+		_signalSum += signalSum;
+		_errorSum += errorSum;
+		_maxError = std::max<uint32_t>(_maxError, maxError);
+
+		reference += values;
+		test += values;
+		numValues -= values;
+	}
+}
+
+void CSignalComparison::accumulateSpectrum(const std::complex<int8_t>* reference, const std::complex<int8_t>* test)
+{
+	for (uint32_t i = 0; i < _fftSize; i++)
+	{
+		_fftInput[i].r = reference[i].real() * _window[i];
+		_fftInput[i].i = reference[i].imag() * _window[i];
+	}
+	kiss_fft(_fftConfig, _fftInput.data(), _fftOutput.data());
+	for (uint32_t i = 0; i < _fftSize; i++)
+	{
+		_binSignalPower[i] += _fftOutput[i].r * _fftOutput[i].r + _fftOutput[i].i * _fftOutput[i].i;
+	}
+
+	for (uint32_t i = 0; i < _fftSize; i++)
+	{
+		_fftInput[i].r = (test[i].real() - reference[i].real()) * _window[i];
+		_fftInput[i].i = (test[i].imag() - reference[i].imag()) * _window[i];
+	}
+	kiss_fft(_fftConfig, _fftInput.data(), _fftOutput.data());
+	for (uint32_t i = 0; i < _fftSize; i++)
+	{
+		_binErrorPower[i] += _fftOutput[i].r * _fftOutput[i].r + _fftOutput[i].i * _fftOutput[i].i;
+	}
+
+	_numWindows++;
+}
@@ -0,0 +1,67 @@
+#ifndef SRC_SNAP_COMPRESSOR_CSIGNALCOMPARISON_H_
+#define SRC_SNAP_COMPRESSOR_CSIGNALCOMPARISON_H_
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "kiss_fft.h"
+
+// Measures how far a reconstruction is from the original: SNR, EVM and the largest error over the whole signal,
+// and optionally the signal and error power in frequency bands (from windowed FFTs) to show where the error lies.
+// Samples can be added in pieces of any size.
+class CSignalComparison
+{
+public:
+	struct Band
+	{
+		float startFrequency;	// as a fraction of the sample rate, -0.5 to 0.5
+		float endFrequency;
+		double signalPower;
+		double errorPower;
+	};
+
+	// numBands of 0 skips the FFTs, which are most of the work
+	CSignalComparison(uint32_t numBands, uint32_t fftSize = 1024);
+	virtual ~CSignalComparison();
+
+	void addSamples(const std::complex<int8_t>* reference, const std::complex<int8_t>* test, size_t numSamples);
+
+	uint64_t getNumSamples() const;
+
+	// mean power per sample
+	double getSignalPower() const;
+	double getErrorPower() const;
+
+	float getSnr() const;	// dB
+	float getEvm() const;	// rms error / rms signal, as a percentage
+	uint32_t getMaxError() const;	// largest error of an I or Q value
+
+	std::vector<Band> getBands() const;
+
+private:
+	void accumulateErrors(const int8_t* reference, const int8_t* test, size_t numValues);
+	void accumulateSpectrum(const std::complex<int8_t>* reference, const std::complex<int8_t>* test);
+
+	uint64_t _numSamples;
+	uint64_t _signalSum;
+	uint64_t _errorSum;
+	uint32_t _maxError;
+
+	uint32_t _numBands;
+	uint32_t _fftSize;
+	kiss_fft_cfg _fftConfig;
+	std::vector<float> _window;
+	double _windowPower;
+	std::vector<kiss_fft_cpx> _fftInput;
+	std::vector<kiss_fft_cpx> _fftOutput;
+	std::vector<double> _binSignalPower;
+	std::vector<double> _binErrorPower;
+	uint64_t _numWindows;
+
+	// samples carried over until there is a whole FFT's worth
+	std::vector<std::complex<int8_t>> _pendingReference;
+	std::vector<std::complex<int8_t>> _pendingTest;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CSIGNALCOMPARISON_H_ */
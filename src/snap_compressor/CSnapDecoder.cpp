@@ -0,0 +1,938 @@
+#include "CSnapDecoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "CDiscreteCosineTransform.h"
+#include "CFileDataSource.h"
+#include "CIntegerDCT.h"
+#include "CRiceBlockReader.h"
+#include "CRiceCoder.h"
+#include "CSnapEncoder.h"
+#include "CXZDecompress.h"
+
+CSnapDecoder::CSnapDecoder() :
+		_fh(NULL),
+		_decompressorSource(NULL),
+		_statistics(NULL),
+		_memoryLimit(1e9),
+		_bufferSize(1024 * 1024),
+		_dctStrategy(CDiscreteCosineTransform::STRATEGY_TABLE),
+		_isHeaderRead(false),
+		_hasIndex(false),
+		_blockSize(0),
+		_quantisationFactor(0.0f),
+		_binsToKeep(0),
+		_baseBins(0),
+		_blocksPerChunk(0),
+		_isBaseLayerOnly(false),
+		_isRice(false),
+		_integerStep(1),
+		_maxError(CSnapEncoder::noMaxError),
+		_hasSilence(false),
+		_isNoiseFill(false),
+		_decimation(1),
+		_outputBlockSize(0),
+		_dictionarySize(0),
+		_blocksToSkip(0),
+		_samplesToSkip(0),
+		_nextBlock(0),
+		_chunk(NULL),
+		_chunkBytes(0),
+		_chunkBlocks(0),
+		_chunkBlock(0),
+		_nextChunk(0),
+		_isChunkBaseOnly(false),
+		_earlierChunksBytesIn(0),
+		_earlierChunksBytesOut(0),
+		_decodedReadPosition(0)
+{
+}
+
+CSnapDecoder::~CSnapDecoder()
+{
+}
+
+ESnapError CSnapDecoder::open(FILE* fh)
+{
+	reset();
+
+	ESnapError error = _header.read(fh);
+	if (error != SNAP_OK)
+	{
+		return error;
+	}
+
+	error = validateHeader();
+	if (error != SNAP_OK)
+	{
+		return error;
+	}
+
+	// version 3 files always end with the index, without it the file has been cut short (or the index is damaged)
+	_index.setLayered(_baseBins < _binsToKeep);
+	_hasIndex = _index.read(fh, _header.getVersion(), _header.getPayloadOffset());
+	if (!_hasIndex && _header.getVersion() >= 3)
+	{
+		return SNAP_ERROR_CORRUPT_DATA;
+	}
+
+	// earlier versions only held whole blocks, since then the last one can be partial
+	if (_hasIndex && _header.getVersion() < 3)
+	{
+		_index.setTotalSamples(_index.getTotalBlocks() * _blockSize);
+	}
+	const uint64_t totalSamples = _index.getTotalSamples();
+	const uint64_t totalBlocks = _index.getTotalBlocks();
+	if (_hasIndex && (totalSamples > totalBlocks * _blockSize || (totalBlocks != 0 && totalSamples <= (totalBlocks - 1) * _blockSize)))
+	{
+		return SNAP_ERROR_CORRUPT_DATA;
+	}
+
+	// the first block header of the first chunk says how big the dictionary is
+	fseek(fh, _header.getPayloadOffset(), SEEK_SET);
+	if (!_isRice)
+	{
+		uint8_t streamStart[LZMA_STREAM_HEADER_SIZE + LZMA_BLOCK_HEADER_SIZE_MAX];
+		size_t bytesRead = fread(streamStart, 1, sizeof(streamStart), fh);
+		_dictionarySize = CXZDecompress::getDictionarySize(streamStart, bytesRead);
+		fseek(fh, _header.getPayloadOffset(), SEEK_SET);
+	}
+
+	_fh = fh;
+	_fileSource.reset(new CFileDataSource(fh));
+	_isHeaderRead = true;
+
+	return SNAP_OK;
+}
+
+ESnapError CSnapDecoder::pushBytes(const uint8_t* data, size_t numBytes)
+{
+	if (_fh || _memorySource.isFinished())
+	{
+		return SNAP_ERROR_INVALID_STATE;
+	}
+
+	_memorySource.append(data, numBytes);
+
+	if (!_isHeaderRead)
+	{
+		return parseStreamHeader();
+	}
+
+	return SNAP_OK;
+}
+
+void CSnapDecoder::endOfInput()
+{
+	_memorySource.setFinished();
+}
+
+void CSnapDecoder::setMemoryPlan(const CMemoryPlanner::Plan& plan)
+{
+	_memoryLimit = plan.decoderMemoryLimit;
+	_bufferSize = plan.xzBufferSize;
+	_dctStrategy = plan.dctStrategy;
+
+	_dct.reset();
+}
+
+void CSnapDecoder::setStatistics(CStatistics* statistics)
+{
+	_statistics = statistics;
+}
+
+void CSnapDecoder::reset()
+{
+	_fh = NULL;
+	_fileSource.reset();
+	_memorySource.clear();
+	_header = CSnapHeader();
+	_index = CSeekIndex();
+	_isHeaderRead = false;
+	_hasIndex = false;
+	_isRice = false;
+	_maxError = CSnapEncoder::noMaxError;
+	_isBaseLayerOnly = false;
+	_hasSilence = false;
+	_isNoiseFill = false;
+	_random.seed();
+	_decimation = 1;
+	_dictionarySize = 0;
+	_blocksToSkip = 0;
+	_samplesToSkip = 0;
+	_nextBlock = 0;
+	_chunkBytes = 0;
+	_chunkBlocks = 0;
+	_chunkBlock = 0;
+	_nextChunk = 0;
+	_isChunkBaseOnly = false;
+	_earlierChunksBytesIn = 0;
+	_earlierChunksBytesOut = 0;
+	_decoded.clear();
+	_decodedReadPosition = 0;
+
+	if (_decompressor)
+	{
+		_decompressor->reset();
+	}
+	if (_blockReader)
+	{
+		_blockReader->reset();
+	}
+}
+
+ESnapError CSnapDecoder::setDecimation(uint32_t decimation)
+{
+	if (!_isHeaderRead)
+	{
+		return SNAP_ERROR_INVALID_STATE;
+	}
+	if (decimation == 0 || _blockSize % decimation != 0)
+	{
+		return SNAP_ERROR_INVALID_PARAMETER;
+	}
+	if (_isRice && decimation != 1)
+	{
+		return SNAP_ERROR_UNSUPPORTED;
+	}
+
+	_decimation = decimation;
+	return SNAP_OK;
+}
+
+ESnapError CSnapDecoder::setBaseLayerOnly(bool isBaseLayerOnly)
+{
+	if (!_isHeaderRead || (isBaseLayerOnly && !_hasIndex))
+	{
+		return SNAP_ERROR_INVALID_STATE;
+	}
+	if (isBaseLayerOnly && _baseBins == _binsToKeep)
+	{
+		return SNAP_ERROR_UNSUPPORTED;
+	}
+
+	_isBaseLayerOnly = isBaseLayerOnly;
+	return SNAP_OK;
+}
+
+void CSnapDecoder::setNoiseFill(bool isNoiseFill)
+{
+	_isNoiseFill = isNoiseFill;
+}
+
+ESnapError CSnapDecoder::seekToSample(uint64_t sample)
+{
+	if (!_fh)
+	{
+		return SNAP_ERROR_INVALID_STATE;
+	}
+
+	if (_hasIndex && sample >= _index.getTotalSamples())
+	{
+		return SNAP_ERROR_OUT_OF_RANGE;
+	}
+
+	uint64_t block = sample / _blockSize;
+	uint64_t offset = _header.getPayloadOffset();
+	uint64_t chunkFirstBlock = 0;
+	size_t chunk = 0;
+
+	if (_hasIndex)
+	{
+		const CSeekIndex::Entry* entry = _index.findEntry(block);
+		if (!entry)
+		{
+			return SNAP_ERROR_OUT_OF_RANGE;
+		}
+		offset = entry->offset;
+		chunkFirstBlock = entry->firstBlock;
+		chunk = entry - _index.getEntries().data();
+	}
+
+	// the seek index only points at the start of a chunk, blocks up to the one we want are skipped without transforming them
+	fseek(_fh, offset, SEEK_SET);
+	if (_decompressor)
+	{
+		_decompressor->reset();
+	}
+	if (_blockReader)
+	{
+		_blockReader->reset();
+	}
+	_blocksToSkip = block - chunkFirstBlock;
+	_samplesToSkip = sample % _blockSize;
+	_nextBlock = block;
+	_fileSource->setEnd(CFileDataSource::noEnd);
+	_chunkBytes = 0;
+	_chunkBlocks = 0;
+	_chunkBlock = 0;
+	_nextChunk = chunk;
+	_isChunkBaseOnly = false;
+	_decoded.clear();
+	_decodedReadPosition = 0;
+
+	return SNAP_OK;
+}
+
+ESnapError CSnapDecoder::pullBlock(const std::complex<int8_t>*& samples, size_t& numSamples)
+{
+	samples = NULL;
+	numSamples = 0;
+
+	if (_decodedReadPosition == _decoded.size())
+	{
+		if (_isRice)
+		{
+			bool isDecoded;
+			ESnapError error = nextRiceBlock(isDecoded);
+			if (error != SNAP_OK || !isDecoded)
+			{
+				return error;
+			}
+		}
+		else
+		{
+			const std::complex<int8_t>* coefficients;
+			uint8_t silenceLevel;
+			ESnapError error = nextCoefficients(coefficients, silenceLevel);
+			if (error != SNAP_OK || !coefficients)
+			{
+				return error;
+			}
+
+			if (silenceLevel != 0)
+			{
+				decodeSilentBlock(silenceLevel);
+			}
+			else
+			{
+				decodeBlock(coefficients);
+			}
+		}
+
+		// the padding at the end of a partial last block is left off, which needs the index to know where the end is
+		const uint64_t blockStart = _nextBlock * _blockSize;
+		_nextBlock++;
+		if (_hasIndex && blockStart + _blockSize > _index.getTotalSamples())
+		{
+			_decoded.resize((_index.getTotalSamples() - blockStart + _decimation - 1) / _decimation);
+		}
+		_decodedReadPosition = std::min<size_t>(_samplesToSkip / _decimation, _decoded.size());
+		_samplesToSkip = 0;
+	}
+
+	samples = _decoded.data() + _decodedReadPosition;
+	numSamples = _decoded.size() - _decodedReadPosition;
+	_decodedReadPosition = _decoded.size();
+
+	return SNAP_OK;
+}
+
+ESnapError CSnapDecoder::pullSamples(std::complex<int8_t>* samples, size_t maxSamples, size_t& numSamples)
+{
+	numSamples = 0;
+
+	while (numSamples < maxSamples)
+	{
+		if (_decodedReadPosition == _decoded.size())
+		{
+			const std::complex<int8_t>* block;
+			size_t blockSamples;
+			ESnapError error = pullBlock(block, blockSamples);
+			if (error != SNAP_OK || blockSamples == 0)
+			{
+				return error;
+			}
+			// pullBlock hands the whole block over, take it back and copy out what fits
+			_decodedReadPosition -= blockSamples;
+		}
+
+		size_t samplesToCopy = std::min(maxSamples - numSamples, _decoded.size() - _decodedReadPosition);
+		memcpy(samples + numSamples, _decoded.data() + _decodedReadPosition, samplesToCopy * sizeof(*samples));
+		_decodedReadPosition += samplesToCopy;
+		numSamples += samplesToCopy;
+	}
+
+	return SNAP_OK;
+}
+
+ESnapError CSnapDecoder::pullCoefficients(const std::complex<int8_t>*& coefficients)
+{
+	if (_isRice)
+	{
+		coefficients = NULL;
+		return SNAP_ERROR_UNSUPPORTED;
+	}
+
+	uint8_t silenceLevel;
+	ESnapError error = nextCoefficients(coefficients, silenceLevel);
+	_samplesToSkip = 0;
+	if (coefficients)
+	{
+		_nextBlock++;
+	}
+	return error;
+}
+
+bool CSnapDecoder::isHeaderRead() const
+{
+	return _isHeaderRead;
+}
+
+bool CSnapDecoder::isFinished() const
+{
+	if (!_isHeaderRead)
+	{
+		return _memorySource.isFinished();
+	}
+	if (_isRice)
+	{
+		return _blockReader && _blockReader->isFinished();
+	}
+	if (_baseBins < _binsToKeep)
+	{
+		if (_chunkBlock != _chunkBlocks)
+		{
+			return false;
+		}
+		if (isReadingBaseLayerOnly())
+		{
+			return _nextChunk >= _index.getEntries().size();
+		}
+		return _decompressor && _decompressor->isFinished() && _decompressor->getNumDecompressedBytesAvailable() - _chunkBytes < 2 * _binsToKeep;
+	}
+	// a silent block is just its level byte
+	return _decompressor && _decompressor->isFinished() && _decompressor->getNumDecompressedBytesAvailable() < (_hasSilence ? 1 : 2 * _binsToKeep);
+}
+
+const CSnapHeader& CSnapDecoder::getHeader() const
+{
+	return _header;
+}
+
+uint32_t CSnapDecoder::getBlockSize() const
+{
+	return _blockSize;
+}
+
+float CSnapDecoder::getQuantisationFactor() const
+{
+	return _quantisationFactor;
+}
+
+const std::vector<float>& CSnapDecoder::getBinQuantisationFactors() const
+{
+	return _binQuantisationFactors;
+}
+
+uint32_t CSnapDecoder::getBinsToKeep() const
+{
+	return _binsToKeep;
+}
+
+uint32_t CSnapDecoder::getBaseBins() const
+{
+	return _baseBins;
+}
+
+uint32_t CSnapDecoder::getMaxError() const
+{
+	return _maxError;
+}
+
+bool CSnapDecoder::isLossless() const
+{
+	return _maxError == 0;
+}
+
+uint32_t CSnapDecoder::getDictionarySize() const
+{
+	return _dictionarySize;
+}
+
+bool CSnapDecoder::hasIndex() const
+{
+	return _hasIndex;
+}
+
+const CSeekIndex& CSnapDecoder::getIndex() const
+{
+	return _index;
+}
+
+size_t CSnapDecoder::getInputByteCount() const
+{
+	if (_isRice)
+	{
+		return _blockReader ? _blockReader->getInputByteCount() : 0;
+	}
+	return _earlierChunksBytesIn + (_decompressor ? _decompressor->getInputByteCount() : 0);
+}
+
+size_t CSnapDecoder::getOutputByteCount() const
+{
+	if (_isRice)
+	{
+		// as if it were 8 bit coefficients out of xz
+		return _blockReader ? _blockReader->getBlocksRead() * 2 * _binsToKeep : 0;
+	}
+	return _earlierChunksBytesOut + (_decompressor ? _decompressor->getOutputByteCount() : 0);
+}
+
+ESnapError CSnapDecoder::parseStreamHeader()
+{
+	size_t headerSize = CSnapHeader::getSize(_memorySource.getData(), _memorySource.getNumBytesAvailable());
+	if (headerSize == 0 || headerSize > _memorySource.getNumBytesAvailable())
+	{
+		// wait for the rest of it
+		return _memorySource.isFinished() ? SNAP_ERROR_INVALID_HEADER : SNAP_OK;
+	}
+
+	ESnapError error = _header.read(_memorySource.getData(), headerSize);
+	if (error != SNAP_OK)
+	{
+		return error;
+	}
+	_memorySource.skip(headerSize);
+
+	error = validateHeader();
+	if (error != SNAP_OK)
+	{
+		return error;
+	}
+
+	_isHeaderRead = true;
+	return SNAP_OK;
+}
+
+ESnapError CSnapDecoder::validateHeader()
+{
+	// written by a newer encoder with a codec feature this decoder would get wrong
+	if (_header.hasUnknownCodecTags())
+	{
+		return SNAP_ERROR_UNSUPPORTED;
+	}
+
+	uint32_t backend = _header.getUint32(CSnapHeader::TAG_BACKEND);
+	uint32_t transform = _header.getUint32(CSnapHeader::TAG_TRANSFORM, CSnapHeader::TRANSFORM_DCT);
+	if (backend == CSnapHeader::BACKEND_XZ && transform == CSnapHeader::TRANSFORM_DCT)
+	{
+		_isRice = false;
+	}
+	else if (backend == CSnapHeader::BACKEND_RICE && transform == CSnapHeader::TRANSFORM_INTEGER_DCT)
+	{
+		_isRice = true;
+	}
+	else
+	{
+		return SNAP_ERROR_UNSUPPORTED;
+	}
+
+	_blockSize = _header.getUint32(CSnapHeader::TAG_BLOCK_SIZE);
+	_quantisationFactor = _header.getFloat(CSnapHeader::TAG_QUANTISATION_FACTOR);
+	_binsToKeep = _header.getUint32(CSnapHeader::TAG_BINS_TO_KEEP);
+
+	if (_blockSize == 0 || !(_quantisationFactor > 0.0f) || _binsToKeep == 0 || _binsToKeep > _blockSize)
+	{
+		return SNAP_ERROR_INVALID_HEADER;
+	}
+	if (_isRice && (!CIntegerDCT::isValidBlockSize(_blockSize) || _blockSize > CSnapEncoder::maxLosslessBlockSize))
+	{
+		return SNAP_ERROR_INVALID_HEADER;
+	}
+
+	// without a residual a file is only exact if nothing was quantised or dropped
+	_integerStep = CSnapEncoder::getIntegerStep(_quantisationFactor);
+	_maxError = _header.getUint32(CSnapHeader::TAG_MAX_ERROR, CSnapEncoder::noMaxError);
+	if (!_isRice)
+	{
+		_maxError = CSnapEncoder::noMaxError;
+	}
+	else if (_maxError == CSnapEncoder::noMaxError && _integerStep == 1 && _binsToKeep == _blockSize)
+	{
+		_maxError = 0;
+	}
+	else if (_maxError != CSnapEncoder::noMaxError && _maxError > 255)
+	{
+		return SNAP_ERROR_INVALID_HEADER;
+	}
+
+	// a layered chunk has to be decompressed whole, so its length is needed
+	_baseBins = _header.getUint32(CSnapHeader::TAG_BASE_BINS, _binsToKeep);
+	_blocksPerChunk = _header.getUint32(CSnapHeader::TAG_BLOCKS_PER_CHUNK);
+	if (_baseBins == 0 || _baseBins > _binsToKeep || (_baseBins < _binsToKeep && (_isRice || _blocksPerChunk == 0)))
+	{
+		return SNAP_ERROR_INVALID_HEADER;
+	}
+	_layered.resize(_binsToKeep);
+
+	_hasSilence = _header.has(CSnapHeader::TAG_SILENCE_THRESHOLD);
+	if (_hasSilence && (_isRice || _baseBins < _binsToKeep))
+	{
+		return SNAP_ERROR_INVALID_HEADER;
+	}
+	_silence.assign(_binsToKeep, {0, 0});
+
+	std::vector<float> table;
+	if (_header.has(CSnapHeader::TAG_QUANTISATION_TABLE))
+	{
+		if (_isRice || !_header.getFloats(CSnapHeader::TAG_QUANTISATION_TABLE, table) || table.empty() || table.size() > _binsToKeep)
+		{
+			return SNAP_ERROR_INVALID_HEADER;
+		}
+		for (float weight : table)
+		{
+			if (!(weight > 0.0f) || !std::isfinite(weight))
+			{
+				return SNAP_ERROR_INVALID_HEADER;
+			}
+		}
+	}
+	CSnapEncoder::getBinQuantisationFactors(_quantisationFactor, table, _binsToKeep, _binQuantisationFactors);
+	_inverseWeights.resize(_binsToKeep);
+	for (uint32_t i = 0; i < _binsToKeep; i++)
+	{
+		_inverseWeights[i] = table.empty() ? 1.0f : 1.0f / table[(uint64_t) i * table.size() / _binsToKeep];
+	}
+
+	return SNAP_OK;
+}
+
+ESnapError CSnapDecoder::nextCoefficients(const std::complex<int8_t>*& coefficients, uint8_t& silenceLevel)
+{
+	coefficients = NULL;
+	silenceLevel = 0;
+
+	if (!_isHeaderRead)
+	{
+		// in streaming mode the header may not have arrived yet
+		return parseStreamHeader();
+	}
+
+	ADataSource* source = _fh ? _fileSource.get() : static_cast<ADataSource*>(&_memorySource);
+	uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+
+	try
+	{
+		if (!_decompressor || _decompressorSource != source)
+		{
+			_decompressor.reset(new CXZDecompress(source, _memoryLimit, _bufferSize));
+			_decompressorSource = source;
+		}
+
+		if (_baseBins < _binsToKeep)
+		{
+			coefficients = nextLayeredCoefficients();
+		}
+		else
+		{
+			uint32_t blockBytes;
+			while (_blocksToSkip != 0)
+			{
+				if (!peekBlock(blockBytes))
+				{
+					return SNAP_OK;
+				}
+				_decompressor->advance(blockBytes);
+				_blocksToSkip--;
+			}
+
+			// coefficients are used straight out of the decompressor's buffer
+			const uint8_t* block = peekBlock(blockBytes);
+			if (block)
+			{
+				if (_hasSilence)
+				{
+					silenceLevel = *block++;
+				}
+				coefficients = silenceLevel != 0 ? _silence.data() : reinterpret_cast<const std::complex<int8_t>*>(block);
+				_decompressor->advance(blockBytes);
+			}
+		}
+
+		if (coefficients)
+		{
+			if (_statistics)
+			{
+				_statistics->addCount(CStatistics::COUNTER_BLOCKS, 1);
+			}
+		}
+		lap(CStatistics::STAGE_XZ, now);
+	}
+	catch (lzma_ret ret)
+	{
+		coefficients = NULL;
+		return getSnapErrorFromLzma(ret);
+	}
+
+	return SNAP_OK;
+}
+
+// the next whole block of a file that isn't layered, NULL until it has all been decompressed. Throws the decompressor's
+// lzma_ret
+const uint8_t* CSnapDecoder::peekBlock(uint32_t& blockBytes)
+{
+	blockBytes = 2 * _binsToKeep;
+	if (_hasSilence)
+	{
+		const uint8_t* silenceLevel = _decompressor->peekBytes(1);
+		if (!silenceLevel)
+		{
+			return NULL;
+		}
+		blockBytes = *silenceLevel != 0 ? 1 : 1 + 2 * _binsToKeep;
+	}
+	return _decompressor->peekBytes(blockBytes);
+}
+
+// throws the decompressor's lzma_ret
+const std::complex<int8_t>* CSnapDecoder::nextLayeredCoefficients()
+{
+	while (_chunkBlock == _chunkBlocks)
+	{
+		if (!loadLayeredChunk())
+		{
+			return NULL;
+		}
+	}
+
+	// a block's base layer is among the chunk's other base layers, its enhancement layer after all of those
+	const uint32_t baseBytes = 2 * _baseBins;
+	const uint32_t enhancementBytes = 2 * (_binsToKeep - _baseBins);
+	uint8_t* destination = reinterpret_cast<uint8_t*>(_layered.data());
+
+	memcpy(destination, _chunk + (size_t) _chunkBlock * baseBytes, baseBytes);
+	if (_isChunkBaseOnly)
+	{
+		memset(destination + baseBytes, 0, enhancementBytes);
+	}
+	else
+	{
+		memcpy(destination + baseBytes, _chunk + (size_t) _chunkBlocks * baseBytes + (size_t) _chunkBlock * enhancementBytes, enhancementBytes);
+	}
+
+	_chunkBlock++;
+	return _layered.data();
+}
+
+// false if the next chunk isn't (yet) available
+bool CSnapDecoder::loadLayeredChunk()
+{
+	const std::vector<CSeekIndex::Entry>& entries = _index.getEntries();
+	const bool isBaseOnly = isReadingBaseLayerOnly();
+
+	// the last chunk stayed in the decompressor's buffer while its blocks were used
+	if (!_isChunkBaseOnly)
+	{
+		_decompressor->advance(_chunkBytes);
+	}
+	_chunkBytes = 0;
+	_chunkBlocks = 0;
+	_chunkBlock = 0;
+
+	uint32_t numBlocks = _blocksPerChunk;
+	if (isBaseOnly || _isChunkBaseOnly)
+	{
+		// the chunk's base layer is read on its own, or after doing that the file has to be put back at a chunk's start
+		if (_nextChunk >= entries.size())
+		{
+			return false;
+		}
+		const CSeekIndex::Entry& entry = entries[_nextChunk];
+		fseek(_fh, entry.offset, SEEK_SET);
+		_fileSource->setEnd(isBaseOnly ? entry.enhancementOffset : CFileDataSource::noEnd);
+
+		_earlierChunksBytesIn += _decompressor->getInputByteCount();
+		_earlierChunksBytesOut += _decompressor->getOutputByteCount();
+		_decompressor->reset();
+		_isChunkBaseOnly = isBaseOnly;
+
+		uint64_t chunkEnd = _nextChunk + 1 < entries.size() ? entries[_nextChunk + 1].firstBlock : _index.getTotalBlocks();
+		numBlocks = chunkEnd - entry.firstBlock;
+	}
+
+	uint32_t blockBytes = 2 * (isBaseOnly ? _baseBins : _binsToKeep);
+	_chunk = _decompressor->peekBytes(numBlocks * blockBytes);
+	if (!_chunk && !isBaseOnly && _decompressor->isFinished())
+	{
+		// only the last chunk can be short, which shows when the data runs out
+		numBlocks = _decompressor->getNumDecompressedBytesAvailable() / blockBytes;
+		_chunk = numBlocks != 0 ? _decompressor->peekBytes(numBlocks * blockBytes) : NULL;
+	}
+	if (!_chunk)
+	{
+		return false;
+	}
+
+	_chunkBytes = numBlocks * blockBytes;
+	_chunkBlocks = numBlocks;
+	_chunkBlock = std::min<uint64_t>(_blocksToSkip, numBlocks);
+	_blocksToSkip -= _chunkBlock;
+	_nextChunk++;
+	return true;
+}
+
+bool CSnapDecoder::isReadingBaseLayerOnly() const
+{
+	return _hasIndex && _baseBins < _binsToKeep && (_isBaseLayerOnly || _blockSize / _decimation <= _baseBins);
+}
+
+ESnapError CSnapDecoder::nextRiceBlock(bool& isDecoded)
+{
+	isDecoded = false;
+
+	if (!_isHeaderRead)
+	{
+		return parseStreamHeader();
+	}
+
+	ADataSource* source = _fh ? _fileSource.get() : static_cast<ADataSource*>(&_memorySource);
+	uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+
+	if (!_blockReader || _decompressorSource != source)
+	{
+		_blockReader.reset(new CRiceBlockReader(source, _bufferSize));
+		_decompressorSource = source;
+	}
+	if (!_integerDct || _integerDct->getBlockSize() != _blockSize)
+	{
+		_integerDct.reset(new CIntegerDCT(_blockSize));
+		_integers.resize(2 * _blockSize);
+		_scratch.resize(_integerDct->getScratchSize());
+	}
+	bool hasResidual = _header.has(CSnapHeader::TAG_MAX_ERROR);
+	_riceValues.resize(2 * _binsToKeep + (hasResidual ? 2 * _blockSize : 0));
+
+	// skipped blocks are only framed, not decoded
+	uint32_t numBytes;
+	while (_blocksToSkip != 0)
+	{
+		if (!_blockReader->peekBlock(numBytes))
+		{
+			return _blockReader->isTruncated() ? SNAP_ERROR_CORRUPT_DATA : SNAP_OK;
+		}
+		_blockReader->advance();
+		_blocksToSkip--;
+	}
+
+	const uint8_t* data = _blockReader->peekBlock(numBytes);
+	if (!data)
+	{
+		return _blockReader->isTruncated() ? SNAP_ERROR_CORRUPT_DATA : SNAP_OK;
+	}
+	ESnapError error = CRiceCoder::decode(data, numBytes, _riceValues.data(), _riceValues.size());
+	_blockReader->advance();
+	now = lap(CStatistics::STAGE_XZ, now);
+	if (error != SNAP_OK)
+	{
+		return error;
+	}
+
+	// the coder has I and Q interleaved, the transform wants them apart
+	int32_t* real = _integers.data();
+	int32_t* imag = _integers.data() + _blockSize;
+	const int32_t step = _integerStep;
+	for (uint32_t i = 0; i < _blockSize; i++)
+	{
+		real[i] = i < _binsToKeep ? _riceValues[2 * i] * step : 0;
+		imag[i] = i < _binsToKeep ? _riceValues[2 * i + 1] * step : 0;
+	}
+
+	_integerDct->inverse(real, _scratch.data());
+	_integerDct->inverse(imag, _scratch.data());
+
+	if (hasResidual)
+	{
+		const int32_t residualStep = 2 * _maxError + 1;
+		const int32_t* residuals = _riceValues.data() + 2 * _binsToKeep;
+		for (uint32_t i = 0; i < _blockSize; i++)
+		{
+			real[i] += residuals[2 * i] * residualStep;
+			imag[i] += residuals[2 * i + 1] * residualStep;
+		}
+	}
+	now = lap(CStatistics::STAGE_IDCT, now);
+
+	// a corrupt block can take the samples out of range, they're clipped rather than wrapped
+	_decoded.resize(_blockSize);
+	for (uint32_t i = 0; i < _blockSize; i++)
+	{
+		_decoded[i] = std::complex<int8_t>(std::max(-128, std::min(127, real[i])), std::max(-128, std::min(127, imag[i])));
+	}
+	lap(CStatistics::STAGE_NARROW, now);
+
+	if (_statistics)
+	{
+		_statistics->addCount(CStatistics::COUNTER_BLOCKS, 1);
+	}
+	isDecoded = true;
+	return SNAP_OK;
+}
+
+void CSnapDecoder::decodeBlock(const std::complex<int8_t>* coefficients)
+{
+	// a decimated block is the IDCT of its low bins, DCT size N->N/d rescales the (orthonormal) basis by sqrt(1/d).
+	// Dropping the bins above the new nyquist rate is the anti-aliasing filter
+	const uint32_t outputBlockSize = _blockSize / _decimation;
+	const uint32_t binsToTransform = std::min(_binsToKeep, outputBlockSize);
+	const float iQuantisationFactor = 1.0f / (_quantisationFactor * sqrtf(_decimation));
+
+	if (!_dct || _outputBlockSize != outputBlockSize)
+	{
+		_dct.reset(new CDiscreteCosineTransform(outputBlockSize, _dctStrategy));
+		_outputBlockSize = outputBlockSize;
+	}
+
+	uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+
+	// bins above binsToKeep stay zero
+	_floats.assign(outputBlockSize, {0.0f, 0.0f});
+	for (uint32_t i = 0; i < binsToTransform; i++)
+	{
+		_floats[i] = std::complex<float>(coefficients[i].real(), coefficients[i].imag());
+		_floats[i] *= iQuantisationFactor * _inverseWeights[i];
+	}
+	now = lap(CStatistics::STAGE_DEQUANTISE, now);
+
+	_dct->optIDCT(_floats, _inverseTransformed);
+	now = lap(CStatistics::STAGE_IDCT, now);
+
+	_decoded.resize(outputBlockSize);
+	for (uint32_t i = 0; i < outputBlockSize; i++)
+	{
+		_decoded[i] = std::complex<int8_t>(roundf(_inverseTransformed[i].real()), roundf(_inverseTransformed[i].imag()));
+	}
+	lap(CStatistics::STAGE_NARROW, now);
+}
+
+void CSnapDecoder::decodeSilentBlock(uint8_t silenceLevel)
+{
+	const uint32_t outputBlockSize = _blockSize / _decimation;
+	_decoded.assign(outputBlockSize, {0, 0});
+	if (!_isNoiseFill)
+	{
+		return;
+	}
+
+	uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+
+	// white noise keeps 1/decimation of its power through the decimating filter. Box-Muller gives both components at once
+	const float rms = CSnapEncoder::getSilenceRms(silenceLevel) / sqrtf(_decimation);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	for (uint32_t i = 0; i < outputBlockSize; i++)
+	{
+		float radius = rms * sqrtf(-2.0f * logf(1.0f - uniform(_random)));
+		float angle = 2.0f * M_PI * uniform(_random);
+		float real = std::max(-128.0f, std::min(127.0f, roundf(radius * cosf(angle))));
+		float imag = std::max(-128.0f, std::min(127.0f, roundf(radius * sinf(angle))));
+		_decoded[i] = std::complex<int8_t>(real, imag);
+	}
+	lap(CStatistics::STAGE_IDCT, now);
+}
+
+uint64_t CSnapDecoder::lap(CStatistics::EStage stage, uint64_t start)
+{
+	return _statistics ? _statistics->lap(stage, start) : 0;
+}
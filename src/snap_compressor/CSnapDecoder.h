@@ -0,0 +1,184 @@
+#ifndef SRC_SNAP_COMPRESSOR_CSNAPDECODER_H_
+#define SRC_SNAP_COMPRESSOR_CSNAPDECODER_H_
+
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include "CMemoryDataSource.h"
+#include "CMemoryPlanner.h"
+#include "CSeekIndex.h"
+#include "CSnapHeader.h"
+#include "CStatistics.h"
+#include "SnapError.h"
+
+class ADataSource;
+class CFileDataSource;
+class CIntegerDCT;
+class CRiceBlockReader;
+class CXZDecompress;
+
+// Decodes .roundedQuantisedDCT data back to 8 bit IQ samples, either from a file (which allows seeking with the index)
+// or from bytes pushed in as they arrive, e.g. off a socket. Decoded samples are pulled out a block at a time.
+class CSnapDecoder
+{
+public:
+	CSnapDecoder();
+	virtual ~CSnapDecoder();
+
+	// random access mode, reads the header and the seek index, which only version 1 and 2 files can be without (for later
+	// ones a missing or damaged index is SNAP_ERROR_CORRUPT_DATA, as the file was most likely cut short). fh must stay open while decoding
+	ESnapError open(FILE* fh);
+
+	// streaming mode, call endOfInput() after the last bytes. The header is parsed as soon as enough has arrived
+	ESnapError pushBytes(const uint8_t* data, size_t numBytes);
+	void endOfInput();
+
+	// the xz memory limit, DCT strategy and buffer size to use, see CMemoryPlanner. Call before the first pull
+	void setMemoryPlan(const CMemoryPlanner::Plan& plan);
+
+	// times the decoding stages and counts blocks into statistics (which must outlive the decoder), NULL to stop
+	void setStatistics(CStatistics* statistics);
+
+	// forgets the current stream, buffers are kept for the next one
+	void reset();
+
+	// reconstruct at 1/decimation of the sample rate from the low DCT bins, decimation must divide the block size.
+	// Rice backend (lossless and near lossless) files can only be decoded at their own rate
+	ESnapError setDecimation(uint32_t decimation);
+
+	// layered files (see CSnapEncoder::setBaseBins()) can be decoded from the base layer alone, the bins above it being zero,
+	// without reading or decompressing the enhancement layers. It needs the seek index, so random access mode only. Done
+	// anyway when the decimation leaves no bins above the base layer. Call before the first pull
+	ESnapError setBaseLayerOnly(bool isBaseLayerOnly);
+
+	// silent blocks (see CSnapEncoder::setSilenceThreshold()) decode as zeros, or with this as gaussian noise of their RMS
+	void setNoiseFill(bool isNoiseFill);
+
+	// random access mode only, sample is at the full sample rate. Without an index it decodes from the start, with one a
+	// sample past the end is SNAP_ERROR_OUT_OF_RANGE
+	ESnapError seekToSample(uint64_t sample);
+
+	// a view of the next decoded samples, valid until the next pull. numSamples is 0 at the end of the stream or,
+	// in streaming mode, when more input is needed (see isFinished()). Input which ends part way through a chunk gives SNAP_ERROR_CORRUPT_DATA.
+	// The zeros padding a partial last block are left off in random access mode, in streaming mode the index saying how
+	// many samples there are comes last, so they are decoded too
+	ESnapError pullBlock(const std::complex<int8_t>*& samples, size_t& numSamples);
+	ESnapError pullSamples(std::complex<int8_t>* samples, size_t maxSamples, size_t& numSamples);
+
+	// the next block's quantised DCT coefficients (getBinsToKeep() of them) without the inverse transform, NULL as for pullBlock.
+	// Silent blocks give all zero coefficients. Bin i is divided by getBinQuantisationFactors()[i] to dequantise it. Not for
+	// Rice backend files, their coefficients don't fit in 8 bits
+	ESnapError pullCoefficients(const std::complex<int8_t>*& coefficients);
+
+	bool isHeaderRead() const;
+	bool isFinished() const;
+	const CSnapHeader& getHeader() const;
+	uint32_t getBlockSize() const;
+	float getQuantisationFactor() const;
+	// getQuantisationFactor() for every kept bin unless the file has a quantisation table, see CSnapEncoder::setQuantisationTable()
+	const std::vector<float>& getBinQuantisationFactors() const;
+	uint32_t getBinsToKeep() const;
+	// getBinsToKeep() unless the file is layered
+	uint32_t getBaseBins() const;
+	// the most any sample can be off from what was encoded (rounded to 8 bits), CSnapEncoder::noMaxError for xz files
+	uint32_t getMaxError() const;
+	bool isLossless() const;
+	// the xz dictionary the first chunk was compressed with, what decoding needs memory for (see CMemoryPlanner::planDecoder()).
+	// Random access mode only, 0 if it isn't known
+	uint32_t getDictionarySize() const;
+
+	// the seek index is only available in random access mode
+	bool hasIndex() const;
+	const CSeekIndex& getIndex() const;
+
+	size_t getInputByteCount() const;
+	size_t getOutputByteCount() const;
+
+private:
+	ESnapError parseStreamHeader();
+	ESnapError validateHeader();
+	ESnapError nextCoefficients(const std::complex<int8_t>*& coefficients, uint8_t& silenceLevel);
+	const uint8_t* peekBlock(uint32_t& blockBytes);
+	const std::complex<int8_t>* nextLayeredCoefficients();
+	bool loadLayeredChunk();
+	bool isReadingBaseLayerOnly() const;
+	ESnapError nextRiceBlock(bool& isDecoded);
+	void decodeBlock(const std::complex<int8_t>* coefficients);
+	void decodeSilentBlock(uint8_t silenceLevel);
+	uint64_t lap(CStatistics::EStage stage, uint64_t start);
+
+	FILE* _fh;
+	std::unique_ptr<CFileDataSource> _fileSource;
+	CMemoryDataSource _memorySource;
+	std::unique_ptr<CXZDecompress> _decompressor;
+	std::unique_ptr<CRiceBlockReader> _blockReader;
+	ADataSource* _decompressorSource;
+	std::unique_ptr<CDiscreteCosineTransform> _dct;
+	std::unique_ptr<CIntegerDCT> _integerDct;
+	CStatistics* _statistics;
+
+	uint64_t _memoryLimit;
+	uint32_t _bufferSize;
+	CDiscreteCosineTransform::EStrategy _dctStrategy;
+
+	CSnapHeader _header;
+	CSeekIndex _index;
+	bool _isHeaderRead;
+	bool _hasIndex;
+
+	uint32_t _blockSize;
+	float _quantisationFactor;
+	uint32_t _binsToKeep;
+	uint32_t _baseBins;
+	uint32_t _blocksPerChunk;
+	bool _isBaseLayerOnly;
+	bool _isRice;
+	uint32_t _integerStep;
+	uint32_t _maxError;
+	bool _hasSilence;
+	bool _isNoiseFill;
+	uint32_t _decimation;
+	uint32_t _outputBlockSize;
+	uint32_t _dictionarySize;
+
+	// per bin quantisation factors, and the inverse of the table's weight for each bin (all 1 without a table)
+	std::vector<float> _binQuantisationFactors;
+	std::vector<float> _inverseWeights;
+
+	// after a seek, whole blocks to throw away from the start of the chunk and samples from the first decoded block, and
+	// the number of the block the next pull gives (to find the last one)
+	uint64_t _blocksToSkip;
+	uint32_t _samplesToSkip;
+	uint64_t _nextBlock;
+
+	// layered files: the decompressed chunk being decoded (both layers, or only the base one, which is read a chunk at a time
+	// through the index), how many blocks it has, the next one, and the chunk after it. The blocks are put back together
+	// in _layered
+	const uint8_t* _chunk;
+	uint32_t _chunkBytes;
+	uint32_t _chunkBlocks;
+	uint32_t _chunkBlock;
+	size_t _nextChunk;
+	bool _isChunkBaseOnly;
+	uint64_t _earlierChunksBytesIn;
+	uint64_t _earlierChunksBytesOut;
+	std::vector<std::complex<int8_t>> _layered;
+
+	// the coefficients of a silent block, and where its noise comes from
+	std::vector<std::complex<int8_t>> _silence;
+	std::mt19937 _random;
+
+	std::vector<std::complex<float>> _floats;
+	std::vector<std::complex<float>> _inverseTransformed;
+	std::vector<std::complex<int8_t>> _decoded;
+	std::vector<int32_t> _riceValues;
+	std::vector<int32_t> _integers;
+	std::vector<int32_t> _scratch;
+	size_t _decodedReadPosition;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CSNAPDECODER_H_ */
@@ -0,0 +1,850 @@
+#include "CSnapEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "CCrc32c.h"
+#include "CDiscreteCosineTransform.h"
+#include "CIntegerDCT.h"
+#include "CRiceCoder.h"
+#include "CXZCompress.h"
+
+namespace
+{
+// value / step to the nearest whole number, halves away from zero
+int32_t divideRounded(int32_t value, int32_t step)
+{
+	return value >= 0 ? (value + step / 2) / step : -((step / 2 - value) / step);
+}
+}
+
+CSnapEncoder::CSnapEncoder() :
+		_isSharedDct(false),
+		_statistics(NULL),
+		_isStarted(false),
+		_dictionarySize(0),
+		_chunkDictionarySize(0),
+		_xzBufferSize(512 * 1024),
+		_dctStrategy(CDiscreteCosineTransform::STRATEGY_TABLE),
+		_blockSize(0),
+		_quantisationFactor(0.0f),
+		_binsToKeep(0),
+		_blocksPerChunk(0),
+		_isRice(false),
+		_isLosslessNext(false),
+		_maxError(noMaxError),
+		_maxErrorNext(noMaxError),
+		_integerStep(1),
+		_baseBins(0),
+		_baseBinsNext(0),
+		_silenceThreshold(0.0f),
+		_silenceThresholdNext(0.0f),
+		_numPendingSamples(0),
+		_chunkChecksum(0),
+		_codedBytesIn(0),
+		_codedBytesOut(0),
+		_outputReadPosition(0),
+		_bytesProduced(0),
+		_blocksEncoded(0),
+		_samplesEncoded(0),
+		_chunkFirstBlock(0),
+		_chunkOffset(0),
+		_overflowCount(0),
+		_suggestedQuantisationFactor(0.0f)
+{
+}
+
+CSnapEncoder::~CSnapEncoder()
+{
+}
+
+ESnapError CSnapEncoder::start(uint32_t blockSize, float quantisationFactor, uint32_t binsToKeep, uint32_t blocksPerChunk, const CSnapHeader& metadata)
+{
+	if (_isStarted)
+	{
+		return SNAP_ERROR_INVALID_STATE;
+	}
+	bool isRice = _isLosslessNext || _maxErrorNext != noMaxError;
+	if (isRice && (!CIntegerDCT::isValidBlockSize(blockSize) || blockSize > maxLosslessBlockSize))
+	{
+		return SNAP_ERROR_INVALID_PARAMETER;
+	}
+	// 8 bit samples can't be further apart than 255
+	if (_maxErrorNext != noMaxError && _maxErrorNext > 255)
+	{
+		return SNAP_ERROR_INVALID_PARAMETER;
+	}
+	if (_isLosslessNext)
+	{
+		// nothing is quantised or dropped
+		quantisationFactor = 1.0f;
+		binsToKeep = blockSize;
+	}
+	if (blockSize == 0 || binsToKeep == 0 || binsToKeep > blockSize || blocksPerChunk == 0 || !(quantisationFactor > 0.0f))
+	{
+		return SNAP_ERROR_INVALID_PARAMETER;
+	}
+	if (_baseBinsNext != 0 && (isRice || _baseBinsNext >= binsToKeep))
+	{
+		return SNAP_ERROR_INVALID_PARAMETER;
+	}
+	if (!_quantisationTableNext.empty() && (isRice || _quantisationTableNext.size() > std::min(binsToKeep, maxQuantisationTableSize)))
+	{
+		return SNAP_ERROR_INVALID_PARAMETER;
+	}
+	for (float weight : _quantisationTableNext)
+	{
+		if (!(weight > 0.0f) || !std::isfinite(weight))
+		{
+			return SNAP_ERROR_INVALID_PARAMETER;
+		}
+	}
+	if (_silenceThresholdNext != 0.0f && (isRice || _baseBinsNext != 0 || !(_silenceThresholdNext > 0.0f && _silenceThresholdNext <= maxSilenceThreshold)))
+	{
+		return SNAP_ERROR_INVALID_PARAMETER;
+	}
+
+	// xz's memory is only allocated once there is something to compress, an encoder which is only given chunks needs none.
+	// Without a plan the dictionary is still only as big as a chunk
+	uint32_t dictionarySize = _dictionarySize != 0 ? _dictionarySize : CMemoryPlanner::getDictionarySize((uint64_t) blocksPerChunk * 2 * binsToKeep);
+	if (_compressor && _compressor->getDictionarySize() != dictionarySize)
+	{
+		_compressor.reset();
+	}
+	_chunkDictionarySize = dictionarySize;
+	try
+	{
+		if (_compressor)
+		{
+			_compressor->startNewStream();
+		}
+	}
+	catch (lzma_ret ret)
+	{
+		_compressor.reset();
+		return getSnapErrorFromLzma(ret);
+	}
+
+	uint32_t maxError = _isLosslessNext ? noMaxError : _maxErrorNext;
+	if (isRice)
+	{
+		if (!_integerDct || _integerDct->getBlockSize() != blockSize)
+		{
+			_integerDct.reset(new CIntegerDCT(blockSize));
+		}
+		_integers.resize(2 * blockSize);
+		_rounded.resize(maxError != noMaxError ? 2 * blockSize : 0);
+		_interleaved.resize(2 * binsToKeep + _rounded.size());
+		_scratch.resize(_integerDct->getScratchSize());
+
+		// stored as what the step really is
+		_integerStep = getIntegerStep(quantisationFactor);
+		quantisationFactor = 1.0f / _integerStep;
+	}
+	else
+	{
+		// the lookup tables are the expensive part, keep them if the block size hasn't changed
+		if (_isSharedDct && _dct->getBlockSize() != blockSize)
+		{
+			return SNAP_ERROR_INVALID_PARAMETER;
+		}
+		if (!_dct || _dct->getBlockSize() != blockSize)
+		{
+			_dct.reset(new CDiscreteCosineTransform(blockSize, _dctStrategy));
+		}
+	}
+
+	_blockSize = blockSize;
+	_quantisationFactor = quantisationFactor;
+	_binsToKeep = binsToKeep;
+	_blocksPerChunk = blocksPerChunk;
+	_isRice = isRice;
+	_maxError = maxError;
+	_baseBins = _baseBinsNext != 0 ? _baseBinsNext : binsToKeep;
+	_silenceThreshold = _silenceThresholdNext;
+	getBinQuantisationFactors(quantisationFactor, _quantisationTableNext, binsToKeep, _binQuantisationFactors);
+	_enhancement.clear();
+
+	_numPendingSamples = 0;
+	_floats.resize(blockSize);
+	_quantised.resize(blockSize);
+
+	_output.clear();
+	_outputReadPosition = 0;
+	_bytesProduced = 0;
+	_index = CSeekIndex();
+	_index.setLayered(_baseBins < binsToKeep);
+
+	_blocksEncoded = 0;
+	_samplesEncoded = 0;
+	_overflowCount = 0;
+	_suggestedQuantisationFactor = quantisationFactor;
+	_chunkChecksum = 0;
+	_codedBytesIn = 0;
+	_codedBytesOut = 0;
+
+	CSnapHeader header = metadata;
+	header.setUint32(CSnapHeader::TAG_BACKEND, _isRice ? CSnapHeader::BACKEND_RICE : CSnapHeader::BACKEND_XZ);
+	if (_isRice)
+	{
+		header.setUint32(CSnapHeader::TAG_TRANSFORM, CSnapHeader::TRANSFORM_INTEGER_DCT);
+	}
+	if (_maxError != noMaxError)
+	{
+		header.setUint32(CSnapHeader::TAG_MAX_ERROR, _maxError);
+	}
+	if (_baseBins < binsToKeep)
+	{
+		header.setUint32(CSnapHeader::TAG_BASE_BINS, _baseBins);
+	}
+	if (_silenceThreshold != 0.0f)
+	{
+		header.setFloat(CSnapHeader::TAG_SILENCE_THRESHOLD, _silenceThreshold);
+	}
+	if (!_quantisationTableNext.empty())
+	{
+		header.setFloats(CSnapHeader::TAG_QUANTISATION_TABLE, _quantisationTableNext);
+	}
+	header.setUint32(CSnapHeader::TAG_BLOCK_SIZE, blockSize);
+	header.setFloat(CSnapHeader::TAG_QUANTISATION_FACTOR, quantisationFactor);
+	header.setUint32(CSnapHeader::TAG_BINS_TO_KEEP, binsToKeep);
+	header.setUint32(CSnapHeader::TAG_BLOCKS_PER_CHUNK, blocksPerChunk);
+
+	std::vector<uint8_t> headerBytes;
+	header.write(headerBytes);
+	appendOutput(headerBytes);
+
+	_chunkFirstBlock = 0;
+	_chunkOffset = _bytesProduced;
+
+	_isStarted = true;
+	return SNAP_OK;
+}
+
+void CSnapEncoder::setMemoryPlan(const CMemoryPlanner::Plan& plan)
+{
+	_dictionarySize = plan.dictionarySize;
+	_xzBufferSize = plan.xzBufferSize;
+	_dctStrategy = plan.dctStrategy;
+
+	// rebuilt with the new settings by the next start()
+	if (!_isStarted)
+	{
+		_compressor.reset();
+		if (!_isSharedDct)
+		{
+			_dct.reset();
+		}
+	}
+}
+
+void CSnapEncoder::setLossless(bool isLossless)
+{
+	_isLosslessNext = isLossless;
+}
+
+bool CSnapEncoder::isLossless() const
+{
+	return _isRice && _maxError == noMaxError;
+}
+
+void CSnapEncoder::setMaxError(uint32_t maxError)
+{
+	_maxErrorNext = maxError;
+}
+
+uint32_t CSnapEncoder::getMaxError() const
+{
+	return _maxError;
+}
+
+void CSnapEncoder::setBaseBins(uint32_t baseBins)
+{
+	_baseBinsNext = baseBins;
+}
+
+void CSnapEncoder::setSilenceThreshold(float threshold)
+{
+	_silenceThresholdNext = threshold;
+}
+
+uint8_t CSnapEncoder::getSilenceLevel(float rms)
+{
+	return 1 + std::min(254.0f, roundf(rms * 8.0f));
+}
+
+float CSnapEncoder::getSilenceRms(uint8_t level)
+{
+	return (level - 1) / 8.0f;
+}
+
+void CSnapEncoder::setQuantisationTable(const std::vector<float>& weights)
+{
+	_quantisationTableNext = weights;
+}
+
+void CSnapEncoder::getBinQuantisationFactors(float quantisationFactor, const std::vector<float>& weights, uint32_t binsToKeep, std::vector<float>& factors)
+{
+	factors.resize(binsToKeep);
+	for (uint32_t i = 0; i < binsToKeep; i++)
+	{
+		factors[i] = weights.empty() ? quantisationFactor : quantisationFactor * weights[(uint64_t) i * weights.size() / binsToKeep];
+	}
+}
+
+void CSnapEncoder::setTransform(const std::shared_ptr<const CDiscreteCosineTransform>& dct)
+{
+	_dct = dct;
+	_isSharedDct = dct != NULL;
+}
+
+void CSnapEncoder::setStatistics(CStatistics* statistics)
+{
+	_statistics = statistics;
+}
+
+ESnapError CSnapEncoder::pushSamples(const std::complex<int8_t>* samples, size_t numSamples)
+{
+	return pushSamples(samples, numSamples, CSampleFormat::FORMAT_INT8, 1.0f);
+}
+
+ESnapError CSnapEncoder::pushSamples(const std::complex<float>* samples, size_t numSamples)
+{
+	return pushSamples(samples, numSamples, CSampleFormat::FORMAT_FLOAT32, 1.0f);
+}
+
+ESnapError CSnapEncoder::pushSamples(const void* samples, size_t numSamples, CSampleFormat::EFormat format, float scale)
+{
+	// not after a chunk ending with a partial block
+	if (!_isStarted || _samplesEncoded != _blocksEncoded * _blockSize + _numPendingSamples)
+	{
+		return SNAP_ERROR_INVALID_STATE;
+	}
+
+	const uint32_t bytesPerSample = CSampleFormat::getBytesPerSample(format);
+	if (bytesPerSample == 0)
+	{
+		return SNAP_ERROR_INVALID_PARAMETER;
+	}
+
+	try
+	{
+		// converted straight into the transform's input, a block is encoded as soon as it is full
+		const uint8_t* data = static_cast<const uint8_t*>(samples);
+		while (numSamples != 0)
+		{
+			size_t samplesToCopy = std::min<size_t>(numSamples, _blockSize - _numPendingSamples);
+
+			uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+			CSampleFormat::toFloat(data, samplesToCopy, format, scale, _floats.data() + _numPendingSamples);
+			lap(CStatistics::STAGE_WIDEN, now);
+
+			_numPendingSamples += samplesToCopy;
+			_samplesEncoded += samplesToCopy;
+			data += samplesToCopy * bytesPerSample;
+			numSamples -= samplesToCopy;
+
+			if (_numPendingSamples == _blockSize)
+			{
+				encodeBlock();
+				_numPendingSamples = 0;
+			}
+		}
+	}
+	catch (lzma_ret ret)
+	{
+		_isStarted = false;
+		return getSnapErrorFromLzma(ret);
+	}
+
+	return SNAP_OK;
+}
+
+ESnapError CSnapEncoder::finish()
+{
+	if (!_isStarted)
+	{
+		return SNAP_ERROR_INVALID_STATE;
+	}
+	_isStarted = false;
+
+	try
+	{
+		if (_numPendingSamples != 0)
+		{
+			std::fill(_floats.begin() + _numPendingSamples, _floats.end(), std::complex<float>());
+			encodeBlock();
+			_numPendingSamples = 0;
+		}
+
+		if (_blocksEncoded == 0 || _blocksEncoded != _chunkFirstBlock)
+		{
+			uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+			finishChunk();
+			lap(CStatistics::STAGE_XZ, now);
+		}
+	}
+	catch (lzma_ret ret)
+	{
+		return getSnapErrorFromLzma(ret);
+	}
+
+	_index.setTotalBlocks(_blocksEncoded);
+	_index.setTotalSamples(_samplesEncoded);
+
+	std::vector<uint8_t> indexBytes;
+	_index.write(indexBytes, _bytesProduced);
+	appendOutput(indexBytes);
+
+	return SNAP_OK;
+}
+
+ESnapError CSnapEncoder::encodeChunk(const std::complex<int8_t>* samples, uint64_t numSamples, Chunk& chunk)
+{
+	// the compressor must be at the start of a stream
+	if (!_isStarted || _blocksEncoded != _chunkFirstBlock || _numPendingSamples != 0)
+	{
+		return SNAP_ERROR_INVALID_STATE;
+	}
+	if (numSamples == 0 || numSamples > (uint64_t) _blocksPerChunk * _blockSize)
+	{
+		return SNAP_ERROR_INVALID_PARAMETER;
+	}
+	const uint32_t numBlocks = (numSamples + _blockSize - 1) / _blockSize;
+
+	chunk.bytes.clear();
+	chunk.numBlocks = numBlocks;
+	chunk.numSamples = numSamples;
+	chunk.enhancementOffset = 0;
+	chunk.overflowCount = 0;
+	chunk.suggestedQuantisationFactor = _quantisationFactor;
+
+	if (_isRice)
+	{
+		for (uint32_t block = 0; block < numBlocks; block++)
+		{
+			loadBlock(samples + (size_t) block * _blockSize, std::min<uint64_t>(_blockSize, numSamples - (uint64_t) block * _blockSize));
+			encodeRiceBlock(_floats.data(), chunk.bytes);
+		}
+		chunk.checksum = CCrc32c::calculate(chunk.bytes.data(), chunk.bytes.size());
+		return SNAP_OK;
+	}
+
+	try
+	{
+		createCompressor();
+
+		for (uint32_t block = 0; block < numBlocks; block++)
+		{
+			loadBlock(samples + (size_t) block * _blockSize, std::min<uint64_t>(_blockSize, numSamples - (uint64_t) block * _blockSize));
+			compressBlock(chunk.bytes, chunk.overflowCount, chunk.suggestedQuantisationFactor);
+		}
+
+		uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+		bool done = false;
+		while (!done)
+		{
+			done = _compressor->finish();
+			_compressor->writeAndEmptyBuffer(chunk.bytes);
+		}
+		chunk.checksum = _compressor->getStreamChecksum();
+		if (_baseBins < _binsToKeep)
+		{
+			chunk.enhancementOffset = chunk.bytes.size();
+			compressEnhancementLayer(chunk.bytes, chunk.checksum);
+		}
+		_compressor->startNewStream();
+		lap(CStatistics::STAGE_XZ, now);
+	}
+	catch (lzma_ret ret)
+	{
+		_isStarted = false;
+		return getSnapErrorFromLzma(ret);
+	}
+
+	return SNAP_OK;
+}
+
+ESnapError CSnapEncoder::pushChunk(const Chunk& chunk)
+{
+	// nothing can follow a partial block
+	if (!_isStarted || _blocksEncoded != _chunkFirstBlock || _numPendingSamples != 0 || _samplesEncoded != _blocksEncoded * _blockSize)
+	{
+		return SNAP_ERROR_INVALID_STATE;
+	}
+	if (chunk.numBlocks == 0 || chunk.numBlocks > _blocksPerChunk || chunk.numSamples > (uint64_t) chunk.numBlocks * _blockSize
+			|| chunk.numSamples <= (uint64_t) (chunk.numBlocks - 1) * _blockSize)
+	{
+		return SNAP_ERROR_INVALID_PARAMETER;
+	}
+
+	appendOutput(chunk.bytes);
+	_index.addEntry(_chunkFirstBlock, _chunkOffset, chunk.checksum, chunk.enhancementOffset != 0 ? _chunkOffset + chunk.enhancementOffset : 0);
+
+	_blocksEncoded += chunk.numBlocks;
+	_samplesEncoded += chunk.numSamples;
+	_chunkFirstBlock = _blocksEncoded;
+	_chunkOffset = _bytesProduced;
+
+	_overflowCount += chunk.overflowCount;
+	_suggestedQuantisationFactor = std::min(_suggestedQuantisationFactor, chunk.suggestedQuantisationFactor);
+
+	return SNAP_OK;
+}
+
+const uint8_t* CSnapEncoder::getOutput(size_t& numBytes) const
+{
+	numBytes = _output.size() - _outputReadPosition;
+	return _output.data() + _outputReadPosition;
+}
+
+void CSnapEncoder::consumeOutput(size_t numBytes)
+{
+	_outputReadPosition += std::min(numBytes, _output.size() - _outputReadPosition);
+
+	if (_outputReadPosition == _output.size())
+	{
+		// keeps its capacity
+		_output.clear();
+		_outputReadPosition = 0;
+	}
+}
+
+size_t CSnapEncoder::pullBytes(uint8_t* data, size_t maxBytes)
+{
+	size_t numBytes;
+	const uint8_t* output = getOutput(numBytes);
+
+	numBytes = std::min(numBytes, maxBytes);
+	memcpy(data, output, numBytes);
+	consumeOutput(numBytes);
+
+	return numBytes;
+}
+
+uint64_t CSnapEncoder::getBlocksEncoded() const
+{
+	return _blocksEncoded;
+}
+
+uint64_t CSnapEncoder::getBytesProduced() const
+{
+	return _bytesProduced;
+}
+
+float CSnapEncoder::getXzRatio() const
+{
+	if (_isRice)
+	{
+		return _codedBytesIn != 0 ? _codedBytesOut / (float) _codedBytesIn : 0.0f;
+	}
+	return _compressor ? _compressor->getRatio() : 0.0f;
+}
+
+uint64_t CSnapEncoder::getOverflowCount() const
+{
+	return _overflowCount;
+}
+
+float CSnapEncoder::getSuggestedQuantisationFactor() const
+{
+	return _suggestedQuantisationFactor;
+}
+
+// widens the samples of a block into _floats, a partial block is padded with zeros
+void CSnapEncoder::loadBlock(const std::complex<int8_t>* samples, uint32_t numSamples)
+{
+	uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+	CSampleFormat::toFloat(samples, numSamples, CSampleFormat::FORMAT_INT8, 1.0f, _floats.data());
+	std::fill(_floats.begin() + numSamples, _floats.end(), std::complex<float>());
+	lap(CStatistics::STAGE_WIDEN, now);
+}
+
+void CSnapEncoder::encodeBlock()
+{
+	if (_isRice)
+	{
+		_coded.clear();
+		encodeRiceBlock(_floats.data(), _coded);
+
+		uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+		_chunkChecksum = CCrc32c::calculate(_coded.data(), _coded.size(), _chunkChecksum);
+		appendOutput(_coded);
+
+		_blocksEncoded++;
+		if (_blocksEncoded - _chunkFirstBlock == _blocksPerChunk)
+		{
+			finishChunk();
+		}
+		lap(CStatistics::STAGE_XZ, now);
+		return;
+	}
+
+	createCompressor();
+
+	std::vector<uint8_t> compressed;
+	compressBlock(compressed, _overflowCount, _suggestedQuantisationFactor);
+
+	uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+	appendOutput(compressed);
+
+	_blocksEncoded++;
+	if (_blocksEncoded - _chunkFirstBlock == _blocksPerChunk)
+	{
+		finishChunk();
+	}
+	lap(CStatistics::STAGE_XZ, now);
+}
+
+// the block in _floats through the silence test or the DCT and quantisation into the current xz stream, what xz gives
+// back so far is appended to destination. Overflows are added to the counts passed in
+void CSnapEncoder::compressBlock(std::vector<uint8_t>& destination, uint64_t& overflowCount, float& suggestedQuantisationFactor)
+{
+	uint8_t silenceLevel = detectSilence();
+	if (silenceLevel == 0)
+	{
+		float largestMagnitude = 0.0f;
+		uint32_t overflows = transformBlock(largestMagnitude);
+		if (overflows != 0)
+		{
+			overflowCount += overflows;
+			suggestedQuantisationFactor = std::min(suggestedQuantisationFactor, _quantisationFactor * 127.0f / largestMagnitude);
+		}
+	}
+
+	uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+	if (_silenceThreshold != 0.0f)
+	{
+		_compressor->addBytes(&silenceLevel, 1);
+	}
+	if (silenceLevel == 0)
+	{
+		const uint8_t* quantised = reinterpret_cast<uint8_t*>(_quantised.data());
+		_compressor->addBytes(quantised, 2 * _baseBins);
+		_enhancement.insert(_enhancement.end(), quantised + 2 * _baseBins, quantised + 2 * _binsToKeep);
+	}
+	_compressor->writeAndEmptyBuffer(destination);
+	lap(CStatistics::STAGE_XZ, now);
+}
+
+uint32_t CSnapEncoder::transformBlock(float& largestMagnitude)
+{
+	uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+
+	_dct->optDCT(_floats, _transformed);
+	now = lap(CStatistics::STAGE_DCT, now);
+
+	uint32_t overflows = quantise(_transformed.data(), _binsToKeep, _binQuantisationFactors.data(), _quantised.data(), largestMagnitude);
+	lap(CStatistics::STAGE_QUANTISE, now);
+
+	if (_statistics)
+	{
+		_statistics->addCount(CStatistics::COUNTER_BLOCKS, 1);
+		_statistics->addCount(CStatistics::COUNTER_OVERFLOWS, overflows);
+	}
+
+	return overflows;
+}
+
+// 0 unless the block in _floats is below the silence threshold, one pass over it instead of the DCT (whose time it counts as)
+uint8_t CSnapEncoder::detectSilence()
+{
+	if (_silenceThreshold == 0.0f)
+	{
+		return 0;
+	}
+	uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+
+	float energy = 0.0f;
+	for (uint32_t i = 0; i < _blockSize; i++)
+	{
+		energy += std::norm(_floats[i]);
+	}
+	float rms = sqrtf(energy / (2 * _blockSize));
+	lap(CStatistics::STAGE_DCT, now);
+
+	if (!(rms < _silenceThreshold))
+	{
+		return 0;
+	}
+	if (_statistics)
+	{
+		_statistics->addCount(CStatistics::COUNTER_BLOCKS, 1);
+		_statistics->addCount(CStatistics::COUNTER_SILENT_BLOCKS, 1);
+	}
+	return getSilenceLevel(rms);
+}
+
+// the entropy coder's time counts as xz, rebuilding the block for the residual as the DCT
+void CSnapEncoder::encodeRiceBlock(const std::complex<float>* samples, std::vector<uint8_t>& destination)
+{
+	uint64_t now = _statistics ? CStatistics::getNanoseconds() : 0;
+
+	int32_t* real = _integers.data();
+	int32_t* imag = _integers.data() + _blockSize;
+	for (uint32_t i = 0; i < _blockSize; i++)
+	{
+		real[i] = std::max(-128.0f, std::min(127.0f, roundf(samples[i].real())));
+		imag[i] = std::max(-128.0f, std::min(127.0f, roundf(samples[i].imag())));
+	}
+	std::copy(_integers.begin(), _integers.begin() + _rounded.size(), _rounded.begin());
+	now = lap(CStatistics::STAGE_QUANTISE, now);
+
+	_integerDct->forward(real, _scratch.data());
+	_integerDct->forward(imag, _scratch.data());
+	for (uint32_t i = 0; i < _binsToKeep; i++)
+	{
+		_interleaved[2 * i] = divideRounded(real[i], _integerStep);
+		_interleaved[2 * i + 1] = divideRounded(imag[i], _integerStep);
+	}
+
+	if (_maxError != noMaxError)
+	{
+		// exactly what the decoder gets before adding the residual, it's all integer arithmetic
+		for (uint32_t i = 0; i < _blockSize; i++)
+		{
+			real[i] = i < _binsToKeep ? _interleaved[2 * i] * (int32_t) _integerStep : 0;
+			imag[i] = i < _binsToKeep ? _interleaved[2 * i + 1] * (int32_t) _integerStep : 0;
+		}
+		_integerDct->inverse(real, _scratch.data());
+		_integerDct->inverse(imag, _scratch.data());
+
+		// rounding to the nearest multiple of the step leaves at most maxError
+		const int32_t residualStep = 2 * _maxError + 1;
+		int32_t* residuals = _interleaved.data() + 2 * _binsToKeep;
+		for (uint32_t i = 0; i < _blockSize; i++)
+		{
+			residuals[2 * i] = divideRounded(_rounded[i] - real[i], residualStep);
+			residuals[2 * i + 1] = divideRounded(_rounded[_blockSize + i] - imag[i], residualStep);
+		}
+	}
+	now = lap(CStatistics::STAGE_DCT, now);
+
+	size_t bytesBefore = destination.size();
+	CRiceCoder::encode(_interleaved.data(), _interleaved.size(), destination);
+	_codedBytesIn += 2 * _binsToKeep;
+	_codedBytesOut += destination.size() - bytesBefore;
+	lap(CStatistics::STAGE_XZ, now);
+
+	if (_statistics)
+	{
+		_statistics->addCount(CStatistics::COUNTER_BLOCKS, 1);
+	}
+}
+
+uint32_t CSnapEncoder::getIntegerStep(float quantisationFactor)
+{
+	return std::max(1L, lroundf(1.0f / quantisationFactor));
+}
+
+uint32_t CSnapEncoder::quantise(const std::complex<float>* coefficients, uint32_t numBins, const float* quantisationFactors, std::complex<int8_t>* destination, float& largestMagnitude)
+{
+	uint32_t overflows = 0;
+
+	for (uint32_t i = 0; i < numBins; i++)
+	{
+		float real = roundf(coefficients[i].real() * quantisationFactors[i]);
+		float imag = roundf(coefficients[i].imag() * quantisationFactors[i]);
+
+		float largest = std::max(std::abs(real), std::abs(imag));
+		if (largest > 127)
+		{
+			overflows++;
+			largestMagnitude = std::max(largestMagnitude, largest);
+
+			real = std::max(-127.0f, std::min(127.0f, real));
+			imag = std::max(-127.0f, std::min(127.0f, imag));
+		}
+
+		destination[i].real(real);
+		destination[i].imag(imag);
+	}
+
+	return overflows;
+}
+
+void CSnapEncoder::finishChunk()
+{
+	if (_isRice)
+	{
+		// the blocks are already out, there is nothing to end
+		_index.addEntry(_chunkFirstBlock, _chunkOffset, _chunkChecksum);
+		_chunkChecksum = 0;
+
+		_chunkFirstBlock = _blocksEncoded;
+		_chunkOffset = _bytesProduced;
+		return;
+	}
+
+	createCompressor();
+
+	// end the xz stream so the next chunk can be decoded without this one
+	std::vector<uint8_t> compressed;
+	bool done = false;
+	while (!done)
+	{
+		done = _compressor->finish();
+		_compressor->writeAndEmptyBuffer(compressed);
+	}
+	appendOutput(compressed);
+
+	uint32_t checksum = _compressor->getStreamChecksum();
+	uint64_t enhancementOffset = 0;
+	if (_baseBins < _binsToKeep)
+	{
+		enhancementOffset = _bytesProduced;
+		compressed.clear();
+		compressEnhancementLayer(compressed, checksum);
+		appendOutput(compressed);
+	}
+
+	_index.addEntry(_chunkFirstBlock, _chunkOffset, checksum, enhancementOffset);
+	_compressor->startNewStream();
+
+	_chunkFirstBlock = _blocksEncoded;
+	_chunkOffset = _bytesProduced;
+}
+
+// the chunk's enhancement layer as an xz stream of its own after the base layer's, whose checksum is carried on over it
+void CSnapEncoder::compressEnhancementLayer(std::vector<uint8_t>& destination, uint32_t& checksum)
+{
+	const uint32_t blockBytes = 2 * (_binsToKeep - _baseBins);
+	size_t start = destination.size();
+
+	_compressor->startNewStream();
+	for (size_t offset = 0; offset < _enhancement.size(); offset += blockBytes)
+	{
+		_compressor->addBytes(_enhancement.data() + offset, blockBytes);
+		_compressor->writeAndEmptyBuffer(destination);
+	}
+
+	bool done = false;
+	while (!done)
+	{
+		done = _compressor->finish();
+		_compressor->writeAndEmptyBuffer(destination);
+	}
+
+	checksum = CCrc32c::calculate(destination.data() + start, destination.size() - start, checksum);
+	_enhancement.clear();
+}
+
+void CSnapEncoder::createCompressor()
+{
+	if (!_compressor)
+	{
+		_compressor.reset(new CXZCompress(_chunkDictionarySize, _xzBufferSize));
+	}
+}
+
+void CSnapEncoder::appendOutput(const std::vector<uint8_t>& data)
+{
+	_output.insert(_output.end(), data.begin(), data.end());
+	_bytesProduced += data.size();
+}
+
+uint64_t CSnapEncoder::lap(CStatistics::EStage stage, uint64_t start)
+{
+	return _statistics ? _statistics->lap(stage, start) : 0;
+}
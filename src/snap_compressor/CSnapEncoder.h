@@ -0,0 +1,214 @@
+#ifndef SRC_SNAP_COMPRESSOR_CSNAPENCODER_H_
+#define SRC_SNAP_COMPRESSOR_CSNAPENCODER_H_
+
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "CMemoryPlanner.h"
+#include "CSampleFormat.h"
+#include "CSeekIndex.h"
+#include "CSnapHeader.h"
+#include "CStatistics.h"
+#include "SnapError.h"
+
+class CIntegerDCT;
+class CXZCompress;
+
+// Encodes a stream of 8 bit IQ samples into the .roundedQuantisedDCT format in memory: push samples in, pull the encoded
+// bytes out. One encoder can be reused for any number of streams, its buffers (and xz's memory) are kept between them.
+class CSnapEncoder
+{
+public:
+	// an independently decodable xz stream (or run of lossless blocks) of whole blocks, see encodeChunk()
+	struct Chunk
+	{
+		std::vector<uint8_t> bytes;
+		uint32_t numBlocks;
+		uint64_t numSamples;	// numBlocks * block size, less the padding of a partial last block
+		uint32_t checksum;
+		uint32_t enhancementOffset;	// from the start of bytes, 0 if the file isn't layered
+		uint64_t overflowCount;
+		float suggestedQuantisationFactor;
+	};
+
+	CSnapEncoder();
+	virtual ~CSnapEncoder();
+
+	// metadata holds the capture metadata for the header, the codec parameters are added to it
+	ESnapError start(uint32_t blockSize, float quantisationFactor, uint32_t binsToKeep, uint32_t blocksPerChunk, const CSnapHeader& metadata);
+
+	// samples needn't be a whole number of blocks, the remainder is kept until the next call
+	ESnapError pushSamples(const std::complex<int8_t>* samples, size_t numSamples);
+
+	// float samples on the 8 bit scale (full scale is +/-127), which is what the decoder reproduces
+	ESnapError pushSamples(const std::complex<float>* samples, size_t numSamples);
+
+	// raw IQ in any CSampleFormat but sdriq (whose header the caller reads), converted straight into the DCT's input without
+	// rounding to 8 bits. scale takes the samples to the 8 bit scale, e.g. 127 / peak
+	ESnapError pushSamples(const void* samples, size_t numSamples, CSampleFormat::EFormat format, float scale);
+
+	// xz dictionary, DCT strategy and buffer sizes for the next start(), see CMemoryPlanner
+	void setMemoryPlan(const CMemoryPlanner::Plan& plan);
+
+	// for the next start(): codes samples exactly, with CIntegerDCT and CRiceCoder instead of the DCT, quantisation and xz.
+	// The block size must be a power of two up to maxLosslessBlockSize, quantisationFactor and binsToKeep are ignored.
+	// Samples are rounded to 8 bits (and clipped), which is what the decoder gives back
+	void setLossless(bool isLossless);
+	bool isLossless() const;
+
+	// for the next start(): near lossless, the same integer transform and coder as setLossless() but the coefficients are
+	// divided by getIntegerStep(quantisationFactor) and the bins from binsToKeep up dropped. Each block is then rebuilt the
+	// way the decoder will and the residual coded in steps of 2 * maxError + 1, so no sample (once rounded to 8 bits) comes
+	// back more than maxError off. noMaxError turns it off, setLossless() wins over it
+	void setMaxError(uint32_t maxError);
+	uint32_t getMaxError() const;
+
+	// for the next start(): layered, each chunk's xz stream only has the bins below baseBins and is followed by a second stream
+	// with the rest of the bins, so a decoder can read only the first for a preview. baseBins must be below binsToKeep, 0
+	// (the default) isn't layered. Not with setLossless() or setMaxError()
+	void setBaseBins(uint32_t baseBins);
+
+	// for the next start(): blocks whose RMS (per I or Q sample, on the 8 bit scale) is below threshold skip the DCT and
+	// are coded as just their silence level, the decoder gives back silence or noise of that RMS. Every block then starts
+	// with its level byte, 0 for one with coefficients after it. 0 (the default) turns it off, threshold must be at most
+	// maxSilenceThreshold. Not with setLossless(), setMaxError() or setBaseBins()
+	void setSilenceThreshold(float threshold);
+
+	// a silent block's level is 1 + its RMS in eighths, so idle runs of similar noise give xz the same byte over and over
+	static uint8_t getSilenceLevel(float rms);
+	static float getSilenceRms(uint8_t level);
+
+	// for the next start(): a quantisation factor per bin instead of the same one for them all, bin i is quantised with
+	// quantisationFactor * weights[i * weights.size() / binsToKeep], so the weights can be per bin or per band of bins.
+	// There can't be more than binsToKeep or maxQuantisationTableSize of them. Empty (the default) is the same for every
+	// bin. Not with setLossless() or setMaxError(). CQuantisationTable derives them from the signal
+	void setQuantisationTable(const std::vector<float>& weights);
+
+	// the factor each of the binsToKeep bins is quantised with, see setQuantisationTable()
+	static void getBinQuantisationFactors(float quantisationFactor, const std::vector<float>& weights, uint32_t binsToKeep, std::vector<float>& factors);
+
+	static const uint32_t maxLosslessBlockSize = 65536;
+	static const uint32_t noMaxError = UINT32_MAX;
+	static const uint32_t maxSilenceThreshold = 31;
+	static const uint32_t maxQuantisationTableSize = 16383;
+
+	// uses dct (which must be for the block size given to start()) instead of building one, so encoders on several threads
+	// can share one set of tables. NULL goes back to building one per encoder
+	void setTransform(const std::shared_ptr<const CDiscreteCosineTransform>& dct);
+
+	// times the encoding stages and counts blocks/overflows into statistics (which must outlive the encoder), NULL to stop
+	void setStatistics(CStatistics* statistics);
+
+	// flushes the last chunk and appends the seek index. A partial block at the end is padded with zeros, the seek index
+	// records how many samples there really were so the decoder can leave the padding off
+	ESnapError finish();
+
+	// Chunks are independent, so a stream can be encoded in parallel: encodeChunk() compresses up to blocksPerChunk * block
+	// size samples on any started encoder which is only used for encodeChunk() (e.g. one per worker thread, started with the
+	// same parameters), then pushChunk() adds the chunks in order to the encoder producing the file, instead of pushSamples().
+	// Every chunk but the last must have blocksPerChunk blocks, only the last can end with a partial (padded) block.
+	ESnapError encodeChunk(const std::complex<int8_t>* samples, uint64_t numSamples, Chunk& chunk);
+	ESnapError pushChunk(const Chunk& chunk);
+
+	// encoded bytes which haven't been pulled yet, as a view or copied out
+	const uint8_t* getOutput(size_t& numBytes) const;
+	void consumeOutput(size_t numBytes);
+	size_t pullBytes(uint8_t* data, size_t maxBytes);
+
+	uint64_t getBlocksEncoded() const;
+	uint64_t getBytesProduced() const;
+	// of the lossless coder if it is in use
+	float getXzRatio() const;
+
+	// coefficients which didn't fit in 8 bits after quantisation (they are clipped), and the largest quantisation
+	// factor that would have avoided all of them
+	uint64_t getOverflowCount() const;
+	float getSuggestedQuantisationFactor() const;
+
+	// rounds each coefficient times its bin's factor (see getBinQuantisationFactors()) to 8 bits, clipping any that don't fit.
+	// Returns how many were clipped, largestMagnitude is raised to the largest scaled real or imaginary part seen
+	static uint32_t quantise(const std::complex<float>* coefficients, uint32_t numBins, const float* quantisationFactors, std::complex<int8_t>* destination, float& largestMagnitude);
+
+	// what the integer transform's coefficients are divided by, the nearest whole number to 1 / quantisationFactor (at least 1)
+	static uint32_t getIntegerStep(float quantisationFactor);
+
+private:
+	void loadBlock(const std::complex<int8_t>* samples, uint32_t numSamples);
+	void encodeBlock();
+	void compressBlock(std::vector<uint8_t>& destination, uint64_t& overflowCount, float& suggestedQuantisationFactor);
+	uint32_t transformBlock(float& largestMagnitude);
+	uint8_t detectSilence();
+	void encodeRiceBlock(const std::complex<float>* samples, std::vector<uint8_t>& destination);
+	void finishChunk();
+	void compressEnhancementLayer(std::vector<uint8_t>& destination, uint32_t& checksum);
+	void createCompressor();
+	void appendOutput(const std::vector<uint8_t>& data);
+	uint64_t lap(CStatistics::EStage stage, uint64_t start);
+
+	std::unique_ptr<CXZCompress> _compressor;
+	std::unique_ptr<CIntegerDCT> _integerDct;
+	std::shared_ptr<const CDiscreteCosineTransform> _dct;
+	bool _isSharedDct;
+	CSeekIndex _index;
+	CStatistics* _statistics;
+	bool _isStarted;
+
+	// the plan's dictionary (0 to size it to a chunk), and the one the compressor has
+	uint32_t _dictionarySize;
+	uint32_t _chunkDictionarySize;
+	uint32_t _xzBufferSize;
+	CDiscreteCosineTransform::EStrategy _dctStrategy;
+
+	uint32_t _blockSize;
+	float _quantisationFactor;
+	uint32_t _binsToKeep;
+	uint32_t _blocksPerChunk;
+	bool _isRice;
+	bool _isLosslessNext;
+	uint32_t _maxError;
+	uint32_t _maxErrorNext;
+	uint32_t _integerStep;
+	uint32_t _baseBins;
+	uint32_t _baseBinsNext;
+	float _silenceThreshold;
+	float _silenceThresholdNext;
+	std::vector<float> _quantisationTableNext;
+	// quantisationFactor scaled by the table, one per kept bin
+	std::vector<float> _binQuantisationFactors;
+
+	// the block being filled, as the DCT's input
+	uint32_t _numPendingSamples;
+	std::vector<std::complex<float>> _floats;
+	std::vector<std::complex<float>> _transformed;
+	std::vector<std::complex<int8_t>> _quantised;
+
+	// layered: the chunk's bins from baseBins up, compressed once the base layer is finished
+	std::vector<uint8_t> _enhancement;
+
+	// Rice backend: I and Q transformed separately then interleaved for the coder (residuals after the coefficients), the
+	// rounded samples the residuals are taken from, the transform's scratch, and the crc32c of the chunk so far
+	std::vector<int32_t> _integers;
+	std::vector<int32_t> _rounded;
+	std::vector<int32_t> _interleaved;
+	std::vector<int32_t> _scratch;
+	std::vector<uint8_t> _coded;
+	uint32_t _chunkChecksum;
+	uint64_t _codedBytesIn;
+	uint64_t _codedBytesOut;
+
+	std::vector<uint8_t> _output;
+	size_t _outputReadPosition;
+	uint64_t _bytesProduced;
+
+	uint64_t _blocksEncoded;
+	uint64_t _samplesEncoded;
+	uint64_t _chunkFirstBlock;
+	uint64_t _chunkOffset;
+
+	uint64_t _overflowCount;
+	float _suggestedQuantisationFactor;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CSNAPENCODER_H_ */
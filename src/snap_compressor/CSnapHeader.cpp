@@ -0,0 +1,361 @@
+#include "CSnapHeader.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+#include "CCrc32c.h"
+
+namespace
+{
+const uint8_t magic[3] = {0xB0, 0xBD, 0xC7};
+const uint8_t minimumVersion = 1;
+
+// refuse to allocate silly amounts of memory for corrupt headers
+const uint32_t maximumTlvLength = 1024 * 1024;
+}
+
+const uint8_t CSnapHeader::currentVersion;
+const uint16_t CSnapHeader::firstMetadataTag;
+
+CSnapHeader::CSnapHeader() :
+		_version(currentVersion),
+		_payloadOffset(0)
+{
+}
+
+CSnapHeader::~CSnapHeader()
+{
+}
+
+void CSnapHeader::setUint32(ETag tag, uint32_t value)
+{
+	setBytes(tag, &value, 4);
+}
+
+void CSnapHeader::setUint64(ETag tag, uint64_t value)
+{
+	setBytes(tag, &value, 8);
+}
+
+void CSnapHeader::setFloat(ETag tag, float value)
+{
+	setBytes(tag, &value, 4);
+}
+
+void CSnapHeader::setFloats(ETag tag, const std::vector<float>& values)
+{
+	setBytes(tag, values.data(), values.size() * 4);
+}
+
+bool CSnapHeader::has(ETag tag) const
+{
+	return _fields.count(tag) != 0;
+}
+
+uint32_t CSnapHeader::getUint32(ETag tag, uint32_t defaultValue) const
+{
+	uint32_t value = defaultValue;
+	getBytes(tag, &value, 4);
+	return value;
+}
+
+uint64_t CSnapHeader::getUint64(ETag tag, uint64_t defaultValue) const
+{
+	uint64_t value = defaultValue;
+	getBytes(tag, &value, 8);
+	return value;
+}
+
+float CSnapHeader::getFloat(ETag tag, float defaultValue) const
+{
+	float value = defaultValue;
+	getBytes(tag, &value, 4);
+	return value;
+}
+
+bool CSnapHeader::getFloats(ETag tag, std::vector<float>& values) const
+{
+	values.clear();
+	auto it = _fields.find(tag);
+	if (it == _fields.end() || it->second.size() % 4 != 0)
+	{
+		return false;
+	}
+	values.resize(it->second.size() / 4);
+	memcpy(values.data(), it->second.data(), it->second.size());
+	return true;
+}
+
+void CSnapHeader::write(std::vector<uint8_t>& destination) const
+{
+	std::vector<uint8_t> tlv;
+	for (const auto& field : _fields)
+	{
+		uint16_t tag = field.first;
+		uint16_t length = field.second.size();
+		tlv.insert(tlv.end(), reinterpret_cast<const uint8_t*>(&tag), reinterpret_cast<const uint8_t*>(&tag) + 2);
+		tlv.insert(tlv.end(), reinterpret_cast<const uint8_t*>(&length), reinterpret_cast<const uint8_t*>(&length) + 2);
+		tlv.insert(tlv.end(), field.second.begin(), field.second.end());
+	}
+
+	uint32_t tlvLength = tlv.size();
+	uint32_t crc = CCrc32c::calculate(tlv.data(), tlv.size());
+
+	// these aren't compressed to make it easier to see what is going on (but means we can't use xz to decompress)
+	destination.insert(destination.end(), magic, magic + 3);
+	destination.push_back(currentVersion);
+	destination.insert(destination.end(), reinterpret_cast<const uint8_t*>(&tlvLength), reinterpret_cast<const uint8_t*>(&tlvLength) + 4);
+	destination.insert(destination.end(), tlv.begin(), tlv.end());
+	destination.insert(destination.end(), reinterpret_cast<const uint8_t*>(&crc), reinterpret_cast<const uint8_t*>(&crc) + 4);
+}
+
+ESnapError CSnapHeader::read(FILE* fh)
+{
+	std::vector<uint8_t> data(8);
+	size_t numBytes = fread(data.data(), 1, data.size(), fh);
+
+	size_t headerSize = getSize(data.data(), numBytes);
+	if (headerSize == 0)
+	{
+		return SNAP_ERROR_INVALID_HEADER;
+	}
+
+	if (headerSize > numBytes)
+	{
+		data.resize(headerSize);
+		numBytes += fread(data.data() + numBytes, 1, headerSize - numBytes, fh);
+	}
+
+	ESnapError error = read(data.data(), numBytes);
+	if (error == SNAP_OK)
+	{
+		fseek(fh, _payloadOffset, SEEK_SET);
+	}
+	return error;
+}
+
+size_t CSnapHeader::getSize(const uint8_t* data, size_t numBytes)
+{
+	if (numBytes < 4)
+	{
+		return 0;
+	}
+
+	if (data[3] < 3)
+	{
+		// fixed layout: magic, blockSize, quantisationFactor, binsToKeep all 4 bytes, LE
+		return 16;
+	}
+
+	if (numBytes < 8)
+	{
+		return 0;
+	}
+
+	uint32_t tlvLength;
+	memcpy(&tlvLength, data + 4, 4);
+	return 4 + 4 + std::min(tlvLength, maximumTlvLength) + 4;
+}
+
+ESnapError CSnapHeader::read(const uint8_t* data, size_t numBytes)
+{
+	_fields.clear();
+
+	if (numBytes < 4 || memcmp(data, magic, 3) != 0)
+	{
+		return SNAP_ERROR_INVALID_HEADER;
+	}
+	if (data[3] < minimumVersion || data[3] > currentVersion)
+	{
+		return SNAP_ERROR_UNSUPPORTED;
+	}
+	_version = data[3];
+
+	size_t headerSize = getSize(data, numBytes);
+	if (headerSize == 0 || numBytes < headerSize)
+	{
+		return SNAP_ERROR_INVALID_HEADER;
+	}
+
+	if (_version < 3)
+	{
+		uint32_t blockSize;
+		float quantisationFactor;
+		uint32_t binsToKeep;
+		memcpy(&blockSize, data + 4, 4);
+		memcpy(&quantisationFactor, data + 8, 4);
+		memcpy(&binsToKeep, data + 12, 4);
+
+		setUint32(TAG_BACKEND, BACKEND_XZ);
+		setUint32(TAG_BLOCK_SIZE, blockSize);
+		setFloat(TAG_QUANTISATION_FACTOR, quantisationFactor);
+		setUint32(TAG_BINS_TO_KEEP, binsToKeep);
+
+		_payloadOffset = headerSize;
+		return SNAP_OK;
+	}
+
+	uint32_t tlvLength;
+	uint32_t crc;
+	memcpy(&tlvLength, data + 4, 4);
+	if (tlvLength > maximumTlvLength)
+	{
+		return SNAP_ERROR_INVALID_HEADER;
+	}
+
+	const uint8_t* tlv = data + 8;
+	memcpy(&crc, tlv + tlvLength, 4);
+
+	if (CCrc32c::calculate(tlv, tlvLength) != crc)
+	{
+		return SNAP_ERROR_CHECKSUM;
+	}
+
+	uint32_t position = 0;
+	while (position + 4 <= tlvLength)
+	{
+		uint16_t tag;
+		uint16_t length;
+		memcpy(&tag, tlv + position, 2);
+		memcpy(&length, tlv + position + 2, 2);
+		position += 4;
+
+		if (position + length > tlvLength)
+		{
+			return SNAP_ERROR_INVALID_HEADER;
+		}
+
+		_fields[tag].assign(tlv + position, tlv + position + length);
+		position += length;
+	}
+
+	_payloadOffset = headerSize;
+	return SNAP_OK;
+}
+
+uint8_t CSnapHeader::getVersion() const
+{
+	return _version;
+}
+
+uint64_t CSnapHeader::getPayloadOffset() const
+{
+	return _payloadOffset;
+}
+
+void CSnapHeader::print(FILE* fh) const
+{
+	fprintf(fh, "version: %u\n", _version);
+	fprintf(fh, "backend: %u\n", getUint32(TAG_BACKEND));
+	fprintf(fh, "block size: %u\n", getUint32(TAG_BLOCK_SIZE));
+	fprintf(fh, "quantisation factor: %f\n", getFloat(TAG_QUANTISATION_FACTOR));
+	fprintf(fh, "bins to keep: %u\n", getUint32(TAG_BINS_TO_KEEP));
+
+	if (has(TAG_BLOCKS_PER_CHUNK))
+	{
+		fprintf(fh, "blocks per chunk: %u\n", getUint32(TAG_BLOCKS_PER_CHUNK));
+	}
+	if (has(TAG_TRANSFORM))
+	{
+		fprintf(fh, "transform: %u\n", getUint32(TAG_TRANSFORM));
+	}
+	if (has(TAG_MAX_ERROR))
+	{
+		fprintf(fh, "max error: %u\n", getUint32(TAG_MAX_ERROR));
+	}
+	if (has(TAG_BASE_BINS))
+	{
+		fprintf(fh, "base layer bins: %u\n", getUint32(TAG_BASE_BINS));
+	}
+	if (has(TAG_SILENCE_THRESHOLD))
+	{
+		fprintf(fh, "silence threshold: %f\n", getFloat(TAG_SILENCE_THRESHOLD));
+	}
+	std::vector<float> table;
+	if (getFloats(TAG_QUANTISATION_TABLE, table) && !table.empty())
+	{
+		auto range = std::minmax_element(table.begin(), table.end());
+		fprintf(fh, "quantisation table: %zu weights, %f to %f\n", table.size(), *range.first, *range.second);
+	}
+	if (has(TAG_SAMPLE_RATE))
+	{
+		fprintf(fh, "sample rate: %u Hz\n", getUint32(TAG_SAMPLE_RATE));
+	}
+	if (has(TAG_CENTRE_FREQUENCY))
+	{
+		fprintf(fh, "centre frequency: %" PRIu64 " Hz\n", getUint64(TAG_CENTRE_FREQUENCY));
+	}
+	if (has(TAG_TIMESTAMP))
+	{
+		fprintf(fh, "timestamp: %" PRIu64 "\n", getUint64(TAG_TIMESTAMP));
+	}
+
+	for (const auto& field : _fields)
+	{
+		if (isKnownTag(field.first))
+		{
+			continue;
+		}
+		if (field.first < firstMetadataTag)
+		{
+			fprintf(fh, "unknown codec parameter %u (%zu bytes), the file can't be decoded\n", field.first, field.second.size());
+		}
+		else
+		{
+			fprintf(fh, "unknown field %u (%zu bytes)\n", field.first, field.second.size());
+		}
+	}
+}
+
+bool CSnapHeader::hasUnknownCodecTags() const
+{
+	for (const auto& field : _fields)
+	{
+		if (field.first < firstMetadataTag && !isKnownTag(field.first))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CSnapHeader::isKnownTag(uint16_t tag)
+{
+	switch (tag)
+	{
+		case TAG_BACKEND:
+		case TAG_BLOCK_SIZE:
+		case TAG_QUANTISATION_FACTOR:
+		case TAG_BINS_TO_KEEP:
+		case TAG_BLOCKS_PER_CHUNK:
+		case TAG_TRANSFORM:
+		case TAG_MAX_ERROR:
+		case TAG_BASE_BINS:
+		case TAG_SILENCE_THRESHOLD:
+		case TAG_QUANTISATION_TABLE:
+		case TAG_SAMPLE_RATE:
+		case TAG_CENTRE_FREQUENCY:
+		case TAG_TIMESTAMP:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void CSnapHeader::setBytes(ETag tag, const void* data, uint16_t length)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	_fields[tag].assign(bytes, bytes + length);
+}
+
+bool CSnapHeader::getBytes(ETag tag, void* data, uint16_t length) const
+{
+	auto it = _fields.find(tag);
+	if (it == _fields.end() || it->second.size() != length)
+	{
+		return false;
+	}
+	memcpy(data, it->second.data(), length);
+	return true;
+}
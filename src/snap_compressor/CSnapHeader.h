@@ -0,0 +1,102 @@
+#ifndef SRC_SNAP_COMPRESSOR_CSNAPHEADER_H_
+#define SRC_SNAP_COMPRESSOR_CSNAPHEADER_H_
+
+#include <cstdint>
+#include <map>
+#include <stdio.h>
+#include <vector>
+
+#include "SnapError.h"
+
+// File header, version 3 onwards it is self describing:
+//   magic (3 bytes) + version (1), tlvLength (4), tlvLength bytes of fields, crc32c of the fields (4)
+// each field is tag (2), length (2), value (length bytes), all LE. Tags below firstMetadataTag are codec parameters, which
+// change how the payload is decoded, so a reader that doesn't know one must refuse the file (see hasUnknownCodecTags()).
+// Readers skip metadata tags they don't know about.
+// Versions 1 and 2 had a fixed layout (magic, blockSize, quantisationFactor, binsToKeep), read() maps those onto the same tags.
+class CSnapHeader
+{
+public:
+	enum ETag
+	{
+		// codec parameters, every reader must understand these
+		TAG_BACKEND = 1,
+		TAG_BLOCK_SIZE = 2,
+		TAG_QUANTISATION_FACTOR = 3,
+		TAG_BINS_TO_KEEP = 4,
+		TAG_BLOCKS_PER_CHUNK = 5,
+		TAG_TRANSFORM = 6,
+		TAG_MAX_ERROR = 7,	// integer transform only, the residual is coded so no sample is further off than this
+		TAG_BASE_BINS = 8,	// xz only, each chunk is a base layer of the bins below this then an enhancement layer of the rest
+		TAG_SILENCE_THRESHOLD = 9,	// xz only, not layered. Each block starts with its silence level, see CSnapEncoder
+		TAG_QUANTISATION_TABLE = 10,	// xz only, floats weighting the quantisation factor per bin or band, see CSnapEncoder
+
+		// capture metadata, as found in sdriq files
+		TAG_SAMPLE_RATE = 64,
+		TAG_CENTRE_FREQUENCY = 65,
+		TAG_TIMESTAMP = 66
+	};
+
+	enum EBackend
+	{
+		BACKEND_XZ = 1,
+		BACKEND_RICE = 2	// CRiceCoder blocks, lossless or error bounded
+	};
+
+	// files without the tag use TRANSFORM_DCT
+	enum ETransform
+	{
+		TRANSFORM_DCT = 1,
+		TRANSFORM_INTEGER_DCT = 2	// CIntegerDCT, quantised in whole steps of 1 / quantisation factor
+	};
+
+	static const uint8_t currentVersion = 3;
+	static const uint16_t firstMetadataTag = 64;
+
+	CSnapHeader();
+	virtual ~CSnapHeader();
+
+	void setUint32(ETag tag, uint32_t value);
+	void setUint64(ETag tag, uint64_t value);
+	void setFloat(ETag tag, float value);
+	// at most 16383 of them, so they fit in a field
+	void setFloats(ETag tag, const std::vector<float>& values);
+
+	bool has(ETag tag) const;
+	uint32_t getUint32(ETag tag, uint32_t defaultValue = 0) const;
+	uint64_t getUint64(ETag tag, uint64_t defaultValue = 0) const;
+	float getFloat(ETag tag, float defaultValue = 0.0f) const;
+	// false (and values empty) if the tag is missing or isn't a whole number of floats
+	bool getFloats(ETag tag, std::vector<float>& values) const;
+
+	void write(std::vector<uint8_t>& destination) const;
+
+	// leaves fh at the start of the payload
+	ESnapError read(FILE* fh);
+
+	// data must hold the whole header, see getSize()
+	ESnapError read(const uint8_t* data, size_t numBytes);
+
+	// size of the header at the start of data, or 0 if more bytes are needed to tell
+	static size_t getSize(const uint8_t* data, size_t numBytes);
+
+	uint8_t getVersion() const;
+	uint64_t getPayloadOffset() const;
+
+	// a codec parameter newer than this reader, the file can't be decoded
+	bool hasUnknownCodecTags() const;
+
+	void print(FILE* fh) const;
+
+private:
+	static bool isKnownTag(uint16_t tag);
+
+	void setBytes(ETag tag, const void* data, uint16_t length);
+	bool getBytes(ETag tag, void* data, uint16_t length) const;
+
+	std::map<uint16_t, std::vector<uint8_t>> _fields;
+	uint8_t _version;
+	uint64_t _payloadOffset;
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CSNAPHEADER_H_ */
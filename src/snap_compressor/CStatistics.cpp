@@ -0,0 +1,100 @@
+#include "CStatistics.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <string>
+
+namespace
+{
+const char* stageNames[CStatistics::NUM_STAGES] = {"read", "widen", "dct", "quantise", "xz", "dequantise", "idct", "narrow", "write"};
+const char* counterNames[CStatistics::NUM_COUNTERS] = {"bytes_in", "bytes_out", "blocks", "overflows", "silent_blocks"};
+}
+
+CStatistics::CStatistics() :
+		_startTime(getNanoseconds())
+{
+	memset(_stageNanoseconds, 0, sizeof(_stageNanoseconds));
+	memset(_stageCalls, 0, sizeof(_stageCalls));
+	memset(_counts, 0, sizeof(_counts));
+}
+
+CStatistics::~CStatistics()
+{
+}
+
+uint64_t CStatistics::getNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t CStatistics::lap(EStage stage, uint64_t start)
+{
+	uint64_t now = getNanoseconds();
+	_stageNanoseconds[stage] += now - start;
+	_stageCalls[stage]++;
+	return now;
+}
+
+void CStatistics::addCount(ECounter counter, uint64_t count)
+{
+	_counts[counter] += count;
+}
+
+uint64_t CStatistics::getStageNanoseconds(EStage stage) const
+{
+	return _stageNanoseconds[stage];
+}
+
+uint64_t CStatistics::getCount(ECounter counter) const
+{
+	return _counts[counter];
+}
+
+double CStatistics::getElapsedSeconds() const
+{
+	return (getNanoseconds() - _startTime) * 1e-9;
+}
+
+void CStatistics::writeJson(FILE* fh, const char* command) const
+{
+	const double elapsedSeconds = getElapsedSeconds();
+
+	fprintf(fh, "{\"command\":\"%s\",\"elapsed_s\":%.6f,\"stages\":{", command, elapsedSeconds);
+
+	bool isFirst = true;
+	for (uint32_t stage = 0; stage < NUM_STAGES; stage++)
+	{
+		// only the stages the command went through
+		if (_stageCalls[stage] == 0)
+		{
+			continue;
+		}
+
+		double seconds = _stageNanoseconds[stage] * 1e-9;
+		fprintf(fh, "%s\"%s\":{\"seconds\":%.6f,\"calls\":%" PRIu64 ",\"fraction\":%.4f}", isFirst ? "" : ",", stageNames[stage], seconds, _stageCalls[stage], elapsedSeconds > 0.0 ? seconds / elapsedSeconds : 0.0);
+		isFirst = false;
+	}
+
+	fprintf(fh, "},\"counters\":{");
+	for (uint32_t counter = 0; counter < NUM_COUNTERS; counter++)
+	{
+		fprintf(fh, "%s\"%s\":%" PRIu64, counter ? "," : "", counterNames[counter], _counts[counter]);
+	}
+	fprintf(fh, "}}\n");
+}
+
+bool CStatistics::writeJsonFile(const char* fileName, const char* command) const
+{
+	std::string temporaryFileName = std::string(fileName) + ".tmp";
+
+	FILE* fh = fopen(temporaryFileName.c_str(), "w");
+	if (!fh)
+	{
+		return false;
+	}
+	writeJson(fh, command);
+	fclose(fh);
+
+	return rename(temporaryFileName.c_str(), fileName) == 0;
+}
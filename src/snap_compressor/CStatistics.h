@@ -0,0 +1,70 @@
+#ifndef SRC_SNAP_COMPRESSOR_CSTATISTICS_H_
+#define SRC_SNAP_COMPRESSOR_CSTATISTICS_H_
+
+#include <cstdint>
+#include <stdio.h>
+
+// Time spent in each stage of encoding/decoding and a few counters, cheap enough to leave on in production runs:
+// one clock read per stage boundary, e.g.
+//   uint64_t now = CStatistics::getNanoseconds();
+//   ...widen...
+//   now = statistics->lap(CStatistics::STAGE_WIDEN, now);
+//   ...DCT...
+//   now = statistics->lap(CStatistics::STAGE_DCT, now);
+class CStatistics
+{
+public:
+	enum EStage
+	{
+		STAGE_READ,
+		STAGE_WIDEN,
+		STAGE_DCT,
+		STAGE_QUANTISE,
+		STAGE_XZ,
+		STAGE_DEQUANTISE,
+		STAGE_IDCT,
+		STAGE_NARROW,
+		STAGE_WRITE,
+		NUM_STAGES
+	};
+
+	enum ECounter
+	{
+		COUNTER_BYTES_IN,
+		COUNTER_BYTES_OUT,
+		COUNTER_BLOCKS,
+		COUNTER_OVERFLOWS,
+		COUNTER_SILENT_BLOCKS,
+		NUM_COUNTERS
+	};
+
+	CStatistics();
+	virtual ~CStatistics();
+
+	// monotonic, nanosecond resolution
+	static uint64_t getNanoseconds();
+
+	// adds the time since start to stage, returns the time now as the start of the next stage
+	uint64_t lap(EStage stage, uint64_t start);
+
+	void addCount(ECounter counter, uint64_t count);
+
+	uint64_t getStageNanoseconds(EStage stage) const;
+	uint64_t getCount(ECounter counter) const;
+
+	// seconds since construction
+	double getElapsedSeconds() const;
+
+	void writeJson(FILE* fh, const char* command) const;
+
+	// rewrites fileName via a temporary file, so anything polling it never sees half an update
+	bool writeJsonFile(const char* fileName, const char* command) const;
+
+private:
+	uint64_t _startTime;
+	uint64_t _stageNanoseconds[NUM_STAGES];
+	uint64_t _stageCalls[NUM_STAGES];
+	uint64_t _counts[NUM_COUNTERS];
+};
+
+#endif /* SRC_SNAP_COMPRESSOR_CSTATISTICS_H_ */
@@ -1,9 +1,13 @@
 #include "CXZCompress.h"
 
+#include "CCrc32c.h"
+
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
-CXZCompress::CXZCompress()
+CXZCompress::CXZCompress(uint32_t dictionarySize, uint32_t bufferSize) :
+		_dictionarySize(dictionarySize)
 {
 	_strm = LZMA_STREAM_INIT;
 
@@ -18,33 +22,16 @@ CXZCompress::CXZCompress()
 	 lzma_ret ret = lzma_stream_encoder_mt(&_strm, &multiThreadingOptions)
 	 */
 
-	// 3: Encoding: 282.4 / 283.6 MB processed, compressed size: 157.5 MB, ratio: 55.79% (75.00% trimming, 74.39% xz), rate = 1.83 MB/s, eta: 0.670191s
-	// 5: Encoding: 282.3 / 283.6 MB processed, compressed size: 147.4 MB, ratio: 52.22% (75.00% trimming, 69.62% xz), rate = 1.46 MB/s, eta: 0.889745s
-	// 9: Encoding: 283.4 / 283.6 MB processed, compressed size: 148.1 MB, ratio: 52.27% (75.00% trimming, 69.70% xz), rate = 1.07 MB/s, eta: 0.181572s
-	lzma_ret ret = lzma_easy_encoder(&_strm, 9, LZMA_CHECK_CRC64);
-	switch (ret)
-	{
-		case LZMA_OK:
-			break;
-		case LZMA_MEM_ERROR:
-			fprintf(stderr, "LZMA memory error\n");
-			throw 1;
-		case LZMA_OPTIONS_ERROR:
-			fprintf(stderr, "Invalid LZMA options\n");
-			throw 1;
-		case LZMA_UNSUPPORTED_CHECK:
-			fprintf(stderr, "LZMA unsupported\n");
-			throw 1;
-		case LZMA_PROG_ERROR:
-			fprintf(stderr, "LZMA programming error\n");
-			throw 1;
-	}
+	initEncoder();
 
-	_bufferSize = 512 * 1024;
+	_bufferSize = bufferSize;
 	_inputBuffer = (uint8_t*) malloc(_bufferSize);
 	_outputBuffer = (uint8_t*) malloc(_bufferSize);
 	_inputBufferUsed = 0;
 	_isFinishing = false;
+	_previousStreamsBytesIn = 0;
+	_previousStreamsBytesOut = 0;
+	_streamChecksum = 0;
 
 	_strm.next_out = _outputBuffer;
 	_strm.avail_out = _bufferSize;
@@ -64,52 +51,62 @@ void CXZCompress::addBytes(const uint8_t* data, uint32_t numBytes)
 		// add new data to buffer, to avoid so many calls into the lzma library
 		memcpy(_inputBuffer + _inputBufferUsed, data, numBytes);
 		_inputBufferUsed += numBytes;
+		return;
 	}
-	else
-	{
-		_strm.next_in = _inputBuffer;
-		_strm.avail_in = _inputBufferUsed;
 
-		lzma_ret ret = lzma_code(&_strm, LZMA_RUN);
+	// the buffered data first, then the new data straight from the caller, however big it is
+	code(_inputBuffer, _inputBufferUsed);
+	_inputBufferUsed = 0;
+	code(data, numBytes);
+}
 
-		switch (ret)
+// runs all of data through the encoder, moving the output buffer to _pendingOutput whenever it fills up
+void CXZCompress::code(const uint8_t* data, size_t numBytes)
+{
+	_strm.next_in = data;
+	_strm.avail_in = numBytes;
+
+	while (_strm.avail_in != 0)
+	{
+		if (_strm.avail_out == 0)
 		{
-			case LZMA_OK:
-				//fprintf(stderr, "LZMA OK\n");
-				break;
-			case LZMA_STREAM_END:
-				fprintf(stderr, "LZMA stream end\n");
-				break;
-			case LZMA_BUF_ERROR:
-				fprintf(stderr, "LZMA buf error\n");
-				break;
-			case LZMA_MEM_ERROR:
-				fprintf(stderr, "LZMA memory error\n");
-				throw 1;
-			case LZMA_OPTIONS_ERROR:
-				fprintf(stderr, "Invalid LZMA options\n");
-				throw 1;
-			case LZMA_UNSUPPORTED_CHECK:
-				fprintf(stderr, "LZMA unsupported\n");
-				throw 1;
-			case LZMA_PROG_ERROR:
-				fprintf(stderr, "LZMA programming error\n");
-				throw 1;
+			_pendingOutput.insert(_pendingOutput.end(), _outputBuffer, _outputBuffer + _bufferSize);
+			_streamChecksum = CCrc32c::calculate(_outputBuffer, _bufferSize, _streamChecksum);
+			_strm.next_out = _outputBuffer;
+			_strm.avail_out = _bufferSize;
 		}
 
-		// move any remaining data back to the beginning of the buffer
-		memmove(_inputBuffer, _strm.next_in, _strm.avail_in);
-		_inputBufferUsed = _strm.avail_in;
-
-		addBytes(data, numBytes);
+		lzma_ret ret = lzma_code(&_strm, LZMA_RUN);
+		if (ret != LZMA_OK)
+		{
+			throw ret;
+		}
 	}
 }
 
 void CXZCompress::writeAndEmptyBuffer(FILE* fh)
 {
+	fwrite(_pendingOutput.data(), 1, _pendingOutput.size(), fh);
+	_pendingOutput.clear();
+
 	uint32_t bytesUsed = _bufferSize - _strm.avail_out;
 
 	fwrite(_outputBuffer, 1, bytesUsed, fh);
+	_streamChecksum = CCrc32c::calculate(_outputBuffer, bytesUsed, _streamChecksum);
+
+	_strm.next_out = _outputBuffer;
+	_strm.avail_out = _bufferSize;
+}
+
+void CXZCompress::writeAndEmptyBuffer(std::vector<uint8_t>& destination)
+{
+	destination.insert(destination.end(), _pendingOutput.begin(), _pendingOutput.end());
+	_pendingOutput.clear();
+
+	uint32_t bytesUsed = _bufferSize - _strm.avail_out;
+
+	destination.insert(destination.end(), _outputBuffer, _outputBuffer + bytesUsed);
+	_streamChecksum = CCrc32c::calculate(_outputBuffer, bytesUsed, _streamChecksum);
 
 	_strm.next_out = _outputBuffer;
 	_strm.avail_out = _bufferSize;
@@ -125,13 +122,88 @@ bool CXZCompress::finish()
 	}
 
 	lzma_ret ret = lzma_code(&_strm, LZMA_FINISH);
+	if (ret != LZMA_OK && ret != LZMA_STREAM_END && ret != LZMA_BUF_ERROR)
+	{
+		throw ret;
+	}
 
 	return ret == LZMA_STREAM_END;
 }
 
+void CXZCompress::startNewStream()
+{
+	_previousStreamsBytesIn += _strm.total_in;
+	_previousStreamsBytesOut += _strm.total_out;
+
+	// liblzma reuses the encoder's memory when an existing stream is re-initialised
+	initEncoder();
+
+	_inputBufferUsed = 0;
+	_pendingOutput.clear();
+	_isFinishing = false;
+	_streamChecksum = 0;
+}
+
 float CXZCompress::getRatio() const
 {
-	float ratio = _strm.total_out / (float) _strm.total_in;
+	float ratio = (_previousStreamsBytesOut + _strm.total_out) / (float) (_previousStreamsBytesIn + _strm.total_in);
 	return ratio;
 }
 
+uint32_t CXZCompress::getDictionarySize() const
+{
+	return _dictionarySize;
+}
+
+uint32_t CXZCompress::getStreamChecksum() const
+{
+	return _streamChecksum;
+}
+
+void CXZCompress::initEncoder()
+{
+	// 3: Encoding: 282.4 / 283.6 MB processed, compressed size: 157.5 MB, ratio: 55.79% (75.00% trimming, 74.39% xz), rate = 1.83 MB/s, eta: 0.670191s
+	// 5: Encoding: 282.3 / 283.6 MB processed, compressed size: 147.4 MB, ratio: 52.22% (75.00% trimming, 69.62% xz), rate = 1.46 MB/s, eta: 0.889745s
+	// 9: Encoding: 283.4 / 283.6 MB processed, compressed size: 148.1 MB, ratio: 52.27% (75.00% trimming, 69.70% xz), rate = 1.07 MB/s, eta: 0.181572s
+	lzma_ret ret;
+	if (_dictionarySize == 0)
+	{
+		ret = lzma_easy_encoder(&_strm, 9, LZMA_CHECK_CRC64);
+	}
+	else
+	{
+		lzma_options_lzma options;
+		getOptions(_dictionarySize, options);
+		lzma_filter filters[2] = {{LZMA_FILTER_LZMA2, &options}, {LZMA_VLI_UNKNOWN, NULL}};
+		ret = lzma_stream_encoder(&_strm, filters, LZMA_CHECK_CRC64);
+	}
+
+	if (ret != LZMA_OK)
+	{
+		throw ret;
+	}
+}
+
+uint64_t CXZCompress::getMemoryUsage(uint32_t dictionarySize, uint32_t bufferSize)
+{
+	uint64_t lzmaBytes;
+	if (dictionarySize == 0)
+	{
+		lzmaBytes = lzma_easy_encoder_memusage(9);
+	}
+	else
+	{
+		lzma_options_lzma options;
+		getOptions(dictionarySize, options);
+		lzma_filter filters[2] = {{LZMA_FILTER_LZMA2, &options}, {LZMA_VLI_UNKNOWN, NULL}};
+		lzmaBytes = lzma_raw_encoder_memusage(filters);
+	}
+
+	return lzmaBytes + 2 * (uint64_t) bufferSize;
+}
+
+void CXZCompress::getOptions(uint32_t dictionarySize, lzma_options_lzma& options)
+{
+	lzma_lzma_preset(&options, 9);
+	options.dict_size = std::max<uint32_t>(dictionarySize, LZMA_DICT_SIZE_MIN);
+}
@@ -3,29 +3,55 @@
 
 #include <lzma.h>
 #include <stdio.h>
+#include <vector>
 
+// errors from liblzma are thrown as their lzma_ret
 class CXZCompress
 {
 public:
-	CXZCompress();
+	// a dictionarySize of 0 uses preset 9's (64 MiB), smaller ones keep the rest of preset 9 but need far less memory.
+	// There is no point in the dictionary being larger than a chunk, each chunk is a separate stream
+	CXZCompress(uint32_t dictionarySize = 0, uint32_t bufferSize = 512 * 1024);
 	virtual ~CXZCompress();
 
+	// bytes liblzma will allocate for an encoder, plus our buffers
+	static uint64_t getMemoryUsage(uint32_t dictionarySize, uint32_t bufferSize = 512 * 1024);
+
+	// takes all of data, whatever its size. Output which doesn't fit in the buffer is held until the next write
 	void addBytes(const uint8_t* data, uint32_t numBytes);
 	void writeAndEmptyBuffer(FILE* fh);
+	void writeAndEmptyBuffer(std::vector<uint8_t>& destination);
 
 	// call repeatedly until it returns true, write after each call
 	bool finish();
 
+	// once finish() has returned true, starts another xz stream which can be decoded independently of the previous ones
+	void startNewStream();
+
 	float getRatio() const;
+	uint32_t getDictionarySize() const;
+
+	// crc32c of everything written out for the current stream
+	uint32_t getStreamChecksum() const;
 
 private:
+	void initEncoder();
+	void code(const uint8_t* data, size_t numBytes);
+	static void getOptions(uint32_t dictionarySize, lzma_options_lzma& options);
+
 	uint8_t* _inputBuffer;
 	uint32_t _inputBufferUsed;
 	uint8_t* _outputBuffer;
+	std::vector<uint8_t> _pendingOutput;
 	uint32_t _bufferSize;
 	lzma_stream _strm;
+	uint32_t _dictionarySize;
 
 	bool _isFinishing;
+
+	uint64_t _previousStreamsBytesIn;
+	uint64_t _previousStreamsBytesOut;
+	uint32_t _streamChecksum;
 };
 
 #endif /* SRC_SNAP_COMPRESSOR_CXZCOMPRESS_H_ */
@@ -1,39 +1,33 @@
 #include "CXZDecompress.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
-CXZDecompress::CXZDecompress(FILE* fh) :
-		_dataSource(fh)
+#include "ADataSource.h"
+
+CXZDecompress::CXZDecompress(ADataSource* dataSource, uint64_t memoryLimit, uint32_t bufferSize) :
+		_dataSource(dataSource),
+		_memoryLimit(memoryLimit)
 {
 	_strm = LZMA_STREAM_INIT;
 
-	lzma_ret ret = lzma_stream_decoder(&_strm, 1e9, LZMA_TELL_UNSUPPORTED_CHECK);
-	switch (ret)
-	{
-		case LZMA_OK:
-			break;
-		case LZMA_MEM_ERROR:
-			fprintf(stderr, "LZMA memory error\n");
-			throw 1;
-		case LZMA_OPTIONS_ERROR:
-			fprintf(stderr, "Invalid LZMA options\n");
-			throw 1;
-		case LZMA_UNSUPPORTED_CHECK:
-			fprintf(stderr, "LZMA unsupported\n");
-			throw 1;
-		case LZMA_PROG_ERROR:
-			fprintf(stderr, "LZMA programming error\n");
-			throw 1;
-	}
-
-	_bufferSize = 1024 * 1024;
-	_inputBuffer = (uint8_t*) malloc(_bufferSize);
-	_outputBuffer = (uint8_t*) malloc(_bufferSize);
-	_outputBufferReadPointer = _outputBuffer;
-
-	_strm.next_out = _outputBuffer;
-	_strm.avail_out = _bufferSize;
+	initDecoder();
+
+	_inputBufferSize = bufferSize;
+	_inputBuffer = (uint8_t*) malloc(_inputBufferSize);
+
+	_ringSize = bufferSize;
+	_spillSize = 0;
+	_ringBuffer = (uint8_t*) malloc(_ringSize);
+	_readPosition = 0;
+	_bytesAvailable = 0;
+
+	_outputPending = false;
+	_isStreamEnd = false;
+	_isAwaitingNextStream = false;
+	_previousStreamsBytesIn = 0;
+	_previousStreamsBytesOut = 0;
 
 	_strm.next_in = _inputBuffer;
 	_strm.avail_in = 0;
@@ -43,102 +37,268 @@ CXZDecompress::~CXZDecompress()
 {
 	lzma_end(&_strm);
 	free(_inputBuffer);
-	free(_outputBuffer);
+	free(_ringBuffer);
 }
 
 uint32_t CXZDecompress::getNumDecompressedBytesAvailable() const
 {
-	return _strm.next_out - _outputBufferReadPointer;
+	return _bytesAvailable;
 }
 
 size_t CXZDecompress::getInputByteCount() const
 {
-	return _strm.total_in;
+	return _previousStreamsBytesIn + _strm.total_in;
 }
 
 size_t CXZDecompress::getOutputByteCount() const
 {
-	return _strm.total_out;
+	return _previousStreamsBytesOut + _strm.total_out;
 }
 
 bool CXZDecompress::consumeBytes(char* data, uint32_t bytesToRead)
 {
-	while (getNumDecompressedBytesAvailable() < bytesToRead)
+	const uint8_t* view = peekBytes(bytesToRead);
+	if (!view)
+	{
+		return false;
+	}
+
+	memcpy(data, view, bytesToRead);
+	advance(bytesToRead);
+
+	return true;
+}
+
+const uint8_t* CXZDecompress::peekBytes(uint32_t bytesToRead)
+{
+	if (bytesToRead > _ringSize)
 	{
-		resetOutputBuffer();
+		growRingBuffer(bytesToRead);
+	}
 
-		if (_strm.avail_in == 0)
+	while (_bytesAvailable < bytesToRead)
+	{
+		if (!decompressMore())
 		{
-			if (!readDataFromFile())
-			{
-				// no more data available
-				return false;
-			}
+			// no more data available
+			return NULL;
 		}
+	}
 
-		lzma_ret ret = lzma_code(&_strm, LZMA_RUN);
+	uint8_t* view = _ringBuffer + _readPosition;
 
-		switch (ret)
+	if (_readPosition + bytesToRead > _ringSize)
+	{
+		// the block straddles the end of the ring, copy the part which wrapped around into the spill area
+		uint32_t bytesWrapped = _readPosition + bytesToRead - _ringSize;
+		if (bytesWrapped > _spillSize)
 		{
-			case LZMA_OK:
-//				fprintf(stderr, "LZMA OK\n");
-				break;
-			case LZMA_STREAM_END:
-				fprintf(stderr, "LZMA stream end\n");
-				break;
-			case LZMA_BUF_ERROR:
-				fprintf(stderr, "LZMA buf error\n");
-				break;
-			case LZMA_MEM_ERROR:
-				fprintf(stderr, "LZMA memory error\n");
-				throw 1;
-			case LZMA_OPTIONS_ERROR:
-				fprintf(stderr, "Invalid LZMA options\n");
-				throw 1;
-			case LZMA_UNSUPPORTED_CHECK:
-				fprintf(stderr, "LZMA unsupported\n");
-				throw 1;
-			case LZMA_DATA_ERROR:
-				fprintf(stderr, "LZMA data is corrupted\n");
-				throw 1;
-			case LZMA_PROG_ERROR:
-				fprintf(stderr, "LZMA programming error\n");
-				throw 1;
+			_spillSize = bytesWrapped;
+			_ringBuffer = (uint8_t*) realloc(_ringBuffer, _ringSize + _spillSize);
+			view = _ringBuffer + _readPosition;
 		}
+		memcpy(_ringBuffer + _ringSize, _ringBuffer, bytesWrapped);
 	}
 
-	memcpy(data, _outputBufferReadPointer, bytesToRead);
-	_outputBufferReadPointer += bytesToRead;
+	return view;
+}
 
-	return true;
+void CXZDecompress::advance(uint32_t bytesToSkip)
+{
+	if (bytesToSkip > _bytesAvailable)
+	{
+		bytesToSkip = _bytesAvailable;
+	}
 
+	_readPosition = (_readPosition + bytesToSkip) % _ringSize;
+	_bytesAvailable -= bytesToSkip;
+
+	if (_bytesAvailable == 0)
+	{
+		// keep the next refill contiguous
+		_readPosition = 0;
+	}
 }
 
-void CXZDecompress::resetOutputBuffer()
+bool CXZDecompress::isFinished() const
 {
-	uint32_t bytesAvailable = getNumDecompressedBytesAvailable();
-	memmove(_outputBuffer, _outputBufferReadPointer, bytesAvailable);
-	_strm.next_out = _outputBuffer + bytesAvailable;
-	_strm.avail_out = _bufferSize;
-	_outputBufferReadPointer = _outputBuffer;
+	return _isStreamEnd;
 }
 
-bool CXZDecompress::readDataFromFile()
+void CXZDecompress::reset()
 {
-	// move existing data back to the front of the buffer
-	memmove(_inputBuffer, _strm.next_in, _strm.avail_in);
+	initDecoder();
+
+	_readPosition = 0;
+	_bytesAvailable = 0;
+	_outputPending = false;
+	_isStreamEnd = false;
+	_isAwaitingNextStream = false;
+	_previousStreamsBytesIn = 0;
+	_previousStreamsBytesOut = 0;
+
 	_strm.next_in = _inputBuffer;
+	_strm.avail_in = 0;
+}
+
+bool CXZDecompress::decompressMore()
+{
+	if (_isAwaitingNextStream && !startNextStream())
+	{
+		return false;
+	}
+
+	if (_isStreamEnd)
+	{
+		return false;
+	}
+
+	if (_strm.avail_in == 0 && !readDataFromFile() && !_outputPending)
+	{
+		// in the middle of a stream, so the input is cut short unless more may still arrive
+		if (_dataSource->isFinished())
+		{
+			throw LZMA_BUF_ERROR;
+		}
+		return false;
+	}
+
+	// decompress straight into the free part of the ring, up to the point where it wraps around
+	uint32_t writePosition = (_readPosition + _bytesAvailable) % _ringSize;
+	uint32_t bytesFree = _ringSize - _bytesAvailable;
+	uint32_t contiguousBytesFree = std::min(bytesFree, _ringSize - writePosition);
+
+	_strm.next_out = _ringBuffer + writePosition;
+	_strm.avail_out = contiguousBytesFree;
 
-	int bytesRead = fread(_inputBuffer + _strm.avail_in, 1, _bufferSize - _strm.avail_in, _dataSource);
-	if (bytesRead > 0)
+	lzma_ret ret = lzma_code(&_strm, LZMA_RUN);
+
+	_bytesAvailable += contiguousBytesFree - _strm.avail_out;
+	_outputPending = _strm.avail_out == 0;
+
+	switch (ret)
+	{
+		case LZMA_OK:
+			break;
+		case LZMA_STREAM_END:
+			// files are a series of independent xz streams, anything else (e.g. the seek index) ends the data
+			_isAwaitingNextStream = true;
+			break;
+		case LZMA_BUF_ERROR:
+			// no progress possible, the input is cut short unless more may still arrive
+			if (_dataSource->isFinished())
+			{
+				throw ret;
+			}
+			return false;
+		default:
+			throw ret;
+	}
+
+	return true;
+}
+
+bool CXZDecompress::startNextStream()
+{
+	static const uint8_t xzMagic[6] = {0xFD, '7', 'z', 'X', 'Z', 0x00};
+
+	if (_strm.avail_in < sizeof(xzMagic))
 	{
-		_strm.avail_in += bytesRead;
+		readDataFromFile();
+	}
+
+	if (_strm.avail_in < sizeof(xzMagic))
+	{
+		// if the data source might get more data later we can't tell yet
+		if (_dataSource->isFinished())
+		{
+			_isAwaitingNextStream = false;
+			_isStreamEnd = true;
+		}
+		return false;
 	}
 
-	if (bytesRead <= 0)
+	_isAwaitingNextStream = false;
+
+	if (memcmp(_strm.next_in, xzMagic, sizeof(xzMagic)) != 0)
 	{
+		_isStreamEnd = true;
 		return false;
 	}
+
+	_previousStreamsBytesIn += _strm.total_in;
+	_previousStreamsBytesOut += _strm.total_out;
+	initDecoder();
+
 	return true;
 }
 
+void CXZDecompress::initDecoder()
+{
+	lzma_ret ret = lzma_stream_decoder(&_strm, _memoryLimit, LZMA_TELL_UNSUPPORTED_CHECK);
+	if (ret != LZMA_OK)
+	{
+		throw ret;
+	}
+}
+
+uint32_t CXZDecompress::getDictionarySize(const uint8_t* data, size_t numBytes)
+{
+	lzma_stream_flags flags;
+	if (numBytes <= LZMA_STREAM_HEADER_SIZE || lzma_stream_header_decode(&flags, data) != LZMA_OK)
+	{
+		return 0;
+	}
+
+	// a 0 where the block header's size should be is the start of the index instead
+	const uint8_t* blockHeader = data + LZMA_STREAM_HEADER_SIZE;
+	lzma_filter filters[LZMA_FILTERS_MAX + 1];
+	lzma_block block;
+	memset(&block, 0, sizeof(block));
+	block.version = 0;
+	block.check = flags.check;
+	block.filters = filters;
+	block.header_size = lzma_block_header_size_decode(blockHeader[0]);
+	if (blockHeader[0] == 0 || numBytes < LZMA_STREAM_HEADER_SIZE + block.header_size || lzma_block_header_decode(&block, NULL, blockHeader) != LZMA_OK)
+	{
+		return 0;
+	}
+
+	uint32_t dictionarySize = 0;
+	for (uint32_t i = 0; filters[i].id != LZMA_VLI_UNKNOWN; i++)
+	{
+		if (filters[i].id == LZMA_FILTER_LZMA2)
+		{
+			dictionarySize = static_cast<lzma_options_lzma*>(filters[i].options)->dict_size;
+		}
+		free(filters[i].options);
+	}
+	return dictionarySize;
+}
+
+void CXZDecompress::growRingBuffer(uint32_t minimumSize)
+{
+	// linearise the data that is already decompressed into the new, larger ring
+	uint8_t* newRing = (uint8_t*) malloc(minimumSize);
+	uint32_t firstPart = std::min(_bytesAvailable, _ringSize - _readPosition);
+	memcpy(newRing, _ringBuffer + _readPosition, firstPart);
+	memcpy(newRing + firstPart, _ringBuffer, _bytesAvailable - firstPart);
+
+	free(_ringBuffer);
+	_ringBuffer = newRing;
+	_ringSize = minimumSize;
+	_spillSize = 0;
+	_readPosition = 0;
+}
+
+bool CXZDecompress::readDataFromFile()
+{
+	// move existing data back to the front of the buffer
+	memmove(_inputBuffer, _strm.next_in, _strm.avail_in);
+	_strm.next_in = _inputBuffer;
+
+	size_t bytesRead = _dataSource->read(_inputBuffer + _strm.avail_in, _inputBufferSize - _strm.avail_in);
+	_strm.avail_in += bytesRead;
+
+	return bytesRead > 0;
+}
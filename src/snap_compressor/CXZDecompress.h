@@ -4,28 +4,63 @@
 #include <lzma.h>
 #include <stdio.h>
 
+class ADataSource;
+
+// errors from liblzma are thrown as their lzma_ret
 class CXZDecompress
 {
 public:
-	CXZDecompress(FILE* fh);
+	// streams needing more than memoryLimit bytes of liblzma memory (essentially their dictionary) fail with LZMA_MEMLIMIT_ERROR
+	CXZDecompress(ADataSource* dataSource, uint64_t memoryLimit = 1e9, uint32_t bufferSize = 1024 * 1024);
 	virtual ~CXZDecompress();
 
 	uint32_t getNumDecompressedBytesAvailable() const;
 	bool consumeBytes(char* data, uint32_t bytesToRead);
 
+	// returns a view of the next bytesToRead decompressed bytes without copying them out of the ring buffer,
+	// or NULL if the stream ends first. The view is only valid until the next call to peekBytes/consumeBytes.
+	const uint8_t* peekBytes(uint32_t bytesToRead);
+	void advance(uint32_t bytesToSkip);
+
+	// true once the last stream has ended, rather than the data source just running dry for now
+	bool isFinished() const;
+
+	// throws away all buffered data, e.g. after the data source has been moved to another chunk
+	void reset();
+
 	size_t getInputByteCount() const;
 	size_t getOutputByteCount() const;
 
+	// the LZMA2 dictionary size from the header of the first block of the xz stream at data, which is what decoding it
+	// needs memory for. 0 if numBytes doesn't reach the end of that header or the stream has no blocks
+	static uint32_t getDictionarySize(const uint8_t* data, size_t numBytes);
+
 private:
-	void resetOutputBuffer();
+	void initDecoder();
+	bool decompressMore();
+	bool startNextStream();
 	bool readDataFromFile();
+	void growRingBuffer(uint32_t minimumSize);
 
-	FILE* _dataSource;
+	ADataSource* _dataSource;
+	uint64_t _memoryLimit;
 
 	uint8_t* _inputBuffer;
-	uint8_t* _outputBuffer;
-	uint8_t* _outputBufferReadPointer;
-	uint32_t _bufferSize;
+	uint32_t _inputBufferSize;
+
+	// decompressed data lives in a ring, _ringBuffer has _ringSize bytes plus a spill area after the end where
+	// blocks which wrap around are made contiguous
+	uint8_t* _ringBuffer;
+	uint32_t _ringSize;
+	uint32_t _spillSize;
+	uint32_t _readPosition;
+	uint32_t _bytesAvailable;
+
+	bool _outputPending;
+	bool _isStreamEnd;
+	bool _isAwaitingNextStream;
+	uint64_t _previousStreamsBytesIn;
+	uint64_t _previousStreamsBytesOut;
 	lzma_stream _strm;
 };
 
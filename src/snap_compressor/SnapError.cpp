@@ -0,0 +1,55 @@
+#include "SnapError.h"
+
+const char* getSnapErrorString(ESnapError error)
+{
+	switch (error)
+	{
+		case SNAP_OK:
+			return "OK";
+		case SNAP_ERROR_INVALID_PARAMETER:
+			return "Invalid parameter";
+		case SNAP_ERROR_INVALID_STATE:
+			return "Call not valid in the current state";
+		case SNAP_ERROR_INVALID_HEADER:
+			return "Invalid file header";
+		case SNAP_ERROR_CHECKSUM:
+			return "Checksum mismatch";
+		case SNAP_ERROR_UNSUPPORTED:
+			return "Unsupported file version or backend";
+		case SNAP_ERROR_CORRUPT_DATA:
+			return "Compressed data is corrupted";
+		case SNAP_ERROR_OUT_OF_MEMORY:
+			return "Out of memory";
+		case SNAP_ERROR_NO_INDEX:
+			return "File has no seek index";
+		case SNAP_ERROR_OUT_OF_RANGE:
+			return "Position is past the end of the file";
+		case SNAP_ERROR_BACKEND:
+			return "Compression backend error";
+		case SNAP_ERROR_IO:
+			return "Cannot read or write file";
+	}
+	return "Unknown error";
+}
+
+ESnapError getSnapErrorFromLzma(lzma_ret ret)
+{
+	switch (ret)
+	{
+		case LZMA_OK:
+		case LZMA_STREAM_END:
+			return SNAP_OK;
+		case LZMA_MEM_ERROR:
+		case LZMA_MEMLIMIT_ERROR:
+			return SNAP_ERROR_OUT_OF_MEMORY;
+		case LZMA_FORMAT_ERROR:
+		case LZMA_DATA_ERROR:
+		case LZMA_BUF_ERROR:
+			return SNAP_ERROR_CORRUPT_DATA;
+		case LZMA_UNSUPPORTED_CHECK:
+		case LZMA_OPTIONS_ERROR:
+			return SNAP_ERROR_UNSUPPORTED;
+		default:
+			return SNAP_ERROR_BACKEND;
+	}
+}
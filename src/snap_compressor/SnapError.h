@@ -0,0 +1,27 @@
+#ifndef SRC_SNAP_COMPRESSOR_SNAPERROR_H_
+#define SRC_SNAP_COMPRESSOR_SNAPERROR_H_
+
+#include <lzma.h>
+
+enum ESnapError
+{
+	SNAP_OK = 0,
+	SNAP_ERROR_INVALID_PARAMETER,
+	SNAP_ERROR_INVALID_STATE,
+	SNAP_ERROR_INVALID_HEADER,
+	SNAP_ERROR_CHECKSUM,
+	SNAP_ERROR_UNSUPPORTED,
+	SNAP_ERROR_CORRUPT_DATA,
+	SNAP_ERROR_OUT_OF_MEMORY,
+	SNAP_ERROR_NO_INDEX,
+	SNAP_ERROR_OUT_OF_RANGE,
+	SNAP_ERROR_BACKEND,
+	SNAP_ERROR_IO
+};
+
+const char* getSnapErrorString(ESnapError error);
+
+// CXZCompress and CXZDecompress throw the lzma_ret of whatever went wrong, this maps it for the library interface
+ESnapError getSnapErrorFromLzma(lzma_ret ret);
+
+#endif /* SRC_SNAP_COMPRESSOR_SNAPERROR_H_ */
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cinttypes>
 #include <complex>
 #include <cstdio>
@@ -6,27 +7,110 @@
 #include <vector>
 #include <cstring>
 #include <ctime>
+#include <fcntl.h>
+#include <glob.h>
+#include <string>
 #include <sys/stat.h>
 
+#include "CBatchEncoder.h"
 #include "CDiscreteCosineTransform.h"
-#include "CXZCompress.h"
-#include "CXZDecompress.h"
+#include "CMemoryPlanner.h"
+#include "CQuantisationTable.h"
+#include "CSampleFormat.h"
+#include "CSeekIndex.h"
+#include "CSignalComparison.h"
+#include "CSnapDecoder.h"
+#include "CSnapEncoder.h"
+#include "CSnapHeader.h"
+#include "CStatistics.h"
+#include "CCrc32c.h"
 
-void encode(const char* inputFileName, uint32_t blockSize, float quantisationFactor, uint32_t binsToKeep);
-void decode(const char* inputFileName, const char* outputFileName);
+// what encode and encode-batch have in common on the command line
+struct EncodeOptions
+{
+	uint32_t blockSize;
+	float quantisationFactor;
+	uint32_t binsToKeep;
+	uint32_t blocksPerChunk;
+	bool isLossless;
+	uint32_t maxError;
+	uint32_t baseBins;
+	float silenceThreshold;
+	std::vector<float> quantisationTable;
+	uint64_t memoryBudget;
+};
+
+void encode(const char* inputFileName, uint32_t blockSize, float quantisationFactor, uint32_t binsToKeep, uint32_t blocksPerChunk, bool isLossless, uint32_t maxError, uint32_t baseBins, float silenceThreshold, const std::vector<float>& quantisationTable, CSnapHeader& header, CSampleFormat::EFormat inputFormat, float inputScale, uint64_t memoryBudget, const char* statsFileName);
+void decode(const char* inputFileName, const char* outputFileName, uint64_t startSample, uint64_t sampleCount, uint32_t decimation, bool isBaseLayerOnly, bool isNoiseFill, uint64_t memoryBudget, const char* statsFileName);
+void encodeBatch(const std::vector<std::string>& inputFileNames, uint32_t blockSize, float quantisationFactor, uint32_t binsToKeep, uint32_t blocksPerChunk, bool isLossless, uint32_t maxError, uint32_t baseBins, float silenceThreshold, const std::vector<float>& quantisationTable, uint32_t numThreads, uint64_t memoryBudget, const char* reportFileName);
+void spectrum(const char* inputFileName, const char* outputFileName, uint32_t numColumns, uint32_t blocksPerSlice, uint64_t startSample, uint64_t sampleCount);
+void info(const char* inputFileName, bool verify);
+void stats(const char* inputFileName, uint32_t blockSize, uint32_t binsToKeep, const char* tableFileName, float snr, uint32_t numBlocks, uint32_t numBands);
+void compare(const char* referenceFileName, const char* testFileName, uint32_t numBands, bool isJson);
+void openDecoder(CSnapDecoder& decoder, FILE* fh);
+void seekDecoder(CSnapDecoder& decoder, uint64_t sample);
+void readMetadataFile(const char* fileName, CSnapHeader& header);
+void readQuantisationTable(const char* fileName, std::vector<float>& weights);
+void parseEncodeParameters(char** parameters, EncodeOptions& options);
+bool parseEncodeOption(int argc, char** argv, int& i, EncodeOptions& options);
+void finishEncodeOptions(EncodeOptions& options);
+void addInputFiles(const char* pattern, std::vector<std::string>& fileNames);
+void readInputList(const char* listFileName, std::vector<std::string>& fileNames);
+void writeJsonString(FILE* fh, const std::string& text);
 
 namespace
 {
-const uint8_t magic[4] = {0xB0, 0xBD, 0xC7, 0x01};
+// target size of the coefficients in each independently decodable chunk, bounds the work needed to seek
+const uint32_t defaultChunkBytes = 1024 * 1024;
+
+// samples read from each file at once by compare, big reads keep the kernels fed
+const uint32_t compareReadSamples = 4 * 1024 * 1024;
+
+const uint8_t spectrumMagic[4] = {'S', 'N', 'S', 'P'};
 }
 
 void usage(const char* argv0)
 {
-	fprintf(stderr, "Usage: %s encode snapshot.8t block_size quantisation_percent cut_off_freq_percent\n", argv0);
-	fprintf(stderr, "Usage: %s decode encoded.roundedQuantisedDCT decoded.8t\n", argv0);
+	fprintf(stderr, "Usage: %s encode snapshot.8t block_size quantisation_percent cut_off_freq_percent [--chunk-blocks n] [--sample-rate hz] [--centre-freq hz] [--timestamp t] [--stats stats.json] [--max-memory bytes] [--input-format f] [--input-scale s] [--lossless] [--max-error k] [--layered base_percent] [--silence rms] [--quantisation-table table.txt]\n", argv0);
+	fprintf(stderr, "Usage: %s encode-batch block_size quantisation_percent cut_off_freq_percent [--chunk-blocks n] [--threads n] [--list files.txt] [--report report.json] [--max-memory bytes] [--lossless] [--max-error k] [--layered base_percent] [--silence rms] [--quantisation-table table.txt] snapshot.8t...\n", argv0);
+	fprintf(stderr, "Usage: %s decode encoded.roundedQuantisedDCT decoded.8t [--start-sample n] [--count n] [--decimate n] [--layers base|all] [--silence zero|noise] [--stats stats.json] [--max-memory bytes]\n", argv0);
+	fprintf(stderr, "Usage: %s spectrum encoded.roundedQuantisedDCT spectrum.csv|spectrum.bin [--columns n] [--blocks-per-slice n] [--start-sample n] [--count n]\n", argv0);
+	fprintf(stderr, "Usage: %s info encoded.roundedQuantisedDCT [--verify]\n", argv0);
+	fprintf(stderr, "Usage: %s stats snapshot.8t block_size cut_off_freq_percent table.txt [--snr db] [--blocks n] [--bands n]\n", argv0);
+	fprintf(stderr, "Usage: %s compare reference.8t decoded.8t [--bands n] [--json]\n", argv0);
 	fprintf(stderr, "\tquantisation_percent (lossy) is a scaling factor applied to all DCT values, to help with entropy encoding\n");
 	fprintf(stderr, "\tblock_size (lossless ish) is the DCT size, larger values give better fractionally compression, but operation is O(n^2)\n");
 	fprintf(stderr, "\tcut_off_freq_percent can be used to filter high frequency components, specify the bandwidth percent to preserve\n");
+	fprintf(stderr, "\t--lossless codes the samples exactly with an integer DCT and a Rice coder instead of quantising and xz, quantisation_percent\n");
+	fprintf(stderr, "\t\tand cut_off_freq_percent are ignored. block_size must be a power of two up to 65536, the file can't be decimated\n");
+	fprintf(stderr, "\t--max-error is near lossless: the same integer DCT and Rice coder, quantised and cut off as usual, plus the residual so\n");
+	fprintf(stderr, "\t\tno decoded sample is more than k (0 to 255) off. Same block size rule, no decimation\n");
+	fprintf(stderr, "\t--layered stores the bins below base_percent of the block first in each chunk and the rest after them, so decode\n");
+	fprintf(stderr, "\t\t--layers base can preview the file from a fraction of it. --decimate down to the base layer only reads that too\n");
+	fprintf(stderr, "\t--silence skips the DCT for blocks whose RMS (per I or Q sample, up to 31) is below rms and stores only the RMS, so\n");
+	fprintf(stderr, "\t\tidle stretches cost almost nothing. decode --silence fills them with zeros (the default) or noise of that RMS\n");
+	fprintf(stderr, "\t--quantisation-table scales quantisation_percent for each bin (or band of bins) by the weights in table.txt\n");
+	fprintf(stderr, "\t--chunk-blocks sets how many blocks are compressed together, decode can only seek to the start of a chunk\n");
+	fprintf(stderr, "\t--sample-rate, --centre-freq and --timestamp are stored in the header, by default they are read from snapshot.8t.meta if it exists\n");
+	fprintf(stderr, "\t--input-format reads 8t (int8 IQ), int16, int32 or float32 IQ, or sdriq (the default for .sdriq files) without converting\n");
+	fprintf(stderr, "\t\tto .8t first. Samples are multiplied by --input-scale, by default 127 / the largest value in the file\n");
+	fprintf(stderr, "\tencode-batch encodes every snapshot (or quoted glob pattern, or line of --list, - for stdin) on a pool of --threads\n");
+	fprintf(stderr, "\t\tworkers (default one per core), --max-memory is shared between them. It prints each file's ratio and throughput,\n");
+	fprintf(stderr, "\t\t--report also writes them as JSON\n");
+	fprintf(stderr, "\tinfo prints the header and seek index, --verify checks the checksum of every chunk without decompressing it\n");
+	fprintf(stderr, "\tstats measures the DCT coefficients of --blocks (default 1024) blocks spread over snapshot.8t and writes the per band\n");
+	fprintf(stderr, "\t\tweights for --quantisation-table that reach --snr (default 30 dB) in the fewest bits. --bands defaults to one per bin.\n");
+	fprintf(stderr, "\t\tIt prints the quantisation_percent to encode with, and the single one that would be needed without a table\n");
+	fprintf(stderr, "\t--start-sample and --count decode only part of the snapshot, using the seek index to skip straight to it\n");
+	fprintf(stderr, "\tspectrum writes the mean power per bin of the DCT coefficients in each frequency column for each slice of blocks, without decoding.\n");
+	fprintf(stderr, "\t\tDCT bin k is at +/- k * sample_rate / (2 * block_size), positive and negative frequencies are folded together.\n");
+	fprintf(stderr, "\t\tCSV rows are first_sample,power...; otherwise binary: 'SNSP', columns, bins_per_column, blocks_per_slice, block_size (u32),\n");
+	fprintf(stderr, "\t\tthen per slice first_sample (u64) and columns float32 powers\n");
+	fprintf(stderr, "\t--decimate reconstructs at 1/n of the sample rate from the low DCT bins only, n must divide block_size\n");
+	fprintf(stderr, "\t--stats writes the time spent in each stage and the block/byte/overflow counts as JSON, every second and at exit\n");
+	fprintf(stderr, "\t--max-memory (e.g. 64M) fits the xz dictionary, DCT strategy and buffers into a budget and prints the plan\n");
+	fprintf(stderr, "\tcompare reports the SNR, EVM and largest error of decoded.8t against reference.8t, and the signal and error\n");
+	fprintf(stderr, "\t\tpower in n frequency bands (default 16, 0 is fastest), as text or a JSON object\n");
 	exit(1);
 }
 
@@ -39,28 +123,296 @@ int main(int argc, char** argv)
 
 	if (strcmp(argv[1], "encode") == 0)
 	{
-		if (argc != 6)
+		if (argc < 6)
 		{
 			usage(argv[0]);
 		}
 		const char* inputFileName = argv[2];
-		uint32_t blockSize = strtoul(argv[3], NULL, 10);
-		float quantisationFactor = strtof(argv[4], NULL) / 100.0f;
-		float cutOffFreq = strtof(argv[5], NULL) / 100.0f;
-		uint32_t binsToKeep = ceilf(blockSize * cutOffFreq);
+		EncodeOptions options;
+		parseEncodeParameters(argv + 3, options);
+		const char* statsFileName = NULL;
+		CSampleFormat::EFormat inputFormat = CSampleFormat::getFormatFromFileName(inputFileName);
+		float inputScale = 0.0f;
+
+		// capture metadata comes from the converter's sidecar file (or the sdriq header) unless it is given on the command line
+		CSnapHeader header;
+		{
+			char metadataFileName[1024];
+			snprintf(metadataFileName, sizeof(metadataFileName), "%s.meta", inputFileName);
+			readMetadataFile(metadataFileName, header);
+		}
+
+		for (int i = 6; i < argc; i++)
+		{
+			bool hasValue = i + 1 < argc;
+			if (parseEncodeOption(argc, argv, i, options))
+			{
+				continue;
+			}
+			if (strcmp(argv[i], "--sample-rate") == 0 && hasValue)
+			{
+				header.setUint32(CSnapHeader::TAG_SAMPLE_RATE, strtoul(argv[++i], NULL, 10));
+			}
+			else if (strcmp(argv[i], "--centre-freq") == 0 && hasValue)
+			{
+				header.setUint64(CSnapHeader::TAG_CENTRE_FREQUENCY, strtoull(argv[++i], NULL, 10));
+			}
+			else if (strcmp(argv[i], "--timestamp") == 0 && hasValue)
+			{
+				header.setUint64(CSnapHeader::TAG_TIMESTAMP, strtoull(argv[++i], NULL, 10));
+			}
+			else if (strcmp(argv[i], "--stats") == 0 && hasValue)
+			{
+				statsFileName = argv[++i];
+			}
+			else if (strcmp(argv[i], "--input-format") == 0 && hasValue)
+			{
+				if (!CSampleFormat::parse(argv[++i], inputFormat))
+				{
+					usage(argv[0]);
+				}
+			}
+			else if (strcmp(argv[i], "--input-scale") == 0 && hasValue)
+			{
+				inputScale = strtof(argv[++i], NULL);
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+		}
 
-		encode(inputFileName, blockSize, quantisationFactor, binsToKeep);
+		finishEncodeOptions(options);
+
+		encode(inputFileName, options.blockSize, options.quantisationFactor, options.binsToKeep, options.blocksPerChunk, options.isLossless, options.maxError, options.baseBins, options.silenceThreshold, options.quantisationTable, header, inputFormat, inputScale, options.memoryBudget, statsFileName);
+	}
+	else if (strcmp(argv[1], "encode-batch") == 0)
+	{
+		if (argc < 5)
+		{
+			usage(argv[0]);
+		}
+		EncodeOptions options;
+		parseEncodeParameters(argv + 2, options);
+		uint32_t numThreads = 0;
+		const char* reportFileName = NULL;
+		std::vector<std::string> inputFileNames;
+
+		for (int i = 5; i < argc; i++)
+		{
+			bool hasValue = i + 1 < argc;
+			if (parseEncodeOption(argc, argv, i, options))
+			{
+				continue;
+			}
+			if (strcmp(argv[i], "--threads") == 0 && hasValue)
+			{
+				numThreads = strtoul(argv[++i], NULL, 10);
+			}
+			else if (strcmp(argv[i], "--list") == 0 && hasValue)
+			{
+				readInputList(argv[++i], inputFileNames);
+			}
+			else if (strcmp(argv[i], "--report") == 0 && hasValue)
+			{
+				reportFileName = argv[++i];
+			}
+			else if (strncmp(argv[i], "--", 2) == 0)
+			{
+				usage(argv[0]);
+			}
+			else
+			{
+				addInputFiles(argv[i], inputFileNames);
+			}
+		}
+
+		if (inputFileNames.empty())
+		{
+			usage(argv[0]);
+		}
+		finishEncodeOptions(options);
+
+		encodeBatch(inputFileNames, options.blockSize, options.quantisationFactor, options.binsToKeep, options.blocksPerChunk, options.isLossless, options.maxError, options.baseBins, options.silenceThreshold, options.quantisationTable, numThreads, options.memoryBudget, reportFileName);
 	}
 	else if (strcmp(argv[1], "decode") == 0)
 	{
-		if (argc != 4)
+		if (argc < 4 || argc % 2 != 0)
+		{
+			usage(argv[0]);
+		}
+		const char* inputFileName = argv[2];
+		const char* ouputFileName = argv[3];
+		uint64_t startSample = 0;
+		uint64_t sampleCount = UINT64_MAX;
+		uint32_t decimation = 1;
+		bool isBaseLayerOnly = false;
+		bool isNoiseFill = false;
+		const char* statsFileName = NULL;
+		uint64_t memoryBudget = 0;
+
+		for (int i = 4; i < argc; i += 2)
+		{
+			if (strcmp(argv[i], "--start-sample") == 0)
+			{
+				startSample = strtoull(argv[i + 1], NULL, 10);
+			}
+			else if (strcmp(argv[i], "--count") == 0)
+			{
+				sampleCount = strtoull(argv[i + 1], NULL, 10);
+			}
+			else if (strcmp(argv[i], "--decimate") == 0)
+			{
+				decimation = strtoul(argv[i + 1], NULL, 10);
+			}
+			else if (strcmp(argv[i], "--layers") == 0 && (strcmp(argv[i + 1], "base") == 0 || strcmp(argv[i + 1], "all") == 0))
+			{
+				isBaseLayerOnly = strcmp(argv[i + 1], "base") == 0;
+			}
+			else if (strcmp(argv[i], "--silence") == 0 && (strcmp(argv[i + 1], "zero") == 0 || strcmp(argv[i + 1], "noise") == 0))
+			{
+				isNoiseFill = strcmp(argv[i + 1], "noise") == 0;
+			}
+			else if (strcmp(argv[i], "--stats") == 0)
+			{
+				statsFileName = argv[i + 1];
+			}
+			else if (strcmp(argv[i], "--max-memory") == 0)
+			{
+				if (!CMemoryPlanner::parseSize(argv[i + 1], memoryBudget))
+				{
+					usage(argv[0]);
+				}
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+		}
+
+		decode(inputFileName, ouputFileName, startSample, sampleCount, decimation, isBaseLayerOnly, isNoiseFill, memoryBudget, statsFileName);
+	}
+	else if (strcmp(argv[1], "spectrum") == 0)
+	{
+		if (argc < 4 || argc % 2 != 0)
 		{
 			usage(argv[0]);
 		}
 		const char* inputFileName = argv[2];
 		const char* ouputFileName = argv[3];
+		uint32_t numColumns = 0;
+		uint32_t blocksPerSlice = 16;
+		uint64_t startSample = 0;
+		uint64_t sampleCount = UINT64_MAX;
+
+		for (int i = 4; i < argc; i += 2)
+		{
+			if (strcmp(argv[i], "--columns") == 0)
+			{
+				numColumns = strtoul(argv[i + 1], NULL, 10);
+			}
+			else if (strcmp(argv[i], "--blocks-per-slice") == 0)
+			{
+				blocksPerSlice = strtoul(argv[i + 1], NULL, 10);
+			}
+			else if (strcmp(argv[i], "--start-sample") == 0)
+			{
+				startSample = strtoull(argv[i + 1], NULL, 10);
+			}
+			else if (strcmp(argv[i], "--count") == 0)
+			{
+				sampleCount = strtoull(argv[i + 1], NULL, 10);
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+		}
+
+		if (blocksPerSlice == 0)
+		{
+			usage(argv[0]);
+		}
+
+		spectrum(inputFileName, ouputFileName, numColumns, blocksPerSlice, startSample, sampleCount);
+	}
+	else if (strcmp(argv[1], "info") == 0)
+	{
+		if (argc == 3)
+		{
+			info(argv[2], false);
+		}
+		else if (argc == 4 && strcmp(argv[3], "--verify") == 0)
+		{
+			info(argv[2], true);
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+	else if (strcmp(argv[1], "stats") == 0)
+	{
+		if (argc < 6 || argc % 2 != 0)
+		{
+			usage(argv[0]);
+		}
+		const char* inputFileName = argv[2];
+		uint32_t blockSize = strtoul(argv[3], NULL, 10);
+		uint32_t binsToKeep = ceilf(blockSize * strtof(argv[4], NULL) / 100.0f);
+		const char* tableFileName = argv[5];
+		float snr = 30.0f;
+		uint32_t numBlocks = 1024;
+		uint32_t numBands = 0;
+
+		for (int i = 6; i < argc; i += 2)
+		{
+			if (strcmp(argv[i], "--snr") == 0)
+			{
+				snr = strtof(argv[i + 1], NULL);
+			}
+			else if (strcmp(argv[i], "--blocks") == 0)
+			{
+				numBlocks = strtoul(argv[i + 1], NULL, 10);
+			}
+			else if (strcmp(argv[i], "--bands") == 0)
+			{
+				numBands = strtoul(argv[i + 1], NULL, 10);
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+		}
+
+		stats(inputFileName, blockSize, binsToKeep, tableFileName, snr, numBlocks, numBands);
+	}
+	else if (strcmp(argv[1], "compare") == 0)
+	{
+		if (argc < 4)
+		{
+			usage(argv[0]);
+		}
+		uint32_t numBands = 16;
+		bool isJson = false;
+
+		for (int i = 4; i < argc; i++)
+		{
+			if (strcmp(argv[i], "--bands") == 0 && i + 1 < argc)
+			{
+				numBands = strtoul(argv[++i], NULL, 10);
+			}
+			else if (strcmp(argv[i], "--json") == 0)
+			{
+				isJson = true;
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+		}
 
-		decode(inputFileName, ouputFileName);
+		compare(argv[2], argv[3], numBands, isJson);
 	}
 	else
 	{
@@ -68,8 +420,20 @@ int main(int argc, char** argv)
 	}
 }
 
-void encode(const char* inputFileName, uint32_t blockSize, float quantisationFactor, uint32_t binsToKeep)
+void encode(const char* inputFileName, uint32_t blockSize, float quantisationFactor, uint32_t binsToKeep, uint32_t blocksPerChunk, bool isLossless, uint32_t maxError, uint32_t baseBins, float silenceThreshold, const std::vector<float>& quantisationTable, CSnapHeader& header, CSampleFormat::EFormat inputFormat, float inputScale, uint64_t memoryBudget, const char* statsFileName)
 {
+	CMemoryPlanner::Plan plan;
+	if (CMemoryPlanner::planEncoder(memoryBudget, blockSize, binsToKeep, blocksPerChunk, plan) != SNAP_OK)
+	{
+		CMemoryPlanner::print(plan, memoryBudget, stderr);
+		fprintf(stderr, "Cannot encode with block size %u in %" PRIu64 " bytes\n", blockSize, memoryBudget);
+		exit(1);
+	}
+	if (memoryBudget != 0)
+	{
+		CMemoryPlanner::print(plan, memoryBudget, stderr);
+	}
+
 	FILE* fh = fopen(inputFileName, "r");
 	if (!fh)
 	{
@@ -77,6 +441,42 @@ void encode(const char* inputFileName, uint32_t blockSize, float quantisationFac
 		exit(1);
 	}
 
+	CSampleFormat::EFormat sampleFormat = inputFormat;
+	if (inputFormat == CSampleFormat::FORMAT_SDRIQ)
+	{
+		ESnapError error = CSampleFormat::readSdriqHeader(fh, header, sampleFormat);
+		if (error != SNAP_OK)
+		{
+			fprintf(stderr, "Cannot read sdriq header: %s\n", getSnapErrorString(error));
+			exit(1);
+		}
+	}
+	const uint32_t bytesPerSample = CSampleFormat::getBytesPerSample(sampleFormat);
+	std::vector<uint8_t> bytes((size_t) std::max(blockSize, plan.ioBufferSamples) * bytesPerSample);
+
+	// .8t is already on the 8 bit scale, anything else is scaled to fill it, which takes a (read only) pass to find the peak
+	if (inputScale == 0.0f)
+	{
+		inputScale = 1.0f;
+		if (sampleFormat != CSampleFormat::FORMAT_INT8)
+		{
+			long payloadOffset = ftell(fh);
+			float peak = 0.0f;
+			size_t samplesRead;
+			while ((samplesRead = fread(bytes.data(), bytesPerSample, bytes.size() / bytesPerSample, fh)) != 0)
+			{
+				peak = std::max(peak, CSampleFormat::findPeak(bytes.data(), samplesRead, sampleFormat));
+			}
+			fseek(fh, payloadOffset, SEEK_SET);
+
+			if (peak > 0.0f)
+			{
+				inputScale = 127.0f / peak;
+			}
+			fprintf(stderr, "Input is %s, peak %g, scaled by %g\n", CSampleFormat::getName(sampleFormat), peak, inputScale);
+		}
+	}
+
 	FILE* roundedQuantisedDct = NULL;
 	uint64_t fileSizeBytes = 0;
 
@@ -91,221 +491,995 @@ void encode(const char* inputFileName, uint32_t blockSize, float quantisationFac
 		fileSizeBytes = st.st_size;
 	}
 
-	CXZCompress compressor;
-	CDiscreteCosineTransform dct(blockSize);
-
-	//write headers (magic, blockSize, quantisationFactor, binsToKeep) all 4 bytes, LE
+	CStatistics statistics;
+	CSnapEncoder encoder;
+	encoder.setStatistics(&statistics);
+	encoder.setMemoryPlan(plan);
+	encoder.setLossless(isLossless);
+	encoder.setMaxError(maxError);
+	encoder.setBaseBins(baseBins);
+	encoder.setSilenceThreshold(silenceThreshold);
+	encoder.setQuantisationTable(quantisationTable);
+	ESnapError error = encoder.start(blockSize, quantisationFactor, binsToKeep, blocksPerChunk, header);
+	if (error != SNAP_OK)
 	{
-		// these aren't compressed to make it easier to see what is going on (but means we can't use xz to decompress)
-		fwrite(magic, 1, 4, roundedQuantisedDct);
-
-		fwrite(&blockSize, 4, 1, roundedQuantisedDct);
-
-		fwrite(&quantisationFactor, 4, 1, roundedQuantisedDct);
-
-		fwrite(&binsToKeep, 4, 1, roundedQuantisedDct);
+		fprintf(stderr, "Cannot start encoding: %s\n", getSnapErrorString(error));
+		exit(1);
 	}
 
-	std::vector<std::complex<int8_t>> bytes(blockSize);
-	std::vector<std::complex<float>> floats(blockSize);
-	std::vector<std::complex<float>> transformed;
-	std::vector<std::complex<int8_t>> transformedRounded(blockSize);
-	std::vector<std::complex<int8_t>> transformedRoundedQuantised(blockSize);
+	auto writeOutput = [&]()
+	{
+		uint64_t now = CStatistics::getNanoseconds();
+		size_t numBytes;
+		const uint8_t* output = encoder.getOutput(numBytes);
+		fwrite(output, 1, numBytes, roundedQuantisedDct);
+		encoder.consumeOutput(numBytes);
+		statistics.lap(CStatistics::STAGE_WRITE, now);
+		statistics.addCount(CStatistics::COUNTER_BYTES_OUT, numBytes);
+	};
 
-	time_t start = time(NULL);
-	time_t lastPrint = start;
+	time_t lastPrint = time(NULL);
 	uint64_t bytesProcessed = 0;
 
-	while (!feof(fh))
+	while (true)
 	{
-		if (fread(bytes.data(), 2, blockSize, fh) == blockSize)
+		uint64_t now = CStatistics::getNanoseconds();
+		size_t samplesRead = fread(bytes.data(), bytesPerSample, bytes.size() / bytesPerSample, fh);
+		statistics.lap(CStatistics::STAGE_READ, now);
+		statistics.addCount(CStatistics::COUNTER_BYTES_IN, samplesRead * bytesPerSample);
+		if (samplesRead == 0)
 		{
-			for (uint32_t i = 0; i < blockSize; i++)
-			{
-				floats[i] = bytes[i];
-			}
-
-			bytesProcessed += blockSize * 2;
-
-			dct.optDCT(floats, transformed);
-
-			for (uint32_t i = 0; i < blockSize; i++)
-			{
-				if (std::abs(transformed[i].real()) * quantisationFactor > 127)
-				{
-					fprintf(stderr, "Overflow detected, set quantisation to: %f %%\n", quantisationFactor * 12700.0f / (quantisationFactor * std::abs(transformed[i].real())));
-				}
-				if (std::abs(transformed[i].imag()) * quantisationFactor > 127)
-				{
-					fprintf(stderr, "Overflow detected, set quantisation to: %f %%\n", quantisationFactor * 12700.0f / (quantisationFactor * std::abs(transformed[i].imag())));
-				}
+			break;
+		}
 
-				transformedRounded[i].real(roundf(transformed[i].real()));
-				transformedRounded[i].imag(roundf(transformed[i].imag()));
+		error = encoder.pushSamples(bytes.data(), samplesRead, sampleFormat, inputScale);
+		if (error != SNAP_OK)
+		{
+			fprintf(stderr, "Encoding failed: %s\n", getSnapErrorString(error));
+			exit(1);
+		}
+		writeOutput();
 
-				transformedRoundedQuantised[i].real(roundf(transformed[i].real() * quantisationFactor));
-				transformedRoundedQuantised[i].imag(roundf(transformed[i].imag() * quantisationFactor));
-			}
+		bytesProcessed += samplesRead * bytesPerSample;
 
-			//fwrite(transformedRoundedQuantised.data(), 2, binsToKeep, roundedQuantisedDct);
-			compressor.addBytes(reinterpret_cast<uint8_t*>(transformedRoundedQuantised.data()), 2 * binsToKeep);
-			compressor.writeAndEmptyBuffer(roundedQuantisedDct);
+		if (time(NULL) != lastPrint)
+		{
+			lastPrint = time(NULL);
+			float megaBytesProcessed = bytesProcessed / 1000000.0f;
+			float megaBytesOutput = encoder.getBytesProduced() / 1000000.0f;
+			float ratioFromCuttingHighFreqs = binsToKeep / (float) blockSize;
+			float xzRatio = encoder.getXzRatio();
+			float overallRatio = ratioFromCuttingHighFreqs * xzRatio;
+			float rate = megaBytesProcessed / statistics.getElapsedSeconds();
+			float fileSizeMegaBytes = fileSizeBytes / 1000000.0f;
+			float eta = (fileSizeMegaBytes - megaBytesProcessed) / rate;
+			printf("Encoding: %3.1f / %3.1f MB processed, compressed size: %3.1f MB, ratio: %2.2f%% (%2.2f%% trimming, %2.2f%% %s), rate = %2.2f MB/s, eta: %3.0f s\n", megaBytesProcessed, fileSizeMegaBytes, megaBytesOutput, overallRatio * 100.0f, ratioFromCuttingHighFreqs * 100.0f, xzRatio * 100.0f, isLossless || maxError != CSnapEncoder::noMaxError ? "rice" : "xz", rate, eta);
 
-			if (time(NULL) != lastPrint)
+			if (statsFileName)
 			{
-				lastPrint = time(NULL);
-				float megaBytesProcessed = bytesProcessed / 1000000.0f;
-				float megaBytesOutput = ftell(roundedQuantisedDct) / 1000000.0f;
-				float ratioFromCuttingHighFreqs = binsToKeep / (float) blockSize;
-				float xzRatio = compressor.getRatio();
-				float overallRatio = ratioFromCuttingHighFreqs * xzRatio;
-				float rate = megaBytesProcessed / (float) (lastPrint - start);
-				float fileSizeMegaBytes = fileSizeBytes / 1000000.0f;
-				float eta = (fileSizeMegaBytes - megaBytesProcessed) / rate;
-				printf("Encoding: %3.1f / %3.1f MB processed, compressed size: %3.1f MB, ratio: %2.2f%% (%2.2f%% trimming, %2.2f%% xz), rate = %2.2f MB/s, eta: %3.0f s\n", megaBytesProcessed, fileSizeMegaBytes, megaBytesOutput, overallRatio * 100.0f, ratioFromCuttingHighFreqs * 100.0f, xzRatio * 100.0f, rate, eta);
+				statistics.writeJsonFile(statsFileName, "encode");
 			}
-
-			/*for (uint32_t i = 0; i < blockSize; i++)
-			 {
-			 printf("%03d: (%3d, %3d) -> (%3d, %3d) -> (%3d, %3d)\n",
-			 i,
-			 bytes[i].real(), bytes[i].imag(),
-			 transformedRounded[i].real(), transformedRounded[i].imag(),
-			 transformedRoundedQuantised[i].real(), transformedRoundedQuantised[i].imag()
-			 );
-			 }
-			 printf("###################################\n");*/
 		}
 	}
 
-	bool done = false;
-	while (!done)
+	error = encoder.finish();
+	if (error != SNAP_OK)
+	{
+		fprintf(stderr, "Encoding failed: %s\n", getSnapErrorString(error));
+		exit(1);
+	}
+	writeOutput();
+
+	if (encoder.getOverflowCount() != 0)
 	{
-		done = compressor.finish();
-		compressor.writeAndEmptyBuffer(roundedQuantisedDct);
+		fprintf(stderr, "Overflow detected in %" PRIu64 " coefficients (clipped), set quantisation to: %f %%\n", encoder.getOverflowCount(), encoder.getSuggestedQuantisationFactor() * 100.0f);
 	}
 
 	fclose(roundedQuantisedDct);
+	fclose(fh);
+
+	if (statsFileName && !statistics.writeJsonFile(statsFileName, "encode"))
+	{
+		fprintf(stderr, "Cannot write: '%s'\n", statsFileName);
+		exit(1);
+	}
 }
 
-void decode(const char* inputFileName, const char* outputFileName)
+void encodeBatch(const std::vector<std::string>& inputFileNames, uint32_t blockSize, float quantisationFactor, uint32_t binsToKeep, uint32_t blocksPerChunk, bool isLossless, uint32_t maxError, uint32_t baseBins, float silenceThreshold, const std::vector<float>& quantisationTable, uint32_t numThreads, uint64_t memoryBudget, const char* reportFileName)
 {
-	FILE* inputFh = fopen(inputFileName, "r");
-	if (!inputFh)
+	if (blockSize == 0 || binsToKeep == 0 || binsToKeep > blockSize || !(quantisationFactor > 0.0f))
 	{
-		fprintf(stderr, "Cannot read: '%s'\n", inputFileName);
+		fprintf(stderr, "Invalid block size, quantisation or cut off\n");
 		exit(1);
 	}
 
-	FILE* decodedFh = fopen(outputFileName, "w");
-	if (!decodedFh)
+	CBatchEncoder batch(blockSize, quantisationFactor, binsToKeep, blocksPerChunk, numThreads);
+	batch.setLossless(isLossless);
+	batch.setMaxError(maxError);
+	batch.setBaseBins(baseBins);
+	batch.setSilenceThreshold(silenceThreshold);
+	batch.setQuantisationTable(quantisationTable);
+
+	// each worker has its own xz encoder, so they get an equal share of the budget
+	if (memoryBudget != 0)
 	{
-		fprintf(stderr, "Cannot write: '%s'\n", outputFileName);
-		exit(1);
+		CMemoryPlanner::Plan plan;
+		uint64_t workerBudget = memoryBudget / batch.getNumThreads();
+		if (CMemoryPlanner::planEncoder(workerBudget, blockSize, binsToKeep, blocksPerChunk, plan) != SNAP_OK)
+		{
+			CMemoryPlanner::print(plan, workerBudget, stderr);
+			fprintf(stderr, "Cannot encode with block size %u on %u threads in %" PRIu64 " bytes\n", blockSize, batch.getNumThreads(), memoryBudget);
+			exit(1);
+		}
+		fprintf(stderr, "Per thread: ");
+		CMemoryPlanner::print(plan, workerBudget, stderr);
+		batch.setMemoryPlan(plan);
 	}
 
-	uint64_t fileSizeBytes = 0;
+	for (const std::string& inputFileName : inputFileNames)
 	{
-		struct stat st;
-		stat(inputFileName, &st);
-		fileSizeBytes = st.st_size;
+		CSnapHeader header;
+		readMetadataFile((inputFileName + ".meta").c_str(), header);
+		batch.addFile(inputFileName, header);
 	}
 
-	char fileMagic[4];
-	uint32_t blockSize;
-	float quantisationFactor;
-	uint32_t binsToKeep;
+	fprintf(stderr, "Encoding %zu files on %u threads\n", inputFileNames.size(), batch.getNumThreads());
+	batch.run();
+
+	uint64_t totalBytesIn = 0;
+	uint64_t totalBytesOut = 0;
+	uint32_t numFailed = 0;
 
-	//read headers (magic, blockSize, quantisationFactor, binsToKeep) all 4 bytes, LE
+	for (const CBatchEncoder::Result& result : batch.getResults())
 	{
-		fread(fileMagic, 1, 4, inputFh);
-		if (memcmp(fileMagic, magic, 4) != 0)
+		if (result.error != SNAP_OK)
 		{
-			fprintf(stderr, "Invalid file header\n");
-			exit(1);
+			numFailed++;
+			printf("%s: failed: %s\n", result.inputFileName.c_str(), getSnapErrorString(result.error));
+			continue;
 		}
 
-		fread(&blockSize, 4, 1, inputFh);
-		if (blockSize == 0)
+		totalBytesIn += result.bytesIn;
+		totalBytesOut += result.bytesOut;
+		float ratio = result.bytesIn != 0 ? result.bytesOut / (float) result.bytesIn : 0.0f;
+		float rate = result.seconds > 0.0 ? result.bytesIn / 1000000.0f / result.seconds : 0.0f;
+		printf("%s: %3.1f MB -> %3.1f MB, ratio: %2.2f%%, %3.1f s, rate = %2.2f MB/s", result.inputFileName.c_str(), result.bytesIn / 1000000.0f, result.bytesOut / 1000000.0f, ratio * 100.0f, result.seconds, rate);
+		if (result.overflowCount != 0)
 		{
-			fprintf(stderr, "block size of zero is invalid\n");
-			exit(1);
+			printf(", %" PRIu64 " overflows (clipped), set quantisation to: %f %%", result.overflowCount, result.suggestedQuantisationFactor * 100.0f);
 		}
+		printf("\n");
+	}
+
+	float totalRatio = totalBytesIn != 0 ? totalBytesOut / (float) totalBytesIn : 0.0f;
+	printf("Total: %zu files, %u failed, %3.1f MB -> %3.1f MB, ratio: %2.2f%%, %3.1f s, rate = %2.2f MB/s on %u threads\n", inputFileNames.size(), numFailed, totalBytesIn / 1000000.0f, totalBytesOut / 1000000.0f, totalRatio * 100.0f, batch.getElapsedSeconds(), totalBytesIn / 1000000.0f / batch.getElapsedSeconds(), batch.getNumThreads());
 
-		fread(&quantisationFactor, 4, 1, inputFh);
-		if (quantisationFactor == 0.0f)
+	if (reportFileName)
+	{
+		FILE* fh = fopen(reportFileName, "w");
+		if (!fh)
 		{
-			fprintf(stderr, "quantisationFactor of zero is invalid\n");
+			fprintf(stderr, "Cannot write: '%s'\n", reportFileName);
 			exit(1);
 		}
-		if (quantisationFactor > 1.0f)
-		{
-			fprintf(stderr, "quantisationFactor above 1 is a bad idea\n");
-		}
 
-		fread(&binsToKeep, 4, 1, inputFh);
-		if (binsToKeep == 0 || binsToKeep > blockSize)
+		fprintf(fh, "{\"threads\": %u, \"seconds\": %.3f, \"bytes_in\": %" PRIu64 ", \"bytes_out\": %" PRIu64 ", \"failed\": %u, \"files\": [", batch.getNumThreads(), batch.getElapsedSeconds(), totalBytesIn, totalBytesOut, numFailed);
+		const char* separator = "\n";
+		for (const CBatchEncoder::Result& result : batch.getResults())
 		{
-			fprintf(stderr, "Invalid binsToKeep = %u, blockSize = %u\n", binsToKeep, blockSize);
-			exit(1);
+			fprintf(fh, "%s\t{\"input\": ", separator);
+			writeJsonString(fh, result.inputFileName);
+			fprintf(fh, ", \"output\": ");
+			writeJsonString(fh, result.outputFileName);
+			fprintf(fh, ", \"bytes_in\": %" PRIu64 ", \"bytes_out\": %" PRIu64 ", \"blocks\": %" PRIu64 ", \"overflows\": %" PRIu64 ", \"seconds\": %.3f, \"error\": ", result.bytesIn, result.bytesOut, result.blocks, result.overflowCount, result.seconds);
+			if (result.error != SNAP_OK)
+			{
+				writeJsonString(fh, getSnapErrorString(result.error));
+			}
+			else
+			{
+				fprintf(fh, "null");
+			}
+			fprintf(fh, "}");
+			separator = ",\n";
 		}
-
-		fprintf(stderr, "Read header successfully. Blocksize = %u, quantisation = %f, binsToKeep = %u\n", blockSize, quantisationFactor, binsToKeep);
+		fprintf(fh, "\n]}\n");
+		fclose(fh);
 	}
 
-	const float iQuantisationFactor = 1.0f / quantisationFactor;
-
-	CXZDecompress decompressor(inputFh);
-	CDiscreteCosineTransform dct(blockSize);
+	if (numFailed != 0)
+	{
+		exit(1);
+	}
+}
 
-	std::vector<std::complex<float>> inverseTransformed;
-	std::vector<std::complex<float>> rounded(blockSize, {0.0f, 0.0f});
-	std::vector<std::complex<int8_t>> iBytes(blockSize, {0,0});
+void decode(const char* inputFileName, const char* outputFileName, uint64_t startSample, uint64_t sampleCount, uint32_t decimation, bool isBaseLayerOnly, bool isNoiseFill, uint64_t memoryBudget, const char* statsFileName)
+{
+	FILE* inputFh = fopen(inputFileName, "r");
+	if (!inputFh)
+	{
+		fprintf(stderr, "Cannot read: '%s'\n", inputFileName);
+		exit(1);
+	}
 
-	std::vector<std::complex<int8_t>> bytes(blockSize, {0,0});
-	std::vector<std::complex<float>> floats(blockSize, {0.0f, 0.0f});
+	uint64_t fileSizeBytes = 0;
+	{
+		struct stat st;
+		stat(inputFileName, &st);
+		fileSizeBytes = st.st_size;
+	}
 
-	time_t start = time(NULL);
-	time_t lastPrint = start;
+	CStatistics statistics;
+	CSnapDecoder decoder;
+	decoder.setStatistics(&statistics);
+	openDecoder(decoder, inputFh);
+	const uint32_t blockSize = decoder.getBlockSize();
+	const uint32_t binsToKeep = decoder.getBinsToKeep();
 
-	while (!feof(inputFh) && decompressor.consumeBytes(reinterpret_cast<char*>(bytes.data()), 2 * binsToKeep))
+	ESnapError error = decoder.setDecimation(decimation);
+	if (error == SNAP_ERROR_UNSUPPORTED)
 	{
-		//if (fread(bytes.data(), 2, binsToKeep, inputFh) == binsToKeep)
-		{
-			for (uint32_t i = 0; i < blockSize; i++)
-			{
-				floats[i] = bytes[i];
-				floats[i] *= iQuantisationFactor;
+		fprintf(stderr, "Lossless and near lossless files can't be decimated\n");
+		exit(1);
+	}
+	if (error != SNAP_OK)
+	{
+		fprintf(stderr, "Decimation factor %u must divide the block size %u\n", decimation, blockSize);
+		exit(1);
+	}
+	error = decoder.setBaseLayerOnly(isBaseLayerOnly);
+	if (error == SNAP_ERROR_UNSUPPORTED)
+	{
+		fprintf(stderr, "The file isn't layered\n");
+		exit(1);
+	}
+	if (error != SNAP_OK)
+	{
+		fprintf(stderr, "Only the base layer can't be decoded without a seek index\n");
+		exit(1);
+	}
+	decoder.setNoiseFill(isNoiseFill);
+
+	CMemoryPlanner::Plan plan;
+	if (CMemoryPlanner::planDecoder(memoryBudget, blockSize, binsToKeep, decimation, decoder.getDictionarySize(), plan) != SNAP_OK)
+	{
+		CMemoryPlanner::print(plan, memoryBudget, stderr);
+		fprintf(stderr, "Cannot decode with block size %u and a %u KiB xz dictionary in %" PRIu64 " bytes\n", blockSize, decoder.getDictionarySize() / 1024, memoryBudget);
+		exit(1);
+	}
+	if (memoryBudget != 0)
+	{
+		CMemoryPlanner::print(plan, memoryBudget, stderr);
+	}
+	decoder.setMemoryPlan(plan);
+
+	if (sampleCount != UINT64_MAX)
+	{
+		sampleCount = (sampleCount + decimation - 1) / decimation;
+	}
+
+	if (startSample != 0)
+	{
+		seekDecoder(decoder, startSample);
+	}
+
+	// only once nothing else can go wrong first, so a failed decode doesn't leave an empty file behind
+	FILE* decodedFh = fopen(outputFileName, "w");
+	if (!decodedFh)
+	{
+		fprintf(stderr, "Cannot write: '%s'\n", outputFileName);
+		exit(1);
+	}
+
+	time_t lastPrint = time(NULL);
+
+	const std::complex<int8_t>* samples;
+	size_t numSamples;
+	while (sampleCount != 0 && (error = decoder.pullBlock(samples, numSamples)) == SNAP_OK && numSamples != 0)
+	{
+		if (time(NULL) != lastPrint)
+		{
+			lastPrint = time(NULL);
+			float megaBytesCompressed = decoder.getInputByteCount() / 1000000.0f;
+			float megaBytesDecompressed = decoder.getOutputByteCount() / 1000000.0f;
+			float ratioFromCuttingHighFreqs = binsToKeep / (float) blockSize;
+			float xzRatio = megaBytesCompressed / megaBytesDecompressed;
+			float overallRatio = ratioFromCuttingHighFreqs * xzRatio;
+			float rate = megaBytesCompressed / statistics.getElapsedSeconds();
+			float fileSizeMegaBytes = fileSizeBytes / 1000000.0f;
+			float eta = (fileSizeMegaBytes - megaBytesCompressed) / rate;
+			printf("Decoding: %3.1f / %3.1f MB processed, decompressed size: %3.1f MB, ratio: %2.2f%% (%2.2f%% trimming, %2.2f%% xz), (input)rate = %2.2f MB/s, eta: %3.0f s\n", megaBytesCompressed, fileSizeMegaBytes, megaBytesDecompressed, overallRatio * 100.0f, ratioFromCuttingHighFreqs * 100.0f, xzRatio * 100.0f, rate, eta);
+
+			if (statsFileName)
+			{
+				statistics.addCount(CStatistics::COUNTER_BYTES_IN, decoder.getInputByteCount() - statistics.getCount(CStatistics::COUNTER_BYTES_IN));
+				statistics.writeJsonFile(statsFileName, "decode");
 			}
+		}
+
+		uint64_t now = CStatistics::getNanoseconds();
+		uint64_t samplesToWrite = std::min<uint64_t>(numSamples, sampleCount);
+		fwrite(samples, 2, samplesToWrite, decodedFh);
+		sampleCount -= samplesToWrite;
+		statistics.lap(CStatistics::STAGE_WRITE, now);
+		statistics.addCount(CStatistics::COUNTER_BYTES_OUT, samplesToWrite * 2);
+	}
+
+	if (sampleCount != 0 && error == SNAP_OK && !decoder.isFinished())
+	{
+		error = SNAP_ERROR_CORRUPT_DATA;
+	}
+	if (error != SNAP_OK)
+	{
+		fprintf(stderr, "Decoding failed: %s\n", getSnapErrorString(error));
+		exit(1);
+	}
+
+	fclose(decodedFh);
+	fclose(inputFh);
 
-			dct.optIDCT(floats, inverseTransformed);
+	// bytes in is the compressed data the decoder consumed, its reads happen inside the xz stage
+	statistics.addCount(CStatistics::COUNTER_BYTES_IN, decoder.getInputByteCount() - statistics.getCount(CStatistics::COUNTER_BYTES_IN));
+	if (statsFileName && !statistics.writeJsonFile(statsFileName, "decode"))
+	{
+		fprintf(stderr, "Cannot write: '%s'\n", statsFileName);
+		exit(1);
+	}
+}
+
+void spectrum(const char* inputFileName, const char* outputFileName, uint32_t numColumns, uint32_t blocksPerSlice, uint64_t startSample, uint64_t sampleCount)
+{
+	FILE* inputFh = fopen(inputFileName, "r");
+	if (!inputFh)
+	{
+		fprintf(stderr, "Cannot read: '%s'\n", inputFileName);
+		exit(1);
+	}
+
+	FILE* spectrumFh = fopen(outputFileName, "w");
+	if (!spectrumFh)
+	{
+		fprintf(stderr, "Cannot write: '%s'\n", outputFileName);
+		exit(1);
+	}
+
+	size_t fileNameLength = strlen(outputFileName);
+	bool isCsv = fileNameLength > 4 && strcmp(outputFileName + fileNameLength - 4, ".csv") == 0;
+
+	CSnapDecoder decoder;
+	openDecoder(decoder, inputFh);
+	uint32_t blockSize = decoder.getBlockSize();
+	const uint32_t binsToKeep = decoder.getBinsToKeep();
+
+	if (numColumns == 0 || numColumns > binsToKeep)
+	{
+		numColumns = binsToKeep;
+	}
+	const uint32_t binsPerColumn = (binsToKeep + numColumns - 1) / numColumns;
+	// rounding binsPerColumn up can leave fewer columns than asked for, e.g. 1000 of 1998 bins are 999 columns of 2
+	numColumns = (binsToKeep + binsPerColumn - 1) / binsPerColumn;
+
+	uint64_t firstBlock = startSample / blockSize;
+	uint64_t blocksRemaining = sampleCount == UINT64_MAX ? UINT64_MAX : (startSample + sampleCount + blockSize - 1) / blockSize - firstBlock;
 
-			for (uint32_t i = 0; i < blockSize; i++)
+	if (firstBlock != 0)
+	{
+		seekDecoder(decoder, firstBlock * blockSize);
+	}
+
+	if (isCsv)
+	{
+		fprintf(spectrumFh, "first_sample");
+		for (uint32_t column = 0; column < numColumns; column++)
+		{
+			fprintf(spectrumFh, ",bin_%u", column * binsPerColumn);
+		}
+		fprintf(spectrumFh, "\n");
+	}
+	else
+	{
+		fwrite(spectrumMagic, 1, 4, spectrumFh);
+		fwrite(&numColumns, 4, 1, spectrumFh);
+		fwrite(&binsPerColumn, 4, 1, spectrumFh);
+		fwrite(&blocksPerSlice, 4, 1, spectrumFh);
+		fwrite(&blockSize, 4, 1, spectrumFh);
+	}
+
+	// sum the squared quantised values as integers, each bin's dequantisation scale is applied once per slice.
+	// Each column is the mean power of its bins, so columns of different widths compare
+	std::vector<uint64_t> binPowers(binsToKeep, 0);
+	std::vector<float> columnPowers(numColumns);
+	std::vector<double> binScales(binsToKeep);
+	for (uint32_t i = 0; i < binsToKeep; i++)
+	{
+		double iQuantisationFactor = 1.0 / decoder.getBinQuantisationFactors()[i];
+		binScales[i] = iQuantisationFactor * iQuantisationFactor;
+	}
+
+	uint64_t firstSample = firstBlock * blockSize;
+	uint32_t blocksInSlice = 0;
+
+	auto writeSlice = [&]()
+	{
+		for (uint32_t column = 0; column < numColumns; column++)
+		{
+			// the last column can be narrower than binsPerColumn
+			const uint32_t firstBin = column * binsPerColumn;
+			const uint32_t endBin = std::min(firstBin + binsPerColumn, binsToKeep);
+			double sum = 0.0;
+			for (uint32_t i = firstBin; i < endBin; i++)
 			{
-				rounded[i].real(roundf(inverseTransformed[i].real()));
-				rounded[i].imag(roundf(inverseTransformed[i].imag()));
+				sum += binPowers[i] * binScales[i];
 			}
+			columnPowers[column] = sum / ((double) blocksInSlice * (endBin - firstBin));
+		}
 
-			for (uint32_t i = 0; i < blockSize; i++)
+		if (isCsv)
+		{
+			fprintf(spectrumFh, "%" PRIu64, firstSample);
+			for (uint32_t column = 0; column < numColumns; column++)
 			{
-				iBytes[i] = rounded[i];
+				fprintf(spectrumFh, ",%g", columnPowers[column]);
 			}
+			fprintf(spectrumFh, "\n");
+		}
+		else
+		{
+			fwrite(&firstSample, 8, 1, spectrumFh);
+			fwrite(columnPowers.data(), 4, numColumns, spectrumFh);
+		}
+
+		std::fill(binPowers.begin(), binPowers.end(), 0);
+		firstSample += blocksInSlice * (uint64_t) blockSize;
+		blocksInSlice = 0;
+	};
 
-			if (time(NULL) != lastPrint)
+	const std::complex<int8_t>* coefficients;
+	ESnapError error = SNAP_OK;
+	while (blocksRemaining != 0 && (error = decoder.pullCoefficients(coefficients)) == SNAP_OK && coefficients)
+	{
+		for (uint32_t i = 0; i < binsToKeep; i++)
+		{
+			int32_t real = coefficients[i].real();
+			int32_t imag = coefficients[i].imag();
+			binPowers[i] += real * real + imag * imag;
+		}
+		blocksRemaining--;
+
+		if (++blocksInSlice == blocksPerSlice)
+		{
+			writeSlice();
+		}
+	}
+
+	if (blocksRemaining != 0 && error == SNAP_OK && !decoder.isFinished())
+	{
+		error = SNAP_ERROR_CORRUPT_DATA;
+	}
+	if (error != SNAP_OK)
+	{
+		fprintf(stderr, "Decoding failed: %s\n", getSnapErrorString(error));
+		exit(1);
+	}
+
+	if (blocksInSlice != 0)
+	{
+		writeSlice();
+	}
+
+	fclose(spectrumFh);
+	fclose(inputFh);
+}
+
+void info(const char* inputFileName, bool verify)
+{
+	FILE* inputFh = fopen(inputFileName, "r");
+	if (!inputFh)
+	{
+		fprintf(stderr, "Cannot read: '%s'\n", inputFileName);
+		exit(1);
+	}
+
+	CSnapHeader header;
+	ESnapError error = header.read(inputFh);
+	if (error != SNAP_OK)
+	{
+		fprintf(stderr, "Cannot read header: %s\n", getSnapErrorString(error));
+		exit(1);
+	}
+	header.print(stdout);
+
+	CSeekIndex index;
+	index.setLayered(header.has(CSnapHeader::TAG_BASE_BINS));
+	if (!index.read(inputFh, header.getVersion(), header.getPayloadOffset()))
+	{
+		if (header.getVersion() >= 3)
+		{
+			fprintf(stderr, "The seek index is missing or damaged, the file may have been cut short\n");
+			exit(1);
+		}
+		printf("no seek index\n");
+		if (verify)
+		{
+			fprintf(stderr, "Cannot verify a file without a seek index\n");
+			exit(1);
+		}
+		return;
+	}
+
+	const std::vector<CSeekIndex::Entry>& entries = index.getEntries();
+	// files before version 3 only held whole blocks
+	uint64_t totalSamples = header.getVersion() >= 3 ? index.getTotalSamples() : index.getTotalBlocks() * header.getUint32(CSnapHeader::TAG_BLOCK_SIZE);
+	printf("blocks: %" PRIu64 ", samples: %" PRIu64 "\n", index.getTotalBlocks(), totalSamples);
+	printf("chunks: %zu, payload: %" PRIu64 " bytes\n", entries.size(), index.getPayloadEnd() - header.getPayloadOffset());
+
+	if (!verify)
+	{
+		return;
+	}
+
+	if (header.getVersion() < 3)
+	{
+		fprintf(stderr, "Version %u files have no chunk checksums\n", header.getVersion());
+		exit(1);
+	}
+
+	std::vector<uint8_t> buffer(1024 * 1024);
+	uint32_t corruptChunks = 0;
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		uint64_t chunkEnd = i + 1 < entries.size() ? entries[i + 1].offset : index.getPayloadEnd();
+		uint64_t bytesRemaining = chunkEnd - entries[i].offset;
+		uint32_t checksum = 0;
+
+		fseek(inputFh, entries[i].offset, SEEK_SET);
+		while (bytesRemaining != 0)
+		{
+			size_t bytesRead = fread(buffer.data(), 1, std::min<uint64_t>(buffer.size(), bytesRemaining), inputFh);
+			if (bytesRead == 0)
 			{
-				lastPrint = time(NULL);
-				float megaBytesCompressed = decompressor.getInputByteCount() / 1000000.0f;
-				float megaBytesDecompressed = decompressor.getOutputByteCount() / 1000000.0f;
-				float ratioFromCuttingHighFreqs = binsToKeep / (float) blockSize;
-				float xzRatio = megaBytesCompressed / megaBytesDecompressed;
-				float overallRatio = ratioFromCuttingHighFreqs * xzRatio;
-				float rate = megaBytesCompressed / (float) (lastPrint - start);
-				float fileSizeMegaBytes = fileSizeBytes / 1000000.0f;
-				float eta = (fileSizeMegaBytes - megaBytesCompressed) / rate;
-				printf("Decoding: %3.1f / %3.1f MB processed, decompressed size: %3.1f MB, ratio: %2.2f%% (%2.2f%% trimming, %2.2f%% xz), (input)rate = %2.2f MB/s, eta: %3.0f s\n", megaBytesCompressed, fileSizeMegaBytes, megaBytesDecompressed, overallRatio * 100.0f, ratioFromCuttingHighFreqs * 100.0f, xzRatio * 100.0f, rate, eta);
+				break;
 			}
+			checksum = CCrc32c::calculate(buffer.data(), bytesRead, checksum);
+			bytesRemaining -= bytesRead;
+		}
+
+		if (bytesRemaining != 0 || checksum != entries[i].checksum)
+		{
+			printf("chunk %zu (blocks from %" PRIu64 ", offset %" PRIu64 ") is corrupt\n", i, entries[i].firstBlock, entries[i].offset);
+			corruptChunks++;
+		}
+	}
+
+	printf("%u of %zu chunks corrupt\n", corruptChunks, entries.size());
+	fclose(inputFh);
 
-			fwrite(iBytes.data(), 2, blockSize, decodedFh);
+	if (corruptChunks != 0)
+	{
+		exit(1);
+	}
+}
+
+void stats(const char* inputFileName, uint32_t blockSize, uint32_t binsToKeep, const char* tableFileName, float snr, uint32_t numBlocks, uint32_t numBands)
+{
+	if (blockSize == 0 || binsToKeep == 0 || binsToKeep > blockSize || numBlocks == 0)
+	{
+		fprintf(stderr, "Invalid block size, cut off or block count\n");
+		exit(1);
+	}
+	const uint32_t maxBands = std::min(binsToKeep, CSnapEncoder::maxQuantisationTableSize);
+	if (numBands == 0)
+	{
+		numBands = maxBands;
+	}
+	if (numBands > maxBands)
+	{
+		fprintf(stderr, "There can't be more than %u bands\n", maxBands);
+		exit(1);
+	}
+
+	FILE* inputFh = fopen(inputFileName, "r");
+	if (!inputFh)
+	{
+		fprintf(stderr, "Cannot read: '%s'\n", inputFileName);
+		exit(1);
+	}
+
+	struct stat st;
+	fstat(fileno(inputFh), &st);
+	const uint64_t blocksInFile = st.st_size / (2 * (uint64_t) blockSize);
+	if (blocksInFile == 0)
+	{
+		fprintf(stderr, "'%s' is shorter than a block\n", inputFileName);
+		exit(1);
+	}
+	numBlocks = std::min<uint64_t>(numBlocks, blocksInFile);
+
+	// blocks spread evenly over the file, so a capture that changes part way through is fairly represented
+	CDiscreteCosineTransform dct(blockSize);
+	CQuantisationTable table(blockSize, binsToKeep, numBands);
+	std::vector<std::complex<int8_t>> samples(blockSize);
+	std::vector<std::complex<float>> floats(blockSize);
+	std::vector<std::complex<float>> transformed;
+	for (uint32_t i = 0; i < numBlocks; i++)
+	{
+		uint64_t block = i * blocksInFile / numBlocks;
+		fseek(inputFh, block * 2 * blockSize, SEEK_SET);
+		if (fread(samples.data(), 2, blockSize, inputFh) != blockSize)
+		{
+			fprintf(stderr, "Cannot read block %" PRIu64 " of '%s'\n", block, inputFileName);
+			exit(1);
+		}
+		CSampleFormat::toFloat(samples.data(), blockSize, CSampleFormat::FORMAT_INT8, 1.0f, floats.data());
+		dct.optDCT(floats, transformed);
+		table.addBlock(transformed.data());
+	}
+	fclose(inputFh);
+
+	CQuantisationTable::Result result;
+	ESnapError error = table.derive(snr, result);
+	if (error == SNAP_ERROR_OUT_OF_RANGE)
+	{
+		fprintf(stderr, "%.1f dB can't be reached with this cut off\n", snr);
+		exit(1);
+	}
+	if (error != SNAP_OK)
+	{
+		fprintf(stderr, "Cannot derive a table: %s\n", getSnapErrorString(error));
+		exit(1);
+	}
+
+	FILE* tableFh = fopen(tableFileName, "w");
+	if (!tableFh)
+	{
+		fprintf(stderr, "Cannot write: '%s'\n", tableFileName);
+		exit(1);
+	}
+	for (float weight : result.weights)
+	{
+		fprintf(tableFh, "%g\n", weight);
+	}
+	fclose(tableFh);
+
+	printf("blocks: %u, bands: %u\n", numBlocks, numBands);
+	printf("quantisation_percent: %g, estimated snr: %.2f dB, %.3f bits per sample\n", result.quantisationFactor * 100.0f, result.snr, result.bitsPerSample);
+	if (result.uniformQuantisationFactor != 0.0f)
+	{
+		printf("without the table: quantisation_percent %g, %.3f bits per sample\n", result.uniformQuantisationFactor * 100.0f, result.uniformBitsPerSample);
+	}
+	else
+	{
+		printf("without the table: no single quantisation_percent reaches it\n");
+	}
+}
+
+void compare(const char* referenceFileName, const char* testFileName, uint32_t numBands, bool isJson)
+{
+	const char* fileNames[2] = {referenceFileName, testFileName};
+	FILE* fh[2];
+	uint64_t fileSizeBytes[2];
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		fh[i] = fopen(fileNames[i], "r");
+		if (!fh[i])
+		{
+			fprintf(stderr, "Cannot read: '%s'\n", fileNames[i]);
+			exit(1);
+		}
+
+		// the reads are big enough that stdio's buffer would only add a copy
+		setvbuf(fh[i], NULL, _IONBF, 0);
+		posix_fadvise(fileno(fh[i]), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+		struct stat st;
+		fstat(fileno(fh[i]), &st);
+		fileSizeBytes[i] = st.st_size;
+	}
+
+	if (fileSizeBytes[0] != fileSizeBytes[1])
+	{
+		fprintf(stderr, "Files differ in length (%" PRIu64 " and %" PRIu64 " bytes), comparing the first %" PRIu64 " samples\n", fileSizeBytes[0], fileSizeBytes[1], std::min(fileSizeBytes[0], fileSizeBytes[1]) / 2);
+	}
+
+	CSignalComparison comparison(numBands);
+	std::vector<std::complex<int8_t>> samples[2];
+	samples[0].resize(compareReadSamples);
+	samples[1].resize(compareReadSamples);
+
+	while (true)
+	{
+		size_t samplesRead[2];
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			samplesRead[i] = fread(samples[i].data(), 2, compareReadSamples, fh[i]);
+		}
+
+		size_t numSamples = std::min(samplesRead[0], samplesRead[1]);
+		if (numSamples == 0)
+		{
+			break;
+		}
+		comparison.addSamples(samples[0].data(), samples[1].data(), numSamples);
+	}
+
+	fclose(fh[0]);
+	fclose(fh[1]);
+
+	std::vector<CSignalComparison::Band> bands = comparison.getBands();
+
+	if (isJson)
+	{
+		// a perfect reconstruction has an infinite SNR, which JSON has no number for (checked via the error power,
+		// -ffast-math assumes nothing is infinite)
+		auto printSnr = [](double signalPower, double errorPower)
+		{
+			if (errorPower > 0.0)
+			{
+				printf("%.3f", 10.0 * log10(signalPower / errorPower));
+			}
+			else
+			{
+				printf("null");
+			}
+		};
+
+		printf("{\"samples\":%" PRIu64 ",\"signal_power\":%g,\"error_power\":%g,\"snr_db\":", comparison.getNumSamples(), comparison.getSignalPower(), comparison.getErrorPower());
+		printSnr(comparison.getSignalPower(), comparison.getErrorPower());
+		printf(",\"evm_percent\":%.4f,\"max_error\":%u,\"bands\":[", comparison.getEvm(), comparison.getMaxError());
+		for (size_t i = 0; i < bands.size(); i++)
+		{
+			printf("%s{\"start\":%.4f,\"end\":%.4f,\"signal_power\":%g,\"error_power\":%g,\"snr_db\":", i ? "," : "", bands[i].startFrequency, bands[i].endFrequency, bands[i].signalPower, bands[i].errorPower);
+			printSnr(bands[i].signalPower, bands[i].errorPower);
+			printf("}");
+		}
+		printf("]}\n");
+		return;
+	}
+
+	printf("samples: %" PRIu64 "\n", comparison.getNumSamples());
+	printf("signal power: %g, error power: %g\n", comparison.getSignalPower(), comparison.getErrorPower());
+	printf("snr: %.2f dB, evm: %.3f %%, max error: %u\n", comparison.getSnr(), comparison.getEvm(), comparison.getMaxError());
+
+	if (!bands.empty())
+	{
+		printf("band (fraction of sample rate)   signal power    error power   snr (dB)\n");
+		for (const CSignalComparison::Band& band : bands)
+		{
+			printf("%+8.4f to %+8.4f          %14g %14g %10.2f\n", band.startFrequency, band.endFrequency, band.signalPower, band.errorPower, 10.0 * log10(band.signalPower / band.errorPower));
+		}
+	}
+}
+
+void openDecoder(CSnapDecoder& decoder, FILE* fh)
+{
+	ESnapError error = decoder.open(fh);
+	if (error != SNAP_OK)
+	{
+		fprintf(stderr, "Cannot read header or seek index: %s\n", getSnapErrorString(error));
+		exit(1);
+	}
+
+	if (decoder.getQuantisationFactor() > 1.0f)
+	{
+		fprintf(stderr, "quantisationFactor above 1 is a bad idea\n");
+	}
+
+	fprintf(stderr, "Read header successfully. Blocksize = %u, quantisation = %f, binsToKeep = %u\n", decoder.getBlockSize(), decoder.getQuantisationFactor(), decoder.getBinsToKeep());
+}
+
+void seekDecoder(CSnapDecoder& decoder, uint64_t sample)
+{
+	if (!decoder.hasIndex())
+	{
+		fprintf(stderr, "File has no seek index, decoding from the start\n");
+	}
+
+	ESnapError error = decoder.seekToSample(sample);
+	if (error == SNAP_ERROR_OUT_OF_RANGE)
+	{
+		fprintf(stderr, "Sample %" PRIu64 " is past the end of the file (%" PRIu64 " samples)\n", sample, decoder.getIndex().getTotalSamples());
+		exit(1);
+	}
+	else if (error != SNAP_OK)
+	{
+		fprintf(stderr, "Cannot seek: %s\n", getSnapErrorString(error));
+		exit(1);
+	}
+}
+
+void readMetadataFile(const char* fileName, CSnapHeader& header)
+{
+	// key=value lines, as written by the sdriq converter
+	FILE* fh = fopen(fileName, "r");
+	if (!fh)
+	{
+		return;
+	}
+
+	char line[256];
+	while (fgets(line, sizeof(line), fh))
+	{
+		char* value = strchr(line, '=');
+		if (!value)
+		{
+			continue;
+		}
+		*value++ = 0;
+
+		if (strcmp(line, "sample_rate") == 0)
+		{
+			header.setUint32(CSnapHeader::TAG_SAMPLE_RATE, strtoul(value, NULL, 10));
+		}
+		else if (strcmp(line, "centre_frequency") == 0)
+		{
+			header.setUint64(CSnapHeader::TAG_CENTRE_FREQUENCY, strtoull(value, NULL, 10));
+		}
+		else if (strcmp(line, "timestamp") == 0)
+		{
+			header.setUint64(CSnapHeader::TAG_TIMESTAMP, strtoull(value, NULL, 10));
+		}
+	}
+
+	fclose(fh);
+}
+
+// block_size quantisation_percent cut_off_freq_percent, the rest of options gets its defaults
+void parseEncodeParameters(char** parameters, EncodeOptions& options)
+{
+	options.blockSize = strtoul(parameters[0], NULL, 10);
+	options.quantisationFactor = strtof(parameters[1], NULL) / 100.0f;
+	options.binsToKeep = ceilf(options.blockSize * strtof(parameters[2], NULL) / 100.0f);
+	options.blocksPerChunk = 0;
+	options.isLossless = false;
+	options.maxError = CSnapEncoder::noMaxError;
+	options.baseBins = 0;
+	options.silenceThreshold = 0.0f;
+	options.quantisationTable.clear();
+	options.memoryBudget = 0;
+}
+
+// false if argv[i] isn't an option encode and encode-batch share, otherwise i is left at its last argument
+bool parseEncodeOption(int argc, char** argv, int& i, EncodeOptions& options)
+{
+	bool hasValue = i + 1 < argc;
+	if (strcmp(argv[i], "--chunk-blocks") == 0 && hasValue)
+	{
+		options.blocksPerChunk = strtoul(argv[++i], NULL, 10);
+	}
+	else if (strcmp(argv[i], "--max-memory") == 0 && hasValue)
+	{
+		if (!CMemoryPlanner::parseSize(argv[++i], options.memoryBudget))
+		{
+			usage(argv[0]);
+		}
+	}
+	else if (strcmp(argv[i], "--lossless") == 0)
+	{
+		options.isLossless = true;
+	}
+	else if (strcmp(argv[i], "--max-error") == 0 && hasValue)
+	{
+		options.maxError = strtoul(argv[++i], NULL, 10);
+	}
+	else if (strcmp(argv[i], "--layered") == 0 && hasValue)
+	{
+		options.baseBins = ceilf(options.blockSize * strtof(argv[++i], NULL) / 100.0f);
+	}
+	else if (strcmp(argv[i], "--silence") == 0 && hasValue)
+	{
+		options.silenceThreshold = strtof(argv[++i], NULL);
+	}
+	else if (strcmp(argv[i], "--quantisation-table") == 0 && hasValue)
+	{
+		readQuantisationTable(argv[++i], options.quantisationTable);
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+// lossless keeps every bin unquantised, and chunks default to about defaultChunkBytes of coefficients
+void finishEncodeOptions(EncodeOptions& options)
+{
+	if (options.isLossless)
+	{
+		options.quantisationFactor = 1.0f;
+		options.binsToKeep = options.blockSize;
+	}
+	if (options.blocksPerChunk == 0 && options.binsToKeep != 0)
+	{
+		options.blocksPerChunk = std::max(1U, defaultChunkBytes / (2 * options.binsToKeep));
+	}
+}
+
+void readQuantisationTable(const char* fileName, std::vector<float>& weights)
+{
+	// whitespace separated weights, as written by stats
+	FILE* fh = fopen(fileName, "r");
+	if (!fh)
+	{
+		fprintf(stderr, "Cannot read: '%s'\n", fileName);
+		exit(1);
+	}
+
+	weights.clear();
+	float weight;
+	while (fscanf(fh, "%f", &weight) == 1)
+	{
+		weights.push_back(weight);
+	}
+	if (!feof(fh) || weights.empty())
+	{
+		fprintf(stderr, "'%s' isn't a list of weights\n", fileName);
+		exit(1);
+	}
+	fclose(fh);
+}
+
+void addInputFiles(const char* pattern, std::vector<std::string>& fileNames)
+{
+	// the shell has normally expanded it already, this is for patterns too long for a command line
+	glob_t matches;
+	if (glob(pattern, GLOB_NOCHECK, NULL, &matches) != 0)
+	{
+		fileNames.push_back(pattern);
+		return;
+	}
+
+	for (size_t i = 0; i < matches.gl_pathc; i++)
+	{
+		fileNames.push_back(matches.gl_pathv[i]);
+	}
+	globfree(&matches);
+}
+
+void readInputList(const char* listFileName, std::vector<std::string>& fileNames)
+{
+	FILE* fh = strcmp(listFileName, "-") == 0 ? stdin : fopen(listFileName, "r");
+	if (!fh)
+	{
+		fprintf(stderr, "Cannot read: '%s'\n", listFileName);
+		exit(1);
+	}
+
+	char line[4096];
+	while (fgets(line, sizeof(line), fh))
+	{
+		line[strcspn(line, "\r\n")] = 0;
+		if (line[0] != 0)
+		{
+			addInputFiles(line, fileNames);
+		}
+	}
+
+	if (fh != stdin)
+	{
+		fclose(fh);
+	}
+}
+
+void writeJsonString(FILE* fh, const std::string& text)
+{
+	fputc('"', fh);
+	for (char character : text)
+	{
+		if (character == '"' || character == '\\')
+		{
+			fputc('\\', fh);
+			fputc(character, fh);
+		}
+		else if ((uint8_t) character < 0x20)
+		{
+			fprintf(fh, "\\u%04x", character);
+		}
+		else
+		{
+			fputc(character, fh);
 		}
 	}
+	fputc('"', fh);
 }
@@ -0,0 +1,48 @@
+#include "ASampleSource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdio.h>
+#include <thread>
+
+#include "CRawSampleSource.h"
+#include "CSnapSampleSource.h"
+
+ASampleSource::ASampleSource()
+{
+}
+
+ASampleSource::~ASampleSource()
+{
+}
+
+void ASampleSource::willNeed(uint64_t, uint64_t)
+{
+}
+
+ASampleSource* ASampleSource::open(const char* fileName)
+{
+	const char* extension = strrchr(fileName, '.');
+	if (extension && strcmp(extension, ".roundedQuantisedDCT") == 0)
+	{
+		// enough chunks that each thread reading the file keeps the one it's part way through
+		CSnapSampleSource* source = new CSnapSampleSource(std::max(16U, 2 * std::thread::hardware_concurrency()));
+		ESnapError error = source->open(fileName);
+		if (error != SNAP_OK)
+		{
+			fprintf(stderr, "Cannot decode: '%s': %s\n", fileName, getSnapErrorString(error));
+			delete source;
+			return NULL;
+		}
+		return source;
+	}
+
+	CRawSampleSource* source = new CRawSampleSource;
+	if (!source->open(fileName))
+	{
+		fprintf(stderr, "Cannot read: '%s'\n", fileName);
+		delete source;
+		return NULL;
+	}
+	return source;
+}
@@ -0,0 +1,27 @@
+#ifndef WAVE_CMP_ASAMPLESOURCE_H_
+#define WAVE_CMP_ASAMPLESOURCE_H_
+
+#include <complex>
+#include <cstdint>
+
+// Where wave_cmp gets a file's 8 bit IQ samples from, a .8t file or one decoded as it's looked at
+class ASampleSource
+{
+public:
+	ASampleSource();
+	virtual ~ASampleSource();
+
+	// a CSnapSampleSource for .roundedQuantisedDCT files, a CRawSampleSource for anything else. Says why on stderr and
+	// returns NULL if the file can't be used
+	static ASampleSource* open(const char* fileName);
+
+	virtual uint64_t getNumSamples() const = 0;
+
+	// copies numSamples from first to samples, past the end reads as zeros. Safe to call from several threads at once
+	virtual void read(uint64_t first, uint64_t numSamples, std::complex<int8_t>* samples) = 0;
+
+	// [first, first + numSamples) will be read soon
+	virtual void willNeed(uint64_t first, uint64_t numSamples);
+};
+
+#endif /* WAVE_CMP_ASAMPLESOURCE_H_ */
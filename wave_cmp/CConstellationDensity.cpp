@@ -0,0 +1,103 @@
+#include "CConstellationDensity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <mutex>
+
+#include "../src/display/CPixelBuffer.h"
+#include "ASampleSource.h"
+#include "ParallelFor.h"
+
+namespace
+{
+const uint32_t numBins = 256 * 256;
+const uint32_t samplesPerRead = 65536;
+}
+
+CConstellationDensity::CConstellationDensity() :
+		_counts(numBins),
+		_numSamples(0),
+		_maxCount(0)
+{
+}
+
+CConstellationDensity::~CConstellationDensity()
+{
+}
+
+void CConstellationDensity::build(ASampleSource& source, uint64_t firstSample, uint64_t numSamples, uint32_t numThreads)
+{
+	firstSample = std::min(firstSample, source.getNumSamples());
+	_numSamples = std::min(numSamples, source.getNumSamples() - firstSample);
+	std::fill(_counts.begin(), _counts.end(), 0);
+	source.willNeed(firstSample, _numSamples);
+
+	std::mutex mutex;
+	uint64_t numReads = (_numSamples + samplesPerRead - 1) / samplesPerRead;
+	parallelFor(numReads, std::max(1U, numThreads), [&](uint64_t begin, uint64_t end)
+	{
+		std::vector<uint64_t> counts(numBins);
+		std::vector<std::complex<int8_t>> samples(samplesPerRead);
+
+		for (uint64_t read = begin; read < end; read++)
+		{
+			uint64_t first = read * samplesPerRead;
+			uint32_t numRead = std::min<uint64_t>(samplesPerRead, _numSamples - first);
+			source.read(firstSample + first, numRead, samples.data());
+
+			for (uint32_t i = 0; i < numRead; i++)
+			{
+				counts[getBin(samples[i].real(), samples[i].imag())]++;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t bin = 0; bin < numBins; bin++)
+		{
+			_counts[bin] += counts[bin];
+		}
+	});
+
+	_maxCount = *std::max_element(_counts.begin(), _counts.end());
+}
+
+uint64_t CConstellationDensity::getNumSamples() const
+{
+	return _numSamples;
+}
+
+uint64_t CConstellationDensity::getCount(int8_t i, int8_t q) const
+{
+	return _counts[getBin(i, q)];
+}
+
+void CConstellationDensity::draw(CPixelBuffer& image, int32_t xOffset, int32_t yOffset, uint32_t scale) const
+{
+	float logMax = log1pf(_maxCount);
+
+	for (int32_t q = -128; q < 128; q++)
+	{
+		for (int32_t i = -128; i < 128; i++)
+		{
+			uint64_t count = getCount(i, q);
+			if (count == 0)
+			{
+				continue;
+			}
+
+			uint32_t colour = image.setHeatColour(0.1f + 0.9f * log1pf(count) / logMax);
+			int32_t x = xOffset + (i + 128) * scale;
+			int32_t y = yOffset + (q + 128) * scale;
+			for (uint32_t row = 0; row < scale; row++)
+			{
+				image.drawStraightLine(x, y + row, x + scale, y + row, colour);
+			}
+		}
+	}
+}
+
+uint32_t CConstellationDensity::getBin(int8_t i, int8_t q)
+{
+	return (uint8_t) (q + 128) * 256 + (uint8_t) (i + 128);
+}
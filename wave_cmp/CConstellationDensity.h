@@ -0,0 +1,36 @@
+#ifndef WAVE_CMP_CCONSTELLATIONDENSITY_H_
+#define WAVE_CMP_CCONSTELLATIONDENSITY_H_
+
+#include <cstdint>
+#include <vector>
+
+class ASampleSource;
+class CPixelBuffer;
+
+// How many of a stretch of a file's samples fall on each of the 256 x 256 I/Q values, so rare points show up however many
+// samples there are. Counted with a histogram per thread, added together at the end.
+class CConstellationDensity
+{
+public:
+	CConstellationDensity();
+	virtual ~CConstellationDensity();
+
+	// numSamples from firstSample, stopping at the end of the file
+	void build(ASampleSource& source, uint64_t firstSample, uint64_t numSamples, uint32_t numThreads);
+
+	uint64_t getNumSamples() const;
+	uint64_t getCount(int8_t i, int8_t q) const;
+
+	// scale pixels per I/Q value, laid out as drawConstellation does. Log scaled against the busiest value, anything seen
+	// at all is at least dark blue
+	void draw(CPixelBuffer& image, int32_t xOffset, int32_t yOffset, uint32_t scale) const;
+
+private:
+	static uint32_t getBin(int8_t i, int8_t q);
+
+	std::vector<uint64_t> _counts;
+	uint64_t _numSamples;
+	uint64_t _maxCount;
+};
+
+#endif /* WAVE_CMP_CCONSTELLATIONDENSITY_H_ */
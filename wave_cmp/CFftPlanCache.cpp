@@ -0,0 +1,41 @@
+#include "CFftPlanCache.h"
+
+CFftPlanCache::CFftPlanCache()
+{
+}
+
+CFftPlanCache::~CFftPlanCache()
+{
+	for (auto& plan : _plans)
+	{
+		kiss_fft_free(plan.second);
+	}
+	for (auto& plan : _batchPlans)
+	{
+		kiss_fft_free(plan.second);
+	}
+}
+
+kiss_fft_cfg CFftPlanCache::get(uint32_t fftSize, bool isInverse)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	kiss_fft_cfg& plan = _plans[std::make_pair(fftSize, isInverse)];
+	if (!plan)
+	{
+		plan = kiss_fft_alloc(fftSize, isInverse, NULL, NULL);
+	}
+	return plan;
+}
+
+kiss_fft_batch_cfg CFftPlanCache::getBatch(uint32_t fftSize, bool isInverse)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	kiss_fft_batch_cfg& plan = _batchPlans[std::make_pair(fftSize, isInverse)];
+	if (!plan)
+	{
+		plan = kiss_fft_batch_alloc(fftSize, isInverse, NULL, NULL);
+	}
+	return plan;
+}
@@ -0,0 +1,28 @@
+#ifndef WAVE_CMP_CFFTPLANCACHE_H_
+#define WAVE_CMP_CFFTPLANCACHE_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+#include "../src/fft/kiss_fft.h"
+#include "../src/fft/kiss_fft_batch.h"
+
+// kiss_fft configs by size, made the first time each is asked for and kept until the cache is destroyed. Safe to use from
+// several threads, kiss_fft only reads its config.
+class CFftPlanCache
+{
+public:
+	CFftPlanCache();
+	virtual ~CFftPlanCache();
+
+	kiss_fft_cfg get(uint32_t fftSize, bool isInverse);
+	kiss_fft_batch_cfg getBatch(uint32_t fftSize, bool isInverse);
+
+private:
+	std::mutex _mutex;
+	std::map<std::pair<uint32_t, bool>, kiss_fft_cfg> _plans;
+	std::map<std::pair<uint32_t, bool>, kiss_fft_batch_cfg> _batchPlans;
+};
+
+#endif /* WAVE_CMP_CFFTPLANCACHE_H_ */
@@ -0,0 +1,256 @@
+#include "CLodPyramid.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "ASampleSource.h"
+#include "ParallelFor.h"
+
+namespace
+{
+const char sidecarMagic[4] = {'S', 'L', 'O', 'D'};
+const uint32_t sidecarVersion = 1;
+
+struct SidecarHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t fileSize;
+	int64_t modificationTime;
+	uint32_t baseBlock;
+	uint32_t fanOut;
+	uint32_t numLevels;
+	uint32_t reserved;
+};
+}
+
+CLodPyramid::CLodPyramid() :
+		_source(NULL),
+		_numSamples(0)
+{
+}
+
+CLodPyramid::~CLodPyramid()
+{
+}
+
+bool CLodPyramid::open(const char* fileName, ASampleSource& source, uint32_t numThreads)
+{
+	struct stat st;
+	if (stat(fileName, &st) != 0)
+	{
+		return false;
+	}
+
+	_source = &source;
+	_numSamples = source.getNumSamples();
+
+	std::string sidecarName = std::string(fileName) + ".lod";
+	if (load(sidecarName, st.st_size, st.st_mtime))
+	{
+		return true;
+	}
+
+	printf("Building overview of '%s'\n", fileName);
+	build(std::max(1U, numThreads));
+	save(sidecarName, st.st_size, st.st_mtime);
+
+	return true;
+}
+
+uint64_t CLodPyramid::getNumSamples() const
+{
+	return _numSamples;
+}
+
+uint32_t CLodPyramid::summarise(uint64_t firstSample, uint64_t samplesPerColumn, uint32_t numColumns, std::vector<Entry>& columns) const
+{
+	columns.resize(numColumns);
+	samplesPerColumn = std::max<uint64_t>(1, samplesPerColumn);
+
+	// the coarsest level whose entries still fit in a column
+	int32_t level = -1;
+	while (level + 1 < (int32_t) _levels.size() && getSpan(level + 1) <= samplesPerColumn)
+	{
+		level++;
+	}
+
+	uint32_t column = 0;
+	for (; column < numColumns; column++)
+	{
+		uint64_t first = firstSample + column * samplesPerColumn;
+		if (first >= _numSamples)
+		{
+			break;
+		}
+		uint64_t end = std::min(_numSamples, first + samplesPerColumn);
+
+		if (level < 0)
+		{
+			summariseSamples(first, end, columns[column]);
+		}
+		else
+		{
+			uint64_t span = getSpan(level);
+			combine(level, first / span, (end + span - 1) / span, columns[column]);
+		}
+	}
+
+	return column;
+}
+
+bool CLodPyramid::load(const std::string& sidecarName, uint64_t fileSize, int64_t modificationTime)
+{
+	FILE* fh = fopen(sidecarName.c_str(), "rb");
+	if (!fh)
+	{
+		return false;
+	}
+
+	SidecarHeader header;
+	bool isValid = fread(&header, sizeof(header), 1, fh) == 1 &&
+			memcmp(header.magic, sidecarMagic, sizeof(sidecarMagic)) == 0 &&
+			header.version == sidecarVersion &&
+			header.fileSize == fileSize &&
+			header.modificationTime == modificationTime &&
+			header.baseBlock == baseBlock &&
+			header.fanOut == fanOut;
+
+	_levels.clear();
+	for (uint32_t level = 0; isValid && level < header.numLevels; level++)
+	{
+		uint64_t numEntries = (_numSamples + getSpan(level) - 1) / getSpan(level);
+		_levels.push_back(std::vector<Entry>(numEntries));
+		isValid = fread(_levels.back().data(), sizeof(Entry), numEntries, fh) == numEntries;
+	}
+	fclose(fh);
+
+	if (!isValid)
+	{
+		_levels.clear();
+	}
+	return isValid;
+}
+
+void CLodPyramid::save(const std::string& sidecarName, uint64_t fileSize, int64_t modificationTime) const
+{
+	SidecarHeader header;
+	memcpy(header.magic, sidecarMagic, sizeof(sidecarMagic));
+	header.version = sidecarVersion;
+	header.fileSize = fileSize;
+	header.modificationTime = modificationTime;
+	header.baseBlock = baseBlock;
+	header.fanOut = fanOut;
+	header.numLevels = _levels.size();
+	header.reserved = 0;
+
+	// not being able to write next to the file only means building it again next time
+	FILE* fh = fopen(sidecarName.c_str(), "wb");
+	bool isWritten = fh && fwrite(&header, sizeof(header), 1, fh) == 1;
+	for (const std::vector<Entry>& level : _levels)
+	{
+		isWritten = isWritten && fwrite(level.data(), sizeof(Entry), level.size(), fh) == level.size();
+	}
+	if (fh && fclose(fh) != 0)
+	{
+		isWritten = false;
+	}
+
+	if (!isWritten)
+	{
+		fprintf(stderr, "Cannot write overview: '%s'\n", sidecarName.c_str());
+		remove(sidecarName.c_str());
+	}
+}
+
+void CLodPyramid::build(uint32_t numThreads)
+{
+	_levels.clear();
+	if (_numSamples == 0)
+	{
+		return;
+	}
+
+	// the bottom level is the only one which reads the file, and nearly all the work
+	_levels.push_back(std::vector<Entry>((_numSamples + baseBlock - 1) / baseBlock));
+	parallelFor(_levels[0].size(), numThreads, [&](uint64_t begin, uint64_t end)
+	{
+		for (uint64_t i = begin; i < end; i++)
+		{
+			summariseSamples(i * baseBlock, std::min(_numSamples, (i + 1) * baseBlock), _levels[0][i]);
+		}
+	});
+
+	while (_levels.back().size() > 1)
+	{
+		uint32_t below = _levels.size() - 1;
+		std::vector<Entry> level((_levels[below].size() + fanOut - 1) / fanOut);
+		parallelFor(level.size(), numThreads, [&](uint64_t begin, uint64_t end)
+		{
+			for (uint64_t i = begin; i < end; i++)
+			{
+				combine(below, i * fanOut, std::min<uint64_t>(_levels[below].size(), (i + 1) * fanOut), level[i]);
+			}
+		});
+		_levels.push_back(std::move(level));
+	}
+}
+
+uint64_t CLodPyramid::getSpan(uint32_t level) const
+{
+	uint64_t span = baseBlock;
+	for (uint32_t i = 0; i < level; i++)
+	{
+		span *= fanOut;
+	}
+	return span;
+}
+
+void CLodPyramid::summariseSamples(uint64_t first, uint64_t end, Entry& entry) const
+{
+	std::complex<int8_t> samples[baseBlock];
+	_source->read(first, end - first, samples);
+	const int8_t* values = reinterpret_cast<const int8_t*>(samples);
+	uint32_t numValues = 2 * (end - first);
+
+	int8_t minI = 127, maxI = -128, minQ = 127, maxQ = -128;
+	int64_t power = 0;
+	for (uint32_t i = 0; i < numValues; i += 2)
+	{
+		minI = std::min(minI, values[i]);
+		maxI = std::max(maxI, values[i]);
+		minQ = std::min(minQ, values[i + 1]);
+		maxQ = std::max(maxQ, values[i + 1]);
+		power += values[i] * values[i] + values[i + 1] * values[i + 1];
+	}
+
+	entry.minI = minI;
+	entry.maxI = maxI;
+	entry.minQ = minQ;
+	entry.maxQ = maxQ;
+	entry.power = numValues != 0 ? (float) power / (numValues / 2) : 0.0f;
+}
+
+void CLodPyramid::combine(uint32_t level, uint64_t first, uint64_t end, Entry& entry) const
+{
+	const std::vector<Entry>& entries = _levels[level];
+	uint64_t span = getSpan(level);
+
+	entry = entries[first];
+	double power = 0.0;
+	uint64_t numSamples = 0;
+	for (uint64_t i = first; i < end; i++)
+	{
+		entry.minI = std::min(entry.minI, entries[i].minI);
+		entry.maxI = std::max(entry.maxI, entries[i].maxI);
+		entry.minQ = std::min(entry.minQ, entries[i].minQ);
+		entry.maxQ = std::max(entry.maxQ, entries[i].maxQ);
+
+		uint64_t entrySamples = std::min(span, _numSamples - i * span);
+		power += (double) entries[i].power * entrySamples;
+		numSamples += entrySamples;
+	}
+	entry.power = power / numSamples;
+}
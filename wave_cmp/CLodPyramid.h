@@ -0,0 +1,59 @@
+#ifndef WAVE_CMP_CLODPYRAMID_H_
+#define WAVE_CMP_CLODPYRAMID_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ASampleSource;
+
+// Min, max and mean power of a file's samples at every power of fanOut zoom, so the overview of any stretch of it, up to the
+// whole file, touches only a few entries per pixel column. Built once with a thread per core and kept in a file.lod
+// sidecar, which is rebuilt if the file's size or modification time no longer match.
+class CLodPyramid
+{
+public:
+	struct Entry
+	{
+		int8_t minI;
+		int8_t maxI;
+		int8_t minQ;
+		int8_t maxQ;
+		float power;	// mean I^2 + Q^2
+	};
+
+	CLodPyramid();
+	virtual ~CLodPyramid();
+
+	// loads fileName.lod, or builds the pyramid from source (fileName's samples) and tries to save it. Only fails if
+	// fileName isn't there
+	bool open(const char* fileName, ASampleSource& source, uint32_t numThreads);
+
+	uint64_t getNumSamples() const;
+
+	// one entry per samplesPerColumn samples from firstSample, returns how many columns there are before the end of the
+	// file. Below baseBlock samples a column is worked out from the samples, otherwise from the level whose entries are
+	// the largest no bigger than a column, so entries straddling a column edge count towards both columns
+	uint32_t summarise(uint64_t firstSample, uint64_t samplesPerColumn, uint32_t numColumns, std::vector<Entry>& columns) const;
+
+	static const uint32_t baseBlock = 1024;
+	static const uint32_t fanOut = 4;
+
+private:
+	bool load(const std::string& sidecarName, uint64_t fileSize, int64_t modificationTime);
+	void save(const std::string& sidecarName, uint64_t fileSize, int64_t modificationTime) const;
+	void build(uint32_t numThreads);
+
+	uint64_t getSpan(uint32_t level) const;
+	void summariseSamples(uint64_t first, uint64_t end, Entry& entry) const;
+	// entries [first, end) of level, power weighted by how many samples each covers
+	void combine(uint32_t level, uint64_t first, uint64_t end, Entry& entry) const;
+
+	ASampleSource* _source;
+	uint64_t _numSamples;
+
+	// level n has an entry per baseBlock * fanOut^n samples, the last one in each level may be short
+	std::vector<std::vector<Entry>> _levels;
+};
+
+#endif /* WAVE_CMP_CLODPYRAMID_H_ */
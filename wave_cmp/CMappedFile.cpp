@@ -0,0 +1,90 @@
+#include "CMappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CMappedFile::CMappedFile() :
+		_fd(-1),
+		_data(NULL),
+		_size(0)
+{
+}
+
+CMappedFile::~CMappedFile()
+{
+	close();
+}
+
+bool CMappedFile::open(const char* fileName)
+{
+	close();
+
+	_fd = ::open(fileName, O_RDONLY);
+	struct stat st;
+	if (_fd < 0 || fstat(_fd, &st) != 0)
+	{
+		close();
+		return false;
+	}
+
+	// mmap() refuses empty files, which are fine to look at
+	_size = st.st_size;
+	if (_size == 0)
+	{
+		return true;
+	}
+
+	void* data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+	if (data == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	_data = static_cast<uint8_t*>(data);
+
+	// paging back and forth through the file, the kernel's sequential read ahead only gets in the way
+	madvise(_data, _size, MADV_RANDOM);
+
+	return true;
+}
+
+void CMappedFile::close()
+{
+	if (_data)
+	{
+		munmap(_data, _size);
+		_data = NULL;
+	}
+	if (_fd >= 0)
+	{
+		::close(_fd);
+		_fd = -1;
+	}
+	_size = 0;
+}
+
+const uint8_t* CMappedFile::getData() const
+{
+	return _data;
+}
+
+uint64_t CMappedFile::getSize() const
+{
+	return _size;
+}
+
+void CMappedFile::willNeed(uint64_t offset, uint64_t numBytes) const
+{
+	if (!_data || offset >= _size)
+	{
+		return;
+	}
+
+	// madvise() wants a page aligned start
+	uint64_t pageSize = sysconf(_SC_PAGESIZE);
+	uint64_t start = offset & ~(pageSize - 1);
+	uint64_t end = offset + numBytes < _size ? offset + numBytes : _size;
+	madvise(_data + start, end - start, MADV_WILLNEED);
+}
@@ -0,0 +1,28 @@
+#ifndef WAVE_CMP_CMAPPEDFILE_H_
+#define WAVE_CMP_CMAPPEDFILE_H_
+
+#include <cstdint>
+
+// A whole file mapped read only, so any part of a multi-GB snapshot can be looked at without reading the rest of it
+class CMappedFile
+{
+public:
+	CMappedFile();
+	virtual ~CMappedFile();
+
+	bool open(const char* fileName);
+	void close();
+
+	const uint8_t* getData() const;
+	uint64_t getSize() const;
+
+	// asks the kernel to start reading [offset, offset + numBytes) in the background, clipped to the file
+	void willNeed(uint64_t offset, uint64_t numBytes) const;
+
+private:
+	int _fd;
+	uint8_t* _data;
+	uint64_t _size;
+};
+
+#endif /* WAVE_CMP_CMAPPEDFILE_H_ */
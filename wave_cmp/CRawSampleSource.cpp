@@ -0,0 +1,37 @@
+#include "CRawSampleSource.h"
+
+#include <algorithm>
+#include <cstring>
+
+CRawSampleSource::CRawSampleSource()
+{
+}
+
+CRawSampleSource::~CRawSampleSource()
+{
+}
+
+bool CRawSampleSource::open(const char* fileName)
+{
+	return _file.open(fileName);
+}
+
+uint64_t CRawSampleSource::getNumSamples() const
+{
+	return _file.getSize() / 2;
+}
+
+void CRawSampleSource::read(uint64_t first, uint64_t numSamples, std::complex<int8_t>* samples)
+{
+	uint64_t available = first < getNumSamples() ? std::min(numSamples, getNumSamples() - first) : 0;
+	if (available != 0)
+	{
+		memcpy(samples, _file.getData() + 2 * first, 2 * available);
+	}
+	std::fill(samples + available, samples + numSamples, std::complex<int8_t>());
+}
+
+void CRawSampleSource::willNeed(uint64_t first, uint64_t numSamples)
+{
+	_file.willNeed(2 * first, 2 * numSamples);
+}
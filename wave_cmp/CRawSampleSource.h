@@ -0,0 +1,24 @@
+#ifndef WAVE_CMP_CRAWSAMPLESOURCE_H_
+#define WAVE_CMP_CRAWSAMPLESOURCE_H_
+
+#include "ASampleSource.h"
+#include "CMappedFile.h"
+
+// a .8t file, mapped
+class CRawSampleSource: public ASampleSource
+{
+public:
+	CRawSampleSource();
+	virtual ~CRawSampleSource();
+
+	bool open(const char* fileName);
+
+	uint64_t getNumSamples() const;
+	void read(uint64_t first, uint64_t numSamples, std::complex<int8_t>* samples);
+	void willNeed(uint64_t first, uint64_t numSamples);
+
+private:
+	CMappedFile _file;
+};
+
+#endif /* WAVE_CMP_CRAWSAMPLESOURCE_H_ */
@@ -0,0 +1,242 @@
+#include "CSegmentCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "ASampleSource.h"
+
+CSegmentCache::CSegmentCache(ASampleSource& file0, ASampleSource& file1, uint32_t plotWidth, uint32_t screensPerSegment, uint32_t capacity) :
+		_plotWidth(plotWidth),
+		_numSamples(plotWidth * screensPerSegment),
+		_capacity(std::max(capacity, 3U)),
+		_isRendering(false),
+		_renderingIndex(0),
+		_stop(false)
+{
+	_files[0] = &file0;
+	_files[1] = &file1;
+
+	_thread = std::thread(&CSegmentCache::prefetch, this);
+}
+
+CSegmentCache::~CSegmentCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_wakeUp.notify_all();
+	_thread.join();
+}
+
+std::shared_ptr<const CSegmentCache::Segment> CSegmentCache::get(uint32_t index)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	// the prefetch thread may be half way through this one already
+	std::shared_ptr<const Segment> segment = find(index);
+	while (!segment && _isRendering && _renderingIndex == index)
+	{
+		_rendered.wait(lock);
+		segment = find(index);
+	}
+
+	if (!segment)
+	{
+		lock.unlock();
+		segment = render(index);
+		lock.lock();
+		insert(segment);
+	}
+
+	// anything still queued is for where we were before, scrolling right is the common case so that goes first
+	_wanted.clear();
+	_wanted.push_back(index + 1);
+	if (index != 0)
+	{
+		_wanted.push_back(index - 1);
+	}
+	_wanted.push_back(index + 2);
+	_wakeUp.notify_one();
+
+	return segment;
+}
+
+std::shared_ptr<const CSegmentCache::Segment> CSegmentCache::find(uint32_t index)
+{
+	for (auto it = _segments.begin(); it != _segments.end(); ++it)
+	{
+		if ((*it)->index == index)
+		{
+			_segments.splice(_segments.begin(), _segments, it);
+			return _segments.front();
+		}
+	}
+	return std::shared_ptr<const Segment>();
+}
+
+void CSegmentCache::insert(const std::shared_ptr<const Segment>& segment)
+{
+	if (find(segment->index))
+	{
+		return;
+	}
+
+	_segments.push_front(segment);
+	if (_segments.size() > _capacity)
+	{
+		_segments.pop_back();
+	}
+}
+
+void CSegmentCache::prefetch()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	while (!_stop)
+	{
+		if (_wanted.empty())
+		{
+			_wakeUp.wait(lock);
+			continue;
+		}
+
+		uint32_t index = _wanted.front();
+		_wanted.pop_front();
+		if (find(index))
+		{
+			continue;
+		}
+
+		_isRendering = true;
+		_renderingIndex = index;
+		lock.unlock();
+
+		std::shared_ptr<const Segment> segment = render(index);
+
+		lock.lock();
+		_isRendering = false;
+		insert(segment);
+		_rendered.notify_all();
+	}
+}
+
+std::shared_ptr<const CSegmentCache::Segment> CSegmentCache::render(uint32_t index)
+{
+	std::shared_ptr<Segment> segment(new Segment);
+	segment->index = index;
+
+	// past the end of a file reads as zeros
+	std::vector<std::complex<int8_t>> samples[3];
+	uint64_t firstSample = (uint64_t) index * _plotWidth;
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		samples[i].resize(_numSamples);
+		_files[i]->read(firstSample, _numSamples, samples[i].data());
+
+		// the next segment along starts only one plot width later, so this usually has it all
+		_files[i]->willNeed(firstSample + _numSamples, _plotWidth);
+	}
+
+	samples[2].resize(_numSamples);
+	for (uint32_t i = 0; i < _numSamples; i++)
+	{
+		samples[2][i] = samples[1][i] - samples[0][i];
+	}
+
+	uint32_t constellationSize = std::min(constellationSamples, _numSamples);
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		segment->constellation[i].assign(samples[i].begin(), samples[i].begin() + constellationSize);
+		renderSpectrum(samples[i], segment->spectrum[i]);
+	}
+
+	uint32_t samplesToDraw = std::min(_plotWidth, _numSamples);
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		segment->timeDomain[i].resize(samplesToDraw);
+		for (uint32_t x = 0; x < samplesToDraw; x++)
+		{
+			segment->timeDomain[i][x] = 255 - (samples[i][x].real() + 128);
+		}
+	}
+
+	segment->phaseError.resize(samplesToDraw);
+	for (uint32_t x = 0; x < samplesToDraw; x++)
+	{
+		float phase1 = atan2f(samples[0][x].real(), samples[0][x].imag()) / (2 * M_PI);
+		float phase2 = atan2f(samples[1][x].real(), samples[1][x].imag()) / (2 * M_PI);
+		float mag1 = std::abs(samples[0][x]);
+		float mag2 = std::abs(samples[0][x]);
+		float phaseError = 127 + (phase2 - phase1) * (mag1 + mag2);
+		while (phaseError < 0)
+		{
+			phaseError += 256;
+		}
+		while (phaseError > 255)
+		{
+			phaseError -= 256;
+		}
+		segment->phaseError[x] = roundf(phaseError);
+	}
+
+	return segment;
+}
+
+void CSegmentCache::renderSpectrum(const std::vector<std::complex<int8_t>>& samples, std::vector<int16_t>& trace)
+{
+	uint32_t fftSize = _plotWidth;
+	uint32_t numAverages = samples.size() / fftSize;
+	kiss_fft_batch_cfg cfg = _plans.getBatch(fftSize, false);
+
+	std::unique_ptr<kiss_fft_batch_cpx, void (*)(void*)> in(kiss_fft_batch_buffer(fftSize), free);
+	std::unique_ptr<kiss_fft_batch_cpx, void (*)(void*)> out(kiss_fft_batch_buffer(fftSize), free);
+	std::vector<float> magnitudes(fftSize);
+
+	// KISS_FFT_BATCH_WIDTH of the averages at a time, one per lane. Lanes past the last average are left zero, and add
+	// log10(0 + 1) = 0 to the total
+	for (uint32_t first = 0; first < numAverages; first += KISS_FFT_BATCH_WIDTH)
+	{
+		uint32_t numLanes = std::min<uint32_t>(KISS_FFT_BATCH_WIDTH, numAverages - first);
+		for (uint32_t i = 0; i < fftSize; i++)
+		{
+			for (uint32_t lane = 0; lane < KISS_FFT_BATCH_WIDTH; lane++)
+			{
+				const std::complex<int8_t> sample = lane < numLanes ? samples[(first + lane) * fftSize + i] : std::complex<int8_t>();
+				in.get()[i].r[lane] = sample.real();
+				in.get()[i].i[lane] = sample.imag();
+			}
+		}
+
+		kiss_fft_batch(cfg, in.get(), out.get());
+
+		// the sum over the lanes of log10(|X| + 1) as the log of their product, so one log per bin rather than one per
+		// lane. A product of eight magnitudes can overflow a float, not a double
+		for (uint32_t i = 0; i < fftSize; i++)
+		{
+			const kiss_fft_batch_cpx& bin = out.get()[i];
+			kiss_fft_batch_scalar power = bin.r * bin.r + bin.i * bin.i;
+			double product = 1.0;
+			for (uint32_t lane = 0; lane < KISS_FFT_BATCH_WIDTH; lane++)
+			{
+				product *= sqrtf(power[lane]) + 1.0f;
+			}
+			magnitudes[(i + fftSize / 2) % fftSize] += log10(product);
+		}
+	}
+
+	float max = 4.5f;
+
+	trace.resize(fftSize);
+	for (uint32_t i = 0; i < fftSize; i++)
+	{
+		float magnitude = magnitudes[i] / numAverages;
+		if (magnitude < 0)
+		{
+			magnitude = 0;
+		}
+		trace[i] = roundf(255 - (255 * magnitude / max));
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef WAVE_CMP_CSEGMENTCACHE_H_
+#define WAVE_CMP_CSEGMENTCACHE_H_
+
+#include <complex>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CFftPlanCache.h"
+
+class ASampleSource;
+
+// Works out what wave_cmp draws for a segment of two files, keeping the most recently used segments. Each time one is
+// asked for, a background thread starts on its neighbours, so stepping left or right finds the next one ready.
+class CSegmentCache
+{
+public:
+	// everything needed to draw a segment, the plots are y coordinates within their 256 pixel high panel
+	struct Segment
+	{
+		uint32_t index;
+		std::vector<std::complex<int8_t>> constellation[3];	// the first samples of each file, then their difference
+		std::vector<int16_t> timeDomain[2];				// I of each file
+		std::vector<int16_t> spectrum[3];				// averaged log magnitude of each file, then of their difference
+		std::vector<int16_t> phaseError;
+	};
+
+	// segment n starts plotWidth * n samples in and averages the spectrum over screensPerSegment plot widths
+	CSegmentCache(ASampleSource& file0, ASampleSource& file1, uint32_t plotWidth, uint32_t screensPerSegment, uint32_t capacity);
+	virtual ~CSegmentCache();
+
+	std::shared_ptr<const Segment> get(uint32_t index);
+
+	static const uint32_t constellationSamples = 1024;
+
+private:
+	std::shared_ptr<const Segment> find(uint32_t index);
+	void insert(const std::shared_ptr<const Segment>& segment);
+	void prefetch();
+	std::shared_ptr<const Segment> render(uint32_t index);
+	void renderSpectrum(const std::vector<std::complex<int8_t>>& samples, std::vector<int16_t>& trace);
+
+	ASampleSource* _files[2];
+	uint32_t _plotWidth;
+	uint32_t _numSamples;
+	uint32_t _capacity;
+	CFftPlanCache _plans;
+
+	// most recently used first
+	std::list<std::shared_ptr<const Segment>> _segments;
+
+	std::mutex _mutex;
+	std::condition_variable _wakeUp;
+	std::condition_variable _rendered;
+	std::deque<uint32_t> _wanted;
+	bool _isRendering;
+	uint32_t _renderingIndex;
+	bool _stop;
+	std::thread _thread;
+};
+
+#endif /* WAVE_CMP_CSEGMENTCACHE_H_ */
@@ -0,0 +1,190 @@
+#include "CSnapSampleSource.h"
+
+#include <algorithm>
+#include <cstring>
+
+CSnapSampleSource::Decoder::Decoder() :
+		fh(NULL)
+{
+}
+
+CSnapSampleSource::Decoder::~Decoder()
+{
+	if (fh)
+	{
+		fclose(fh);
+	}
+}
+
+CSnapSampleSource::CSnapSampleSource(uint32_t numChunksCached) :
+		_numChunksCached(std::max(1U, numChunksCached)),
+		_blockSize(0),
+		_numSamples(0),
+		_isErrorReported(false)
+{
+}
+
+CSnapSampleSource::~CSnapSampleSource()
+{
+}
+
+ESnapError CSnapSampleSource::open(const char* fileName)
+{
+	_fileName = fileName;
+
+	ESnapError error;
+	std::unique_ptr<Decoder> decoder = openDecoder(error);
+	if (error != SNAP_OK)
+	{
+		return error;
+	}
+
+	// without an index, every chunk would mean decoding from the start of the file
+	if (!decoder->decoder.hasIndex())
+	{
+		return SNAP_ERROR_NO_INDEX;
+	}
+
+	_index = decoder->decoder.getIndex();
+	_blockSize = decoder->decoder.getBlockSize();
+	_numSamples = _index.getTotalSamples();
+	_idleDecoders.push_back(std::move(decoder));
+
+	return SNAP_OK;
+}
+
+uint64_t CSnapSampleSource::getNumSamples() const
+{
+	return _numSamples;
+}
+
+void CSnapSampleSource::read(uint64_t first, uint64_t numSamples, std::complex<int8_t>* samples)
+{
+	while (numSamples != 0 && first < _numSamples)
+	{
+		const CSeekIndex::Entry* entry = _index.findEntry(first / _blockSize);
+		std::shared_ptr<const Chunk> chunk = getChunk(entry - _index.getEntries().data());
+
+		// a chunk which failed to decode is short, and reads as zeros like the end of the file
+		uint64_t offset = first - chunk->firstSample;
+		uint64_t numCopied = offset < chunk->samples.size() ? std::min(numSamples, chunk->samples.size() - offset) : 0;
+		std::copy(chunk->samples.begin() + offset, chunk->samples.begin() + offset + numCopied, samples);
+
+		uint64_t chunkEnd = entry + 1 < _index.getEntries().data() + _index.getEntries().size() ? (entry + 1)->firstBlock * _blockSize : _numSamples;
+		uint64_t numZeros = std::min(numSamples, chunkEnd - first) - numCopied;
+		std::fill(samples + numCopied, samples + numCopied + numZeros, std::complex<int8_t>());
+
+		first += numCopied + numZeros;
+		samples += numCopied + numZeros;
+		numSamples -= numCopied + numZeros;
+	}
+	std::fill(samples, samples + numSamples, std::complex<int8_t>());
+}
+
+std::shared_ptr<const CSnapSampleSource::Chunk> CSnapSampleSource::getChunk(uint32_t index)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	std::shared_ptr<const Chunk> chunk = findChunk(index);
+	while (!chunk && _chunksBeingDecoded.count(index))
+	{
+		_chunkDecoded.wait(lock);
+		chunk = findChunk(index);
+	}
+	if (chunk)
+	{
+		return chunk;
+	}
+
+	_chunksBeingDecoded.insert(index);
+	std::unique_ptr<Decoder> decoder;
+	if (!_idleDecoders.empty())
+	{
+		decoder = std::move(_idleDecoders.back());
+		_idleDecoders.pop_back();
+	}
+	lock.unlock();
+
+	std::shared_ptr<Chunk> decoded(new Chunk);
+	decoded->index = index;
+	decoded->firstSample = _index.getEntries()[index].firstBlock * _blockSize;
+
+	ESnapError error = SNAP_OK;
+	if (!decoder)
+	{
+		decoder = openDecoder(error);
+	}
+	if (error == SNAP_OK)
+	{
+		error = decodeChunk(*decoder, *decoded);
+	}
+
+	lock.lock();
+	if (error != SNAP_OK && !_isErrorReported)
+	{
+		fprintf(stderr, "Cannot decode chunk %u of '%s': %s\n", index, _fileName.c_str(), getSnapErrorString(error));
+		_isErrorReported = true;
+	}
+	if (decoder && error == SNAP_OK)
+	{
+		_idleDecoders.push_back(std::move(decoder));
+	}
+
+	_chunks.push_front(decoded);
+	if (_chunks.size() > _numChunksCached)
+	{
+		_chunks.pop_back();
+	}
+	_chunksBeingDecoded.erase(index);
+	_chunkDecoded.notify_all();
+
+	return decoded;
+}
+
+std::shared_ptr<const CSnapSampleSource::Chunk> CSnapSampleSource::findChunk(uint32_t index)
+{
+	for (auto it = _chunks.begin(); it != _chunks.end(); ++it)
+	{
+		if ((*it)->index == index)
+		{
+			_chunks.splice(_chunks.begin(), _chunks, it);
+			return _chunks.front();
+		}
+	}
+	return std::shared_ptr<const Chunk>();
+}
+
+std::unique_ptr<CSnapSampleSource::Decoder> CSnapSampleSource::openDecoder(ESnapError& error) const
+{
+	std::unique_ptr<Decoder> decoder(new Decoder);
+
+	decoder->fh = fopen(_fileName.c_str(), "r");
+	if (!decoder->fh)
+	{
+		error = SNAP_ERROR_IO;
+		return decoder;
+	}
+
+	error = decoder->decoder.open(decoder->fh);
+	return decoder;
+}
+
+ESnapError CSnapSampleSource::decodeChunk(Decoder& decoder, Chunk& chunk) const
+{
+	const std::vector<CSeekIndex::Entry>& entries = _index.getEntries();
+	uint64_t endBlock = chunk.index + 1 < entries.size() ? entries[chunk.index + 1].firstBlock : _index.getTotalBlocks();
+	uint64_t numSamples = std::min(endBlock * _blockSize, _numSamples) - entries[chunk.index].firstBlock * _blockSize;
+
+	ESnapError error = decoder.decoder.seekToSample(chunk.firstSample);
+	if (error != SNAP_OK)
+	{
+		return error;
+	}
+
+	chunk.samples.resize(numSamples);
+	size_t numDecoded;
+	error = decoder.decoder.pullSamples(chunk.samples.data(), numSamples, numDecoded);
+
+	chunk.samples.resize(numDecoded);
+	return error == SNAP_OK && numDecoded < numSamples ? SNAP_ERROR_CORRUPT_DATA : error;
+}
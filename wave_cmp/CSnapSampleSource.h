@@ -0,0 +1,68 @@
+#ifndef WAVE_CMP_CSNAPSAMPLESOURCE_H_
+#define WAVE_CMP_CSNAPSAMPLESOURCE_H_
+
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "ASampleSource.h"
+#include "CSeekIndex.h"
+#include "CSnapDecoder.h"
+#include "SnapError.h"
+
+// A .roundedQuantisedDCT file, decoded a chunk at a time as its samples are read, so looking at part of a snapshot needs
+// neither a full decode nor somewhere to put one. Uses the seek index to go straight to a chunk, keeping the most
+// recently used ones. Threads reading different chunks decode them at the same time, each with its own decoder.
+class CSnapSampleSource: public ASampleSource
+{
+public:
+	explicit CSnapSampleSource(uint32_t numChunksCached);
+	virtual ~CSnapSampleSource();
+
+	ESnapError open(const char* fileName);
+
+	uint64_t getNumSamples() const;
+	void read(uint64_t first, uint64_t numSamples, std::complex<int8_t>* samples);
+
+private:
+	struct Chunk
+	{
+		uint32_t index;
+		uint64_t firstSample;
+		std::vector<std::complex<int8_t>> samples;
+	};
+
+	struct Decoder
+	{
+		Decoder();
+		~Decoder();
+
+		FILE* fh;
+		CSnapDecoder decoder;
+	};
+
+	std::shared_ptr<const Chunk> getChunk(uint32_t index);
+	std::shared_ptr<const Chunk> findChunk(uint32_t index);
+	std::unique_ptr<Decoder> openDecoder(ESnapError& error) const;
+	ESnapError decodeChunk(Decoder& decoder, Chunk& chunk) const;
+
+	std::string _fileName;
+	uint32_t _numChunksCached;
+	CSeekIndex _index;
+	uint32_t _blockSize;
+	uint64_t _numSamples;
+
+	std::mutex _mutex;
+	std::condition_variable _chunkDecoded;
+	std::list<std::shared_ptr<const Chunk>> _chunks;	// most recently used first
+	std::set<uint32_t> _chunksBeingDecoded;
+	std::vector<std::unique_ptr<Decoder>> _idleDecoders;
+	bool _isErrorReported;
+};
+
+#endif /* WAVE_CMP_CSNAPSAMPLESOURCE_H_ */
@@ -0,0 +1,102 @@
+#include "CSpectrogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "ASampleSource.h"
+#include "CFftPlanCache.h"
+#include "ParallelFor.h"
+
+CSpectrogram::CSpectrogram(ASampleSource& source, CFftPlanCache& plans, uint32_t fftSize, uint32_t framesPerRow) :
+		_source(source),
+		_plans(plans),
+		_fftSize(std::max(1U, fftSize)),
+		_framesPerRow(std::max(1U, framesPerRow)),
+		_window(_fftSize)
+{
+	double windowSum = 0.0;
+	for (uint32_t i = 0; i < _fftSize; i++)
+	{
+		_window[i] = 0.5f - 0.5f * cosf(2 * M_PI * i / _fftSize);
+		windowSum += _window[i];
+	}
+
+	// a full scale tone, amplitude 128, peaks at 128 * the sum of the window
+	_scale = 1.0 / (128.0 * windowSum * 128.0 * windowSum);
+}
+
+CSpectrogram::~CSpectrogram()
+{
+}
+
+uint32_t CSpectrogram::getFftSize() const
+{
+	return _fftSize;
+}
+
+uint64_t CSpectrogram::getNumRows() const
+{
+	uint64_t samplesPerRow = (uint64_t) _fftSize * _framesPerRow;
+	return (_source.getNumSamples() + samplesPerRow - 1) / samplesPerRow;
+}
+
+void CSpectrogram::render(uint64_t firstRow, uint32_t numRows, uint32_t numThreads, std::vector<float>& powerDb)
+{
+	uint64_t samplesPerRow = (uint64_t) _fftSize * _framesPerRow;
+	powerDb.resize((uint64_t) numRows * _fftSize);
+	_source.willNeed(firstRow * samplesPerRow, numRows * samplesPerRow);
+
+	parallelFor(numRows, std::max(1U, numThreads), [&](uint64_t begin, uint64_t end)
+	{
+		std::vector<std::complex<int8_t>> samples(samplesPerRow);
+		std::unique_ptr<kiss_fft_batch_cpx, void (*)(void*)> in(kiss_fft_batch_buffer(_fftSize), free);
+		std::unique_ptr<kiss_fft_batch_cpx, void (*)(void*)> out(kiss_fft_batch_buffer(_fftSize), free);
+
+		for (uint64_t row = begin; row < end; row++)
+		{
+			renderRow(firstRow + row, samples, in.get(), out.get(), powerDb.data() + row * _fftSize);
+		}
+	});
+}
+
+void CSpectrogram::renderRow(uint64_t row, std::vector<std::complex<int8_t>>& samples, kiss_fft_batch_cpx* in, kiss_fft_batch_cpx* out, float* powerDb)
+{
+	_source.read(row * samples.size(), samples.size(), samples.data());
+	kiss_fft_batch_cfg cfg = _plans.getBatch(_fftSize, false);
+
+	std::vector<double> power(_fftSize);
+	for (uint32_t first = 0; first < _framesPerRow; first += KISS_FFT_BATCH_WIDTH)
+	{
+		// lanes past the last frame are left zero, and add nothing
+		uint32_t numLanes = std::min<uint32_t>(KISS_FFT_BATCH_WIDTH, _framesPerRow - first);
+		for (uint32_t i = 0; i < _fftSize; i++)
+		{
+			for (uint32_t lane = 0; lane < KISS_FFT_BATCH_WIDTH; lane++)
+			{
+				const std::complex<int8_t> sample = lane < numLanes ? samples[(uint64_t) (first + lane) * _fftSize + i] : std::complex<int8_t>();
+				in[i].r[lane] = sample.real() * _window[i];
+				in[i].i[lane] = sample.imag() * _window[i];
+			}
+		}
+
+		kiss_fft_batch(cfg, in, out);
+
+		for (uint32_t i = 0; i < _fftSize; i++)
+		{
+			kiss_fft_batch_scalar binPower = out[i].r * out[i].r + out[i].i * out[i].i;
+			double sum = 0.0;
+			for (uint32_t lane = 0; lane < numLanes; lane++)
+			{
+				sum += binPower[lane];
+			}
+			power[(i + _fftSize / 2) % _fftSize] += sum;
+		}
+	}
+
+	// the floor keeps silence finite
+	for (uint32_t i = 0; i < _fftSize; i++)
+	{
+		powerDb[i] = 10 * log10(std::max(1e-20, power[i] * _scale / _framesPerRow));
+	}
+}
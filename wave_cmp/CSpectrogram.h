@@ -0,0 +1,40 @@
+#ifndef WAVE_CMP_CSPECTROGRAM_H_
+#define WAVE_CMP_CSPECTROGRAM_H_
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "../src/fft/kiss_fft_batch.h"
+
+class ASampleSource;
+class CFftPlanCache;
+
+// The power spectrum of a whole file, a row per framesPerRow consecutive fftSize sample frames. Rows are worked out a
+// range per thread, each doing KISS_FFT_BATCH_WIDTH of a row's frames in one batched transform.
+class CSpectrogram
+{
+public:
+	CSpectrogram(ASampleSource& source, CFftPlanCache& plans, uint32_t fftSize, uint32_t framesPerRow);
+	virtual ~CSpectrogram();
+
+	uint32_t getFftSize() const;
+	// the last row is padded with zeros to a whole number of frames
+	uint64_t getNumRows() const;
+
+	// fftSize values per row from firstRow, DC in the middle, in dB relative to a full scale tone. Each is the mean over
+	// the row's Hann windowed frames
+	void render(uint64_t firstRow, uint32_t numRows, uint32_t numThreads, std::vector<float>& powerDb);
+
+private:
+	void renderRow(uint64_t row, std::vector<std::complex<int8_t>>& samples, kiss_fft_batch_cpx* in, kiss_fft_batch_cpx* out, float* powerDb);
+
+	ASampleSource& _source;
+	CFftPlanCache& _plans;
+	uint32_t _fftSize;
+	uint32_t _framesPerRow;
+	std::vector<float> _window;
+	float _scale;	// 1 / |X|^2 of a full scale tone
+};
+
+#endif /* WAVE_CMP_CSPECTROGRAM_H_ */
@@ -0,0 +1,26 @@
+#ifndef WAVE_CMP_PARALLELFOR_H_
+#define WAVE_CMP_PARALLELFOR_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// splits [0, numItems) into a range per thread, calling function(begin, end) on each and returning once they're all done
+template<typename Function>
+void parallelFor(uint64_t numItems, uint32_t numThreads, const Function& function)
+{
+	uint64_t rangeSize = std::max<uint64_t>(1, (numItems + numThreads - 1) / numThreads);
+	std::vector<std::thread> threads;
+
+	for (uint64_t begin = 0; begin < numItems; begin += rangeSize)
+	{
+		threads.push_back(std::thread(function, begin, std::min(numItems, begin + rangeSize)));
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+#endif /* WAVE_CMP_PARALLELFOR_H_ */
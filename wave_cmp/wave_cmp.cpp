@@ -4,17 +4,28 @@
 #include <cwchar>
 #include <vector>
 #include <complex>
+#include <cstring>
 #include <algorithm>
+#include <cmath>
+#include <memory>
+#include <thread>
 #include <unistd.h>
 
 #include "../src/display/ASdlKeyPressHandler.h"
+#include "../src/display/CPixelBuffer.h"
 #include "../src/display/CSdlDisplay.h"
-#include "../src/fft/kiss_fft.h"
+#include "ASampleSource.h"
+#include "CConstellationDensity.h"
+#include "CLodPyramid.h"
+#include "CSegmentCache.h"
 
 class CKeyPressHandler: public ASdlKeyPressHandler
 {
 public:
-	CKeyPressHandler()
+	CKeyPressHandler(uint32_t plotWidth, uint64_t maxSamplesPerColumn) :
+			plotWidth(plotWidth),
+			maxSamplesPerColumn(maxSamplesPerColumn),
+			samplesPerColumn(maxSamplesPerColumn)
 	{
 	}
 
@@ -25,18 +36,62 @@ public:
 			case SDLK_RIGHT:
 			{
 				doRedraw = true;
-				segment++;
+				if (showOverview)
+				{
+					overviewCentre += plotWidth / 4 * samplesPerColumn;
+				}
+				else
+				{
+					segment++;
+				}
 				break;
 			}
 			case SDLK_LEFT:
 			{
 				doRedraw = true;
-				if(segment != 0)
+				if (showOverview)
+				{
+					overviewCentre -= std::min<uint64_t>(overviewCentre, plotWidth / 4 * samplesPerColumn);
+				}
+				else if(segment != 0)
 				{
 					segment--;
 				}
 				break;
 			}
+			case SDLK_UP:
+			{
+				doRedraw = true;
+				samplesPerColumn = std::max<uint64_t>(1, samplesPerColumn / 2);
+				break;
+			}
+			case SDLK_DOWN:
+			{
+				doRedraw = true;
+				samplesPerColumn = std::min(maxSamplesPerColumn, samplesPerColumn * 2);
+				break;
+			}
+			case SDLK_o:
+			{
+				// the overview opens around the segment being looked at, and closes on the segment at its centre
+				doRedraw = true;
+				showOverview = !showOverview;
+				if (showOverview)
+				{
+					overviewCentre = (uint64_t) segment * plotWidth + plotWidth / 2;
+				}
+				else
+				{
+					segment = overviewCentre / plotWidth;
+				}
+				break;
+			}
+			case SDLK_d:
+			{
+				doRedraw = showOverview;
+				showDensity = !showDensity;
+				break;
+			}
 			case SDLK_s:
 			{
 				doRedraw = true;
@@ -47,88 +102,138 @@ public:
 		}
 	}
 
+	uint64_t getOverviewStart() const
+	{
+		return overviewCentre - std::min<uint64_t>(overviewCentre, plotWidth / 2 * samplesPerColumn);
+	}
+
+	uint64_t getOverviewLength() const
+	{
+		return plotWidth * samplesPerColumn;
+	}
+
 	bool doRedraw = false;
 	uint32_t segment = 0;
 	int drawOrder[2] = {0, 1};
+
+	uint32_t plotWidth;
+	uint64_t maxSamplesPerColumn;
+	bool showOverview = false;
+	bool showDensity = false;
+	uint64_t overviewCentre = 0;
+	uint64_t samplesPerColumn;
 };
 
-void drawConstellation(CSdlDisplay* display, uint32_t xOffset, uint32_t yOffset, const std::vector<std::complex<int8_t>>& samples, uint32_t numSamples, uint32_t colour);
-void drawTimeDomain(CSdlDisplay* display, uint32_t xOffset, uint32_t yOffset, const std::vector<std::complex<int8_t>>& samples, uint32_t colour);
-void drawFft(CSdlDisplay* display, uint32_t xOffset, uint32_t yOffset, const std::vector<std::complex<int8_t>>& samples, uint32_t fftSize, uint32_t colour);
-void drawPhaseError(CSdlDisplay* display, uint32_t xOffset, uint32_t yOffset, const std::vector<std::complex<int8_t>>* samples, uint32_t colour);
+void drawConstellation(CPixelBuffer* display, uint32_t xOffset, uint32_t yOffset, const std::vector<std::complex<int8_t>>& samples, uint32_t colour);
+void drawTrace(CPixelBuffer* display, uint32_t xOffset, uint32_t yOffset, const std::vector<int16_t>& trace, uint32_t colour);
+void drawOverview(CPixelBuffer* display, const CLodPyramid* overviews, const CKeyPressHandler& view, const uint32_t* colour);
+void drawPosition(CPixelBuffer* display, const CLodPyramid* overviews, const CKeyPressHandler& view, uint32_t colour);
 
 int main(int argc, char** argv)
 {
 	if (argc != 3)
 	{
-		fprintf(stderr, "Usage: %s file1.8t file2.8t\n", argv[0]);
+		fprintf(stderr, "Usage: %s file1.8t|file1.roundedQuantisedDCT file2.8t|file2.roundedQuantisedDCT\n", argv[0]);
+		fprintf(stderr, "\tcompressed files are decoded a chunk at a time as they're looked at\n");
+		fprintf(stderr, "\tleft/right steps through the files, s swaps which is drawn on top\n");
+		fprintf(stderr, "\to switches to an overview of the whole of both files and back, up/down zoom it in and out\n");
+		fprintf(stderr, "\td switches the overview to how often each I/Q value turns up in the part of the files it covers\n");
 		exit(1);
 	}
 
-	FILE* fh[2];
-
-	fh[0] = fopen(argv[1], "r");
-	if (!fh[0])
+	std::unique_ptr<ASampleSource> files[2];
+	for (int i = 0; i < 2; i++)
 	{
-		fprintf(stderr, "Cannot read: '%s'\n", argv[1]);
-		exit(1);
+		files[i].reset(ASampleSource::open(argv[i + 1]));
+		if (!files[i])
+		{
+			exit(1);
+		}
 	}
 
-	fh[1] = fopen(argv[2], "r");
-	if (!fh[1])
+	// built or loaded before the window opens, the first time round a big capture takes a while
+	CLodPyramid overviews[2];
+	for (int i = 0; i < 2; i++)
 	{
-		fprintf(stderr, "Cannot read: '%s'\n", argv[1]);
-		exit(1);
+		if (!overviews[i].open(argv[i + 1], *files[i], std::thread::hardware_concurrency()))
+		{
+			fprintf(stderr, "Cannot read: '%s'\n", argv[i + 1]);
+			exit(1);
+		}
 	}
 
 	CSdlDisplay display(1900, 768);
 
-	CKeyPressHandler keyPressHandler;
-	display.addKeyHandler(&keyPressHandler);
-
 	const uint32_t numSamples = display.getWidth() - 256;
 
-	std::vector<std::complex<int8_t>> samples[2];
-	samples[0].resize(numSamples*20);
-	samples[1].resize(numSamples*20);
+	// zoomed out as far as it goes, the longer file fits the plot
+	uint64_t longestFile = std::max(overviews[0].getNumSamples(), overviews[1].getNumSamples());
+	uint64_t maxSamplesPerColumn = 1;
+	while (maxSamplesPerColumn * numSamples < longestFile)
+	{
+		maxSamplesPerColumn *= 2;
+	}
 
-	std::vector<std::complex<int8_t>> errors(samples[0].size());
+	CKeyPressHandler keyPressHandler(numSamples, maxSamplesPerColumn);
+	display.addKeyHandler(&keyPressHandler);
 
-	while (1)
-	{
-		printf("Segment; %u, byteOffset: %lu\n", keyPressHandler.segment, keyPressHandler.segment * numSamples * 2ULL);
-		for(uint32_t i=0;i<2;i++)
-		{
-			fseek(fh[i], keyPressHandler.segment * numSamples * 2ULL, SEEK_SET);
-			fread(samples[i].data(), 2, numSamples*20, fh[i]);
-		}
+	// the spectrum averages over 20 screens, the current one and its neighbours are rendered in the background
+	CSegmentCache segments(*files[0], *files[1], numSamples, 20, 8);
 
-		for(uint32_t i=0;i<errors.size();i++)
-		{
-			errors[i] = samples[1][i] - samples[0][i];
-		}
+	// counted again only when the overview moves
+	CConstellationDensity densities[2];
+	uint64_t densityStart = UINT64_MAX, densityLength = 0;
 
-		uint8_t* pixels = display.getPixels();
-		memset(pixels, 0, display.getWidth() * display.getHeight() * 4);
+	while (1)
+	{
+		display.clear(0);
 
 		uint32_t colour[3];
 		colour[0] = display.setColour(0, 255, 0);
 		colour[1] = display.setColour(255, 0, 0);
 		colour[2] = display.setColour(0, 128, 255);
 
-		drawConstellation(&display, 0, 0, samples[0], 1024, colour[0]);
-		drawConstellation(&display, 0, 256, samples[1], 1024, colour[1]);
-		drawConstellation(&display, 0, 512, errors, 1024, colour[2]);
+		if (keyPressHandler.showOverview && keyPressHandler.showDensity)
+		{
+			printf("Density; sample: %lu, samples: %lu\n", keyPressHandler.getOverviewStart(), keyPressHandler.getOverviewLength());
+			if (densityStart != keyPressHandler.getOverviewStart() || densityLength != keyPressHandler.getOverviewLength())
+			{
+				densityStart = keyPressHandler.getOverviewStart();
+				densityLength = keyPressHandler.getOverviewLength();
+				for (int i = 0; i < 2; i++)
+				{
+					densities[i].build(*files[i], densityStart, densityLength, std::thread::hardware_concurrency());
+				}
+			}
 
-		for (int i = 0; i < 2; i++)
+			densities[0].draw(display, 256, 0, 2);
+			densities[1].draw(display, 256 + 512 + 64, 0, 2);
+			drawPosition(&display, overviews, keyPressHandler, colour[2]);
+		}
+		else if (keyPressHandler.showOverview)
+		{
+			printf("Overview; sample: %lu, samples per pixel: %lu\n", keyPressHandler.getOverviewStart(), keyPressHandler.samplesPerColumn);
+			drawOverview(&display, overviews, keyPressHandler, colour);
+		}
+		else
 		{
-			int index = keyPressHandler.drawOrder[i];
+			printf("Segment; %u, byteOffset: %lu\n", keyPressHandler.segment, keyPressHandler.segment * numSamples * 2ULL);
+			std::shared_ptr<const CSegmentCache::Segment> segment = segments.get(keyPressHandler.segment);
 
-			drawTimeDomain(&display, 256, 0, samples[index], colour[index]);
-			drawFft(&display, 256, 256, samples[index], display.getWidth() - 256, colour[index]);
+			drawConstellation(&display, 0, 0, segment->constellation[0], colour[0]);
+			drawConstellation(&display, 0, 256, segment->constellation[1], colour[1]);
+			drawConstellation(&display, 0, 512, segment->constellation[2], colour[2]);
+
+			for (int i = 0; i < 2; i++)
+			{
+				int index = keyPressHandler.drawOrder[i];
+
+				drawTrace(&display, 256, 0, segment->timeDomain[index], colour[index]);
+				drawTrace(&display, 256, 256, segment->spectrum[index], colour[index]);
+			}
+			drawTrace(&display, 256, 256, segment->spectrum[2], colour[2]);
+			drawTrace(&display, 256, 512, segment->phaseError, colour[2]);
 		}
-		drawFft(&display, 256, 256, errors, display.getWidth() - 256, colour[2]);
-		drawPhaseError(&display, 256, 512, samples, colour[2]);
 
 		display.swapBuffers();
 
@@ -139,135 +244,74 @@ int main(int argc, char** argv)
 		}
 		keyPressHandler.doRedraw = false;
 	}
-
-	fclose (fh[0]);
-	fclose (fh[1]);
-
-
 }
 
-void drawConstellation(CSdlDisplay* display, uint32_t xOffset, uint32_t yOffset, const std::vector<std::complex<int8_t>>& samples, uint32_t numSamples, uint32_t colour)
+void drawConstellation(CPixelBuffer* display, uint32_t xOffset, uint32_t yOffset, const std::vector<std::complex<int8_t>>& samples, uint32_t colour)
 {
-	for(uint32_t i=0;i<numSamples; i++)
+	std::vector<CPixelBuffer::Point> points(samples.size());
+	for (uint32_t i = 0; i < samples.size(); i++)
 	{
-		const std::complex<int8_t>& point = samples[i];
-		int x = point.real() + 128 + xOffset;
-		int y = point.imag() + 128 + yOffset;
-		display->setPixel(x, y, colour);
+		points[i].x = samples[i].real() + 128 + xOffset;
+		points[i].y = samples[i].imag() + 128 + yOffset;
 	}
+	display->drawPoints(points.data(), points.size(), colour);
 }
 
-void drawTimeDomain(CSdlDisplay* display, uint32_t xOffset, uint32_t yOffset, const std::vector<std::complex<int8_t>>& samples, uint32_t colour)
+// joins up one y per pixel column, starting from the middle of the left edge
+void drawTrace(CPixelBuffer* display, uint32_t xOffset, uint32_t yOffset, const std::vector<int16_t>& trace, uint32_t colour)
 {
-	uint32_t samplesToDraw = std::min((uint32_t)samples.size(), display->getWidth() - xOffset);
-	uint32_t prevX = xOffset, prevY = yOffset + 128;
-	for(uint32_t i=0;i<samplesToDraw;i++)
+	std::vector<CPixelBuffer::Point> points(trace.size() + 1);
+	points[0].x = xOffset;
+	points[0].y = yOffset + 128;
+	for (uint32_t i = 0; i < trace.size(); i++)
 	{
-		int real = 255 - (samples[i].real() + 128);
-		uint32_t y = yOffset + real;
-		uint32_t x = xOffset + i;
-
-		display->drawLine(x, y, prevX, prevY, colour);
-
-		prevX = x;
-		prevY = y;
+		points[i + 1].x = xOffset + i;
+		points[i + 1].y = yOffset + trace[i];
 	}
+	display->drawPolyline(points.data(), points.size(), colour);
 }
 
-void drawFft(CSdlDisplay* display, uint32_t xOffset, uint32_t yOffset, const std::vector<std::complex<int8_t>>& samples, uint32_t fftSize, uint32_t colour)
+// I and Q of each file as a min to max bar per pixel column, then their mean power in dB
+void drawOverview(CPixelBuffer* display, const CLodPyramid* overviews, const CKeyPressHandler& view, const uint32_t* colour)
 {
-	std::vector<std::complex<float>> f(samples.size());
-	for(uint32_t i=0;i<samples.size();i++)
-	{
-		f[i].real(samples[i].real());
-		f[i].imag(samples[i].imag());
-	}
-
-	std::vector<std::complex<float>> fft(samples.size());
+	const uint32_t xOffset = 256;
+	const float maxPowerDb = 10 * log10f(2 * 128 * 128 + 1);
 
-	kiss_fft_cfg cfg = kiss_fft_alloc( fftSize , false ,0,0 );
+	uint64_t firstSample = view.getOverviewStart();
+	std::vector<CLodPyramid::Entry> columns;
 
-	uint32_t numAverages = samples.size() / fftSize;
-
-	for(uint32_t n=0;n<numAverages;n++)
+	for (int i = 0; i < 2; i++)
 	{
-		kiss_fft( cfg , reinterpret_cast<kiss_fft_cpx*>(f.data() + n * fftSize) , reinterpret_cast<kiss_fft_cpx*>(fft.data() + n * fftSize) );
-	}
-
-	free(cfg);
+		int index = view.drawOrder[i];
+		uint32_t numColumns = overviews[index].summarise(firstSample, view.samplesPerColumn, view.plotWidth, columns);
 
-	std::vector<float> magnitudes(fftSize);
-
-	for(uint32_t n=0;n<numAverages;n++)
-	{
-		for(uint32_t i=0;i<fftSize;i++)
+		std::vector<int16_t> power(numColumns);
+		for (uint32_t x = 0; x < numColumns; x++)
 		{
-			magnitudes[(i + fftSize / 2) % fftSize] += log10f(std::abs(fft[i + n * fftSize]) + 1);
+			const CLodPyramid::Entry& column = columns[x];
+			display->drawStraightLine(xOffset + x, 127 - column.maxI, xOffset + x, 127 - column.minI, colour[index]);
+			display->drawStraightLine(xOffset + x, 256 + 127 - column.maxQ, xOffset + x, 256 + 127 - column.minQ, colour[index]);
+			power[x] = roundf(255 - 255 * 10 * log10f(column.power + 1) / maxPowerDb);
 		}
+		drawTrace(display, xOffset, 512, power, colour[index]);
 	}
 
-	for(uint32_t i=0;i<fftSize;i++)
-	{
-		magnitudes[i] /= numAverages;
-	}
-
-	float max = 4.5f;//*std::max_element(magnitudes.begin(), magnitudes.end());
-	//printf("max: %f, numAverages = %u\n", max, numAverages);
-
-	uint32_t prevX = xOffset, prevY = yOffset + 128;
-	for(uint32_t i=0;i<fftSize;i++)
-	{
-		float magnitude =  magnitudes[i];
-		if(magnitude < 0)
-		{
-			magnitude = 0;
-		}
-		magnitude = 255 - (255 * magnitude / max);
-		uint32_t y = yOffset + roundf(magnitude);
-		uint32_t x = xOffset + i;
-
-		display->drawLine(x, y, prevX, prevY, colour);
-
-		prevX = x;
-		prevY = y;
-	}
+	drawPosition(display, overviews, view, colour[2]);
 }
 
-void drawPhaseError(CSdlDisplay* display, uint32_t xOffset, uint32_t yOffset, const std::vector<std::complex<int8_t>>* samples, uint32_t colour)
+// on the left, where the overview is in the longer file
+void drawPosition(CPixelBuffer* display, const CLodPyramid* overviews, const CKeyPressHandler& view, uint32_t colour)
 {
-	uint32_t samplesToDraw = std::min((uint32_t)samples[0].size(), display->getWidth() - xOffset);
-	uint32_t prevX = xOffset, prevY = yOffset + 128;
-	for(uint32_t i=0;i<samplesToDraw;i++)
-	{
-		float phase1 = atan2f(samples[0][i].real(), samples[0][i].imag()) / (2 * M_PI);
-		float phase2 = atan2f(samples[1][i].real(), samples[1][i].imag()) / (2 * M_PI);
-		float mag1 = std::abs(samples[0][i]);
-		float mag2 = std::abs(samples[0][i]);
-		float phaseError = 127 + (phase2 - phase1) * (mag1 + mag2);
-		while (phaseError < 0)
-		{
-			phaseError += 256;
-		}
-		while (phaseError > 255)
-		{
-			phaseError -= 256;
-		}
-		uint32_t y = yOffset + roundf(phaseError);
-		uint32_t x = xOffset + i;
-
+	const uint32_t xOffset = 256;
+	uint64_t firstSample = view.getOverviewStart();
 
-		/*printf("%4d, (%3d, %3d)(%3d, %3d) => %3.0f*%3.0f - %3.0f*%3.0f = %3.0f\n",
-				i,
-				samples[0][i].real(), samples[0][i].imag(),
-				samples[1][i].real(), samples[1][i].imag(),
-				phase1, mag1,
-				phase2, mag2,
-				phaseError
-				);*/
-
-		display->drawLine(x, y, prevX, prevY, colour);
-
-		prevX = x;
-		prevY = y;
+	uint64_t longestFile = std::max(overviews[0].getNumSamples(), overviews[1].getNumSamples());
+	if (longestFile != 0)
+	{
+		uint64_t lastSample = std::min(longestFile, firstSample + view.getOverviewLength());
+		uint32_t top = std::min<uint64_t>(firstSample, longestFile) * (display->getHeight() - 1) / longestFile;
+		uint32_t bottom = lastSample * (display->getHeight() - 1) / longestFile;
+		display->drawStraightLine(xOffset / 2, 0, xOffset / 2, display->getHeight() - 1, display->setColour(64, 64, 64));
+		display->drawStraightLine(xOffset / 2, top, xOffset / 2, bottom, colour);
 	}
 }
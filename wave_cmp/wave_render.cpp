@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/display/CPixelBuffer.h"
+#include "ASampleSource.h"
+#include "CConstellationDensity.h"
+#include "CFftPlanCache.h"
+#include "CSpectrogram.h"
+
+// wave_cmp's pictures without a display, for looking at captures on machines with no X server
+
+void usage(const char* argv0)
+{
+	fprintf(stderr, "Usage: %s waterfall file.8t|file.roundedQuantisedDCT output_prefix [--fft n] [--average n] [--tile-rows n] [--threads n] [--format png|ppm] [--min-db db] [--max-db db]\n", argv0);
+	fprintf(stderr, "\twrites output_prefix_0000.png and on, tile-rows rows of fft pixels each, a row per average frames\n");
+	fprintf(stderr, "Usage: %s density file.8t|file.roundedQuantisedDCT output.png|output.ppm [--start-sample n] [--count n] [--scale n] [--threads n]\n", argv0);
+	fprintf(stderr, "\thow often each I/Q value turns up, log scaled, scale pixels per value\n");
+	exit(1);
+}
+
+int waterfall(int argc, char** argv)
+{
+	if (argc < 4 || argc % 2 != 0)
+	{
+		usage(argv[0]);
+	}
+
+	const char* inputFileName = argv[2];
+	const char* outputPrefix = argv[3];
+	uint32_t fftSize = 1024;
+	uint32_t framesPerRow = 16;
+	uint32_t tileRows = 1024;
+	uint32_t numThreads = std::max(1U, std::thread::hardware_concurrency());
+	const char* format = "png";
+	float minDb = -100.0f;
+	float maxDb = 0.0f;
+
+	for (int i = 4; i < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--fft") == 0)
+		{
+			fftSize = strtoul(argv[i + 1], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--average") == 0)
+		{
+			framesPerRow = strtoul(argv[i + 1], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--tile-rows") == 0)
+		{
+			tileRows = strtoul(argv[i + 1], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--threads") == 0)
+		{
+			numThreads = strtoul(argv[i + 1], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--format") == 0)
+		{
+			format = argv[i + 1];
+		}
+		else if (strcmp(argv[i], "--min-db") == 0)
+		{
+			minDb = strtof(argv[i + 1], NULL);
+		}
+		else if (strcmp(argv[i], "--max-db") == 0)
+		{
+			maxDb = strtof(argv[i + 1], NULL);
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	if (fftSize == 0 || framesPerRow == 0 || tileRows == 0 || numThreads == 0 || maxDb <= minDb ||
+			(strcmp(format, "png") != 0 && strcmp(format, "ppm") != 0))
+	{
+		usage(argv[0]);
+	}
+
+	std::unique_ptr<ASampleSource> source(ASampleSource::open(inputFileName));
+	if (!source)
+	{
+		exit(1);
+	}
+
+	CFftPlanCache plans;
+	CSpectrogram spectrogram(*source, plans, fftSize, framesPerRow);
+	uint64_t numRows = spectrogram.getNumRows();
+
+	std::vector<float> powerDb;
+	for (uint64_t firstRow = 0, tile = 0; firstRow < numRows; firstRow += tileRows, tile++)
+	{
+		uint32_t numTileRows = std::min<uint64_t>(tileRows, numRows - firstRow);
+		spectrogram.render(firstRow, numTileRows, numThreads, powerDb);
+
+		CPixelBuffer image(fftSize, numTileRows);
+		for (uint32_t y = 0; y < numTileRows; y++)
+		{
+			for (uint32_t x = 0; x < fftSize; x++)
+			{
+				image.setPixel(x, y, image.setHeatColour((powerDb[(uint64_t) y * fftSize + x] - minDb) / (maxDb - minDb)));
+			}
+		}
+
+		char fileName[4096];
+		snprintf(fileName, sizeof(fileName), "%s_%04lu.%s", outputPrefix, tile, format);
+		if (!image.writeImage(fileName))
+		{
+			fprintf(stderr, "Cannot write: '%s'\n", fileName);
+			exit(1);
+		}
+		printf("Wrote '%s', rows %lu to %lu of %lu\n", fileName, firstRow, firstRow + numTileRows, numRows);
+	}
+
+	return 0;
+}
+
+int density(int argc, char** argv)
+{
+	if (argc < 4 || argc % 2 != 0)
+	{
+		usage(argv[0]);
+	}
+
+	const char* inputFileName = argv[2];
+	const char* outputFileName = argv[3];
+	uint64_t startSample = 0;
+	uint64_t count = UINT64_MAX;
+	uint32_t scale = 2;
+	uint32_t numThreads = std::max(1U, std::thread::hardware_concurrency());
+
+	for (int i = 4; i < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--start-sample") == 0)
+		{
+			startSample = strtoull(argv[i + 1], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--count") == 0)
+		{
+			count = strtoull(argv[i + 1], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--scale") == 0)
+		{
+			scale = strtoul(argv[i + 1], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--threads") == 0)
+		{
+			numThreads = strtoul(argv[i + 1], NULL, 10);
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	if (scale == 0 || numThreads == 0)
+	{
+		usage(argv[0]);
+	}
+
+	std::unique_ptr<ASampleSource> source(ASampleSource::open(inputFileName));
+	if (!source)
+	{
+		exit(1);
+	}
+
+	CConstellationDensity density;
+	density.build(*source, startSample, count, numThreads);
+
+	CPixelBuffer image(256 * scale, 256 * scale);
+	density.draw(image, 0, 0, scale);
+	if (!image.writeImage(outputFileName))
+	{
+		fprintf(stderr, "Cannot write: '%s'\n", outputFileName);
+		exit(1);
+	}
+	printf("Wrote '%s', %lu samples\n", outputFileName, density.getNumSamples());
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		usage(argv[0]);
+	}
+
+	if (strcmp(argv[1], "waterfall") == 0)
+	{
+		return waterfall(argc, argv);
+	}
+	else if (strcmp(argv[1], "density") == 0)
+	{
+		return density(argc, argv);
+	}
+
+	usage(argv[0]);
+}